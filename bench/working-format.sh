@@ -0,0 +1,49 @@
+#!/bin/sh
+# Compares the RGB24 and RGB0 working formats end to end.
+#
+# Usage: bench/working-format.sh <input_file> [effect_id] [runs]
+#
+# Every run converts full frames (--force-rgb --full-frame) with the same seed, so both formats apply the
+# effect to the same regions. --scale is only passed to Region Transform (filter 1), the only filter that takes it
+# and the one that exercises the gather kernels. Prints the average wall clock time per format in milliseconds.
+
+set -e
+
+if [ $# -lt 1 ]; then
+    echo "Usage: $0 <input_file> [effect_id] [runs]" >&2
+    exit 1
+fi
+
+input=$1
+effect=${2:-2}
+runs=${3:-5}
+
+binary=$(dirname "$0")/../src/video_effects
+if [ ! -x "$binary" ]; then
+    echo "[ERROR] $binary not found, run make first" >&2
+    exit 1
+fi
+
+output_dir=$(mktemp -d)
+trap 'rm -rf "$output_dir"' EXIT
+
+extension=${input##*.}
+
+scale=
+if [ "$effect" = 1 ]; then
+    scale="-s 1.5"
+fi
+
+for format in rgb24 rgb0; do
+    total=0
+    run=0
+    while [ $run -lt "$runs" ]; do
+        start=$(date +%s%N)
+        "$binary" -i "$input" -o "$output_dir/$format.$extension" -f "$effect" $scale --seed=1 \
+            --force-rgb --full-frame --working-format=$format > /dev/null
+        end=$(date +%s%N)
+        total=$((total + (end - start) / 1000000))
+        run=$((run + 1))
+    done
+    echo "$format: $((total / runs)) ms average over $runs runs"
+done
@@ -0,0 +1,13 @@
+#!/bin/sh
+# Drives libvideoeffects through library/videoeffects.h only: invalid options and frames are reported through the
+# API, and every supported pixel format gives the same frames single threaded, threaded and through the planes.
+#
+# Run by "make check" from the build directory.
+
+binary=src/video_effects_api_check
+if [ ! -x "$binary" ]; then
+    echo "[ERROR] $binary not found, run make check" >&2
+    exit 1
+fi
+
+exec "$binary"
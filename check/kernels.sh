@@ -0,0 +1,34 @@
+#!/bin/sh
+# Times the region kernels with the micro benchmarks and fails if the SIMD kernels are not faster than the scalar
+# kernels on this machine. With CHECK_BASELINE set it also fails if one of them got more than CHECK_MAX_REGRESSION
+# percent slower than in that baseline, or if the baseline has no micro results. A baseline only holds for the
+# machine it was recorded on, so without CHECK_BASELINE the comparison is skipped and says so.
+#
+# Run by "make check" from the build directory, top_srcdir, CHECK_BASELINE and CHECK_MAX_REGRESSION are set by the
+# makefile.
+
+binary=src/video_effects_bench
+max_regression=${CHECK_MAX_REGRESSION:-20}
+
+if [ ! -x "$binary" ]; then
+    echo "[ERROR] $binary not found, run make check" >&2
+    exit 1
+fi
+
+if [ -z "$CHECK_BASELINE" ]; then
+    echo "[WARNING] Baseline comparison skipped, CHECK_BASELINE is not set. Only the speedups against the scalar" \
+         "kernels are checked." >&2
+    exec "$binary" --suite=micro --max-regression="$max_regression"
+fi
+
+baseline=$CHECK_BASELINE
+if [ ! -f "$baseline" ] && [ -f "${top_srcdir:-.}/$baseline" ]; then
+    baseline=${top_srcdir:-.}/$baseline
+fi
+
+if ! grep -q '^micro/' "$baseline" 2>/dev/null; then
+    echo "[ERROR] The baseline '$CHECK_BASELINE' has no micro results, record them with make bench-baseline" >&2
+    exit 1
+fi
+
+exec "$binary" --suite=micro --baseline="$baseline" --max-regression="$max_regression"
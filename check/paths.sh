@@ -0,0 +1,16 @@
+#!/bin/sh
+# Processes generated RGB24, RGB0 and YUV420P frames with every filter and each kernel set, single threaded and
+# threaded, and compares them with check/golden.txt. Then encodes a synthetic clip through the RGB path, the dirty
+# region path and the native YUV path, and smart renders MPEG-TS clips with closed and open GOPs. Fails if paths
+# with the same output disagree, if a checksum of the frames differs from check/golden.txt or if an output does not
+# decode cleanly.
+#
+# Run by "make check" from the build directory, top_srcdir is set by the makefile.
+
+binary=src/video_effects_check
+if [ ! -x "$binary" ]; then
+    echo "[ERROR] $binary not found, run make check" >&2
+    exit 1
+fi
+
+exec "$binary" --golden="${top_srcdir:-.}/check/golden.txt"
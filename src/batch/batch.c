@@ -0,0 +1,370 @@
+#include "batch.h"
+#include "region/region.h"
+#include "region/scale.h"
+#include "stats/stats.h"
+#include "registry/registry.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+typedef struct BatchJob {
+    int line;
+    char *input_file;
+    char *output_file;
+    EffectType effect_id;
+    float scale_factor;
+    // set for lines that could not be parsed, the job fails without being started
+    const char *invalid;
+} BatchJob;
+
+typedef struct Batch {
+    BatchJob *jobs;
+    int job_count;
+    int next_job;
+    int failed;
+
+    FILE *results;
+    pthread_mutex_t lock;
+
+    const Config *data;
+} Batch;
+
+// Everything alloc_frame_slot() depends on
+typedef struct SlotLayout {
+    bool native_yuv;
+    int width;
+    int height;
+    enum AVPixelFormat working_format;
+    enum AVPixelFormat output_format;
+} SlotLayout;
+
+typedef struct BatchWorker {
+    Batch *batch;
+    pthread_t thread;
+
+    Config data;
+    Regions region_data;
+    VideoContext ctx;
+
+    FrameSlot slot;
+    SlotLayout slot_layout;
+    bool slot_allocated;
+} BatchWorker;
+
+static char *copy_field(const char *field) {
+
+    char *copy = strdup(field);
+    if (copy == NULL) {
+        fprintf(stderr, "[ERROR] Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return copy;
+}
+
+static void parse_job(char *line, const int line_number, BatchJob *job) {
+
+    const char *separators = strchr(line, '\t') != NULL ? "\t\r\n" : " \t\r\n";
+    char *save = NULL;
+
+    const char *input = strtok_r(line, separators, &save);
+    const char *output = strtok_r(NULL, separators, &save);
+    const char *filter = strtok_r(NULL, separators, &save);
+    const char *scale = strtok_r(NULL, separators, &save);
+
+    *job = (BatchJob) {
+        .line = line_number,
+        .input_file = copy_field(input),
+        .output_file = copy_field(output != NULL ? output : ""),
+        .effect_id = NONE,
+        .scale_factor = 0.0f,
+        .invalid = NULL
+    };
+
+    if (output == NULL || filter == NULL || strtok_r(NULL, separators, &save) != NULL) {
+        job->invalid = "Expected: <input> <output> <filter> [<scale>]";
+        return;
+    }
+
+    // the jobs run side by side and the results may go to stdout
+    if (is_pipe_path(input) || is_pipe_path(output)) {
+        job->invalid = "stdin and stdout can not be used in a batch job";
+        return;
+    }
+
+    const EffectDescriptor *effect = find_effect((int) strtol(filter, NULL, 10));
+    if (effect == NULL) {
+        job->invalid = "Invalid filter, expected 1, 2, 3 or the id of a loaded plugin";
+        return;
+    }
+    job->effect_id = (EffectType) effect->id;
+
+    if (scale != NULL)
+        job->scale_factor = strtof(scale, NULL);
+
+    if ((effect->capabilities & EFFECT_SCALED) && (job->scale_factor <= 0 || job->scale_factor > 3))
+        job->invalid = "The filter needs a scale factor greater than 0 and at most 3";
+}
+
+static void read_manifest(const char *manifest_path, Batch *batch) {
+
+    FILE *file = fopen(manifest_path, "r");
+    if (file == NULL) {
+        fprintf(stderr, "[ERROR] Could not open the batch manifest '%s'\n", manifest_path);
+        exit(EXIT_FAILURE);
+    }
+
+    int capacity = 0;
+    char *line = NULL;
+    size_t line_size = 0;
+    int line_number = 0;
+
+    while (getline(&line, &line_size, file) >= 0) {
+        line_number++;
+
+        const char *content = line + strspn(line, " \t\r\n");
+        if (*content == '\0' || *content == '#')
+            continue;
+
+        if (batch->job_count == capacity) {
+            capacity = capacity > 0 ? capacity * 2 : 64;
+            BatchJob *jobs = realloc(batch->jobs, sizeof(BatchJob) * capacity);
+            if (jobs == NULL) {
+                fprintf(stderr, "[ERROR] Memory allocation failed\n");
+                exit(EXIT_FAILURE);
+            }
+            batch->jobs = jobs;
+        }
+
+        parse_job(line + (content - line), line_number, &batch->jobs[batch->job_count++]);
+    }
+
+    free(line);
+    fclose(file);
+}
+
+static void write_result(Batch *batch, const BatchJob *job, const bool succeeded, const int frames,
+                         const double seconds, const char *error) {
+
+    pthread_mutex_lock(&batch->lock);
+
+    if (!succeeded)
+        batch->failed++;
+
+    // tabs and line breaks in the message would break the columns
+    char message[256];
+    snprintf(message, sizeof(message), "%s", error != NULL ? error : "");
+    for (char *c = message; *c != '\0'; c++) {
+        if (*c == '\t' || *c == '\n' || *c == '\r')
+            *c = ' ';
+    }
+
+    fprintf(batch->results, "%d\t%s\t%d\t%.3f\t%s\t%s\t%s\n", job->line, succeeded ? "ok" : "failed", frames,
+            seconds, job->input_file, job->output_file, message);
+    fflush(batch->results);
+
+    pthread_mutex_unlock(&batch->lock);
+}
+
+static void prepare_frame_slot(BatchWorker *worker) {
+
+    const VideoContext *ctx = &worker->ctx;
+    const SlotLayout layout = {
+        .native_yuv = ctx->native_yuv,
+        .width = ctx->encoder_context->width,
+        .height = ctx->encoder_context->height,
+        .working_format = ctx->working_format,
+        .output_format = ctx->encoder_context->pix_fmt
+    };
+
+    const SlotLayout *current = &worker->slot_layout;
+    if (worker->slot_allocated && current->native_yuv == layout.native_yuv && current->width == layout.width &&
+        current->height == layout.height && current->working_format == layout.working_format &&
+        current->output_format == layout.output_format)
+        return;
+
+    if (worker->slot_allocated)
+        free_frame_slot(&worker->slot);
+
+    alloc_frame_slot(ctx, &worker->slot);
+    worker->slot_layout = layout;
+    worker->slot_allocated = true;
+}
+
+// Everything a job changes apart from the reused contexts and buffers
+static void reset_worker(BatchWorker *worker) {
+
+    // the stack keeps its capacity for the next job
+    worker->region_data.size = 0;
+    worker->region_data.frame = 0;
+    worker->region_data.draw = 0;
+
+    if (worker->slot_allocated)
+        av_frame_unref(worker->slot.input_frame);
+}
+
+static void run_job(BatchWorker *worker, const BatchJob *job) {
+
+    Config *data = &worker->data;
+    VideoContext *ctx = &worker->ctx;
+
+    data->effect_id = job->effect_id;
+    data->scale_factor = job->scale_factor;
+    data->input_file = job->input_file;
+    data->output_file = job->output_file;
+
+    const int64_t start = stats_now();
+
+    // the worker state lives outside of this frame, so it is still valid after the jump
+    jmp_buf recovery;
+    if (setjmp(recovery) != 0) {
+        // only a file this job has started writing is removed
+        const bool output_opened = ctx->output_format_context != NULL && ctx->output_format_context->pb != NULL;
+        close_video_streams(ctx, false);
+        if (output_opened)
+            remove(job->output_file);
+
+        write_result(worker->batch, job, false, worker->region_data.frame, (stats_now() - start) / 1e9,
+                     get_job_error());
+        reset_worker(worker);
+        return;
+    }
+    set_job_recovery(&recovery);
+
+    open_input(ctx, job->input_file);
+    open_encoder(ctx);
+    open_output(ctx, job->output_file);
+
+    prepare_frame_slot(worker);
+    process_video_frames(ctx, &worker->slot);
+
+    close_video_streams(ctx, true);
+    set_job_recovery(NULL);
+
+    write_result(worker->batch, job, true, worker->region_data.frame, (stats_now() - start) / 1e9, NULL);
+    reset_worker(worker);
+}
+
+static void *batch_worker_thread(void *arg) {
+
+    BatchWorker *worker = arg;
+    Batch *batch = worker->batch;
+
+    while (true) {
+        pthread_mutex_lock(&batch->lock);
+        const int index = batch->next_job < batch->job_count ? batch->next_job++ : -1;
+        pthread_mutex_unlock(&batch->lock);
+
+        if (index < 0)
+            break;
+
+        const BatchJob *job = &batch->jobs[index];
+        if (job->invalid != NULL)
+            write_result(batch, job, false, 0, 0.0, job->invalid);
+        else
+            run_job(worker, job);
+    }
+
+    return NULL;
+}
+
+static void init_worker(BatchWorker *worker, Batch *batch) {
+
+    *worker = (BatchWorker) { .batch = batch };
+
+    worker->data = *batch->data;
+    worker->region_data = *batch->data->region_data;
+    worker->region_data.region_pair = NULL;
+    worker->region_data.size = 0;
+
+    worker->data.region_data = &worker->region_data;
+    worker->data.buffer = NULL;
+    worker->data.buffer_size = 0;
+    worker->data.scale_cache = NULL;
+
+    // parallelism comes from the jobs, every job runs serially on its worker
+    worker->data.pool = NULL;
+    worker->data.pipeline_depth = 0;
+    worker->data.segments = 0;
+
+    worker->ctx.data = &worker->data;
+}
+
+static void free_worker(BatchWorker *worker) {
+
+    if (worker->slot_allocated)
+        free_frame_slot(&worker->slot);
+
+    close_video_context(&worker->ctx);
+    cleanup_regions(&worker->region_data);
+    free(worker->data.buffer);
+    free_scale_cache(worker->data.scale_cache);
+}
+
+int process_batch(const char *manifest_path, const char *results_path, const Config *data) {
+
+    Batch batch = {
+        .jobs = NULL,
+        .job_count = 0,
+        .next_job = 0,
+        .failed = 0,
+        .results = stdout,
+        .data = data
+    };
+
+    read_manifest(manifest_path, &batch);
+
+    if (results_path != NULL) {
+        batch.results = fopen(results_path, "w");
+        if (batch.results == NULL) {
+            fprintf(stderr, "[ERROR] Could not open '%s' for writing\n", results_path);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    fprintf(batch.results, "line\tstatus\tframes\tseconds\tinput\toutput\terror\n");
+
+    pthread_mutex_init(&batch.lock, NULL);
+
+    const int worker_count = batch.job_count < data->batch_jobs ? batch.job_count : data->batch_jobs;
+    BatchWorker *workers = calloc(worker_count > 0 ? worker_count : 1, sizeof(BatchWorker));
+    if (workers == NULL) {
+        fprintf(stderr, "[ERROR] Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int i = 0; i < worker_count; i++) {
+        init_worker(&workers[i], &batch);
+        if (pthread_create(&workers[i].thread, NULL, batch_worker_thread, &workers[i]) != 0) {
+            fprintf(stderr, "[ERROR] Failed to start batch worker.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    for (int i = 0; i < worker_count; i++) {
+        pthread_join(workers[i].thread, NULL);
+        free_worker(&workers[i]);
+    }
+
+    pthread_mutex_destroy(&batch.lock);
+    free(workers);
+
+    if (batch.results != stdout && fclose(batch.results) != 0) {
+        fprintf(stderr, "[ERROR] Could not write the batch results to '%s'\n", results_path);
+        exit(EXIT_FAILURE);
+    }
+
+    // without a results file stdout only carries the results table
+    if (results_path != NULL)
+        printf("[INFO] %d of %d batch jobs succeeded\n", batch.job_count - batch.failed, batch.job_count);
+
+    for (int i = 0; i < batch.job_count; i++) {
+        free(batch.jobs[i].input_file);
+        free(batch.jobs[i].output_file);
+    }
+    free(batch.jobs);
+
+    return batch.failed;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "video-effects.h"
+
+#define MAX_BATCH_WORKERS 256
+
+// Runs every job of a manifest, one line per job: "<input> <output> <filter> [<scale>]". The fields are
+// separated by tabs if the line contains one, otherwise by whitespace. Empty lines and lines starting with #
+// are skipped. data provides all other options.
+//
+// Jobs run serially on data->batch_jobs worker threads. A worker keeps its conversion contexts, frame buffers and
+// region buffers for the next job with the same geometry. A failing job is recorded and its partial output is
+// removed, the other jobs continue. Returns the number of failed jobs.
+int process_batch(const char *manifest_path, const char *results_path, const Config *data);
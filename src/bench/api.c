@@ -0,0 +1,215 @@
+#include "library/videoeffects.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <libavutil/adler32.h>
+#include <libavutil/common.h>
+#include <libavutil/error.h>
+#include <libavutil/frame.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+
+// Drives libvideoeffects through its public header only, linked against the library as it is installed
+
+#define API_WIDTH 320
+#define API_HEIGHT 240
+#define API_FRAMES 8
+#define API_SEED 1
+#define API_THREADS 4
+
+static int failures = 0;
+
+static void expect(const bool condition, const char *description) {
+    printf("%-64s %s\n", description, condition ? "ok" : "FAILED");
+    if (!condition)
+        failures++;
+}
+
+static VideoEffects *create_chain(const int threads) {
+
+    VideoEffectsOptions options;
+    video_effects_default_options(&options);
+    options.filters[1] = 2;
+    options.filters[2] = 3;
+    options.filter_count = 3;
+    options.scale_factor = 1.5f;
+    options.scale_filter = "bilinear";
+    options.seed = API_SEED;
+    options.threads = threads;
+
+    char error[VIDEO_EFFECTS_ERROR_SIZE];
+    VideoEffects *effects = video_effects_create(&options, error);
+    if (effects == NULL) {
+        fprintf(stderr, "[ERROR] video_effects_create() failed: %s\n", error);
+        exit(EXIT_FAILURE);
+    }
+
+    return effects;
+}
+
+static AVFrame *alloc_test_frame(const enum AVPixelFormat format) {
+
+    AVFrame *frame = av_frame_alloc();
+    if (frame == NULL) {
+        fprintf(stderr, "[ERROR] Failed to allocate memory.\n");
+        exit(EXIT_FAILURE);
+    }
+    frame->format = format;
+    frame->width = API_WIDTH;
+    frame->height = API_HEIGHT;
+    if (av_frame_get_buffer(frame, 0) < 0) {
+        fprintf(stderr, "[ERROR] Failed to allocate memory.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return frame;
+}
+
+// Visible bytes of every plane, the same gradient for every format and frame number
+static void draw_test_frame(AVFrame *frame, const int number) {
+
+    const AVPixFmtDescriptor *descriptor = av_pix_fmt_desc_get(frame->format);
+    for (int plane = 0; plane < 4 && frame->data[plane] != NULL; plane++) {
+        const bool chroma = plane > 0 && !(descriptor->flags & AV_PIX_FMT_FLAG_RGB);
+        const int width = av_image_get_linesize(frame->format, frame->width, plane);
+        const int height = chroma ? AV_CEIL_RSHIFT(frame->height, descriptor->log2_chroma_h) : frame->height;
+        for (int y = 0; y < height; y++) {
+            uint8_t *row = frame->data[plane] + (ptrdiff_t) y * frame->linesize[plane];
+            for (int x = 0; x < width; x++)
+                row[x] = (uint8_t) (x * 7 + y * 13 + number * 29 + plane * 61);
+        }
+    }
+}
+
+static uint32_t checksum_frame(const AVFrame *frame) {
+
+    const AVPixFmtDescriptor *descriptor = av_pix_fmt_desc_get(frame->format);
+    uint32_t checksum = 1;
+    for (int plane = 0; plane < 4 && frame->data[plane] != NULL; plane++) {
+        const bool chroma = plane > 0 && !(descriptor->flags & AV_PIX_FMT_FLAG_RGB);
+        const int width = av_image_get_linesize(frame->format, frame->width, plane);
+        const int height = chroma ? AV_CEIL_RSHIFT(frame->height, descriptor->log2_chroma_h) : frame->height;
+        for (int y = 0; y < height; y++)
+            checksum = av_adler32_update(checksum, frame->data[plane] + (ptrdiff_t) y * frame->linesize[plane],
+                                         width);
+    }
+
+    return checksum;
+}
+
+// Runs the same frames through a single threaded and a threaded instance and through the plane interface
+static void check_format(const enum AVPixelFormat format) {
+
+    VideoEffects *single = create_chain(1);
+    VideoEffects *threaded = create_chain(API_THREADS);
+    VideoEffects *planes = create_chain(1);
+
+    AVFrame *frame = alloc_test_frame(format);
+    bool changed = false, same_threaded = true, same_planes = true, succeeded = true;
+
+    for (int i = 0; i < API_FRAMES; i++) {
+        draw_test_frame(frame, i);
+        const uint32_t source = checksum_frame(frame);
+        succeeded = succeeded && video_effects_process_frame(single, frame) == 0;
+        const uint32_t expected = checksum_frame(frame);
+        changed = changed || expected != source;
+
+        draw_test_frame(frame, i);
+        succeeded = succeeded && video_effects_process_frame(threaded, frame) == 0;
+        same_threaded = same_threaded && checksum_frame(frame) == expected;
+
+        draw_test_frame(frame, i);
+        succeeded = succeeded && video_effects_process_planes(planes, frame->data, frame->linesize, frame->width,
+                                                              frame->height, format) == 0;
+        same_planes = same_planes && checksum_frame(frame) == expected;
+    }
+
+    char description[128];
+    const char *name = av_get_pix_fmt_name(format);
+    snprintf(description, sizeof(description), "%s: every frame is processed", name);
+    expect(succeeded, description);
+    snprintf(description, sizeof(description), "%s: the filters change the frames", name);
+    expect(changed, description);
+    snprintf(description, sizeof(description), "%s: %d threads give the same frames as one", name, API_THREADS);
+    expect(same_threaded, description);
+    snprintf(description, sizeof(description), "%s: the planes give the same frames as the AVFrame", name);
+    expect(same_planes, description);
+
+    av_frame_free(&frame);
+    video_effects_destroy(single);
+    video_effects_destroy(threaded);
+    video_effects_destroy(planes);
+}
+
+static void check_invalid_options(void) {
+
+    VideoEffectsOptions options;
+    char error[VIDEO_EFFECTS_ERROR_SIZE];
+
+    video_effects_default_options(&options);
+    VideoEffects *effects = video_effects_create(&options, error);
+    expect(effects == NULL && error[0] != '\0', "scaling without a scale factor is rejected with a message");
+    video_effects_destroy(effects);
+
+    video_effects_default_options(&options);
+    options.filters[0] = 99;
+    effects = video_effects_create(&options, error);
+    expect(effects == NULL && error[0] != '\0', "an unknown filter is rejected with a message");
+    video_effects_destroy(effects);
+
+    video_effects_default_options(&options);
+    options.scale_factor = 1.5f;
+    options.scale_filter = "cubic";
+    effects = video_effects_create(&options, NULL);
+    expect(effects == NULL, "an unknown scale filter is rejected without an error buffer");
+    video_effects_destroy(effects);
+}
+
+static void check_invalid_frames(void) {
+
+    VideoEffects *effects = create_chain(1);
+
+    AVFrame *frame = alloc_test_frame(AV_PIX_FMT_GRAY8);
+    int ret = video_effects_process_frame(effects, frame);
+    expect(ret == AVERROR(EINVAL) && video_effects_get_error(effects)[0] != '\0',
+           "an unsupported pixel format is an error");
+    av_frame_free(&frame);
+
+    // a second reference makes the frame read only
+    frame = alloc_test_frame(AV_PIX_FMT_RGB24);
+    AVFrame *reference = av_frame_alloc();
+    if (reference == NULL || av_frame_ref(reference, frame) < 0) {
+        fprintf(stderr, "[ERROR] Failed to allocate memory.\n");
+        exit(EXIT_FAILURE);
+    }
+    ret = video_effects_process_frame(effects, frame);
+    expect(ret == AVERROR(EINVAL), "a frame that is not writable is an error");
+
+    av_frame_unref(reference);
+    draw_test_frame(frame, 0);
+    ret = video_effects_process_frame(effects, frame);
+    expect(ret == 0 && video_effects_get_error(effects)[0] == '\0', "a valid frame clears the error");
+
+    av_frame_free(&reference);
+    av_frame_free(&frame);
+    video_effects_destroy(effects);
+}
+
+int main(void) {
+
+    check_invalid_options();
+    check_invalid_frames();
+
+    check_format(AV_PIX_FMT_RGB24);
+    check_format(AV_PIX_FMT_RGB0);
+    check_format(AV_PIX_FMT_YUV420P);
+
+    if (failures > 0) {
+        fprintf(stderr, "[ERROR] %d check(s) failed\n", failures);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
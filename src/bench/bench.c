@@ -0,0 +1,811 @@
+#include "synthetic.h"
+#include "video-effects.h"
+#include "cmdline.h"
+#include "region/region.h"
+#include "region/kernels.h"
+#include "region/scale.h"
+#include "pipeline/pipeline.h"
+#include "pool/pool.h"
+#include "stats/stats.h"
+#include "io/mmap_input.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <argp.h>
+#include <libavutil/mem.h>
+#include <libavutil/common.h>
+
+// Every measurement runs at least this long and this often, after one warm up run
+#define MIN_BENCH_TIME 100000000
+#define MIN_ITERATIONS 3
+
+// Results that differ from the baseline by more than this are marked, and SIMD kernels that are slower than the
+// scalar ones by more than this
+#define BASELINE_TOLERANCE 0.10
+
+#define MAX_RESULTS 256
+#define MAX_KEY_LENGTH 96
+
+// Regions are placed on a grid of GRID x GRID cells, pair i uses cell i and cell GRID * GRID - 1 - i
+#define GRID 8
+
+typedef struct Result {
+    char key[MAX_KEY_LENGTH];
+    double value;
+} Result;
+
+typedef struct ResultList {
+    Result result[MAX_RESULTS];
+    int size;
+} ResultList;
+
+typedef enum {
+    SUITE_ALL = 0,
+    SUITE_MICRO,
+    SUITE_END_TO_END,
+    SUITE_DEMUX
+} Suite;
+
+typedef struct BenchOptions {
+    Suite suite;
+    char *baseline;
+    char *save_baseline;
+    int frames;
+    int width;
+    int height;
+    WorkingFormat working_format;
+    char *kernels;
+    int bands;
+    char *demux_input;
+    // fail when a result is worse than the baseline by more than this share, negative never fails
+    double max_regression;
+} BenchOptions;
+
+typedef struct Resolution {
+    const char *name;
+    int width;
+    int height;
+} Resolution;
+
+static const Resolution resolutions[] = {
+    { "720p", 1280, 720 },
+    { "1080p", 1920, 1080 },
+    { "4k", 3840, 2160 },
+    { "8k", 7680, 4320 }
+};
+
+static const int region_counts[] = { 1, 4, 16 };
+static const float scale_factors[] = { 0.5f, 1.5f, 2.0f };
+
+typedef struct MicroCase {
+    Config *data;
+    uint8_t *pixel;
+    int linesize;
+    int pixel_step;
+    int count;
+    float scale_factor;
+    Pixel start[GRID * GRID];
+    Pixel end[GRID * GRID];
+} MicroCase;
+
+typedef void (*MicroOperation)(const MicroCase *bench);
+
+typedef struct MicroBench {
+    const char *name;
+    MicroOperation operation;
+    // pixels read or written per region pair, relative to one region
+    int pixels;
+    // bytes moved per pixel, relative to the pixel step
+    int bytes;
+    bool scaled;
+} MicroBench;
+
+static void run_swap(const MicroCase *bench) {
+    for (int i = 0; i < bench->count; i++) {
+        const int partner = GRID * GRID - 1 - i;
+        swap_pixels(bench->data, bench->pixel, bench->linesize, bench->pixel_step, &bench->start[i], &bench->end[i],
+                    &bench->start[partner], &bench->end[partner]);
+    }
+}
+
+static void run_scale(const MicroCase *bench) {
+    for (int i = 0; i < bench->count; i++)
+        scale_pixels(bench->data, bench->pixel, bench->linesize, bench->pixel_step, bench->scale_factor,
+                     &bench->start[i], &bench->end[i]);
+}
+
+static void run_move(const MicroCase *bench) {
+    for (int i = 0; i < bench->count; i++)
+        move_pixels(bench->data, bench->pixel, bench->linesize, bench->pixel_step, &bench->start[i], &bench->end[i],
+                    &bench->start[GRID * GRID - 1 - i]);
+}
+
+static void run_copy(const MicroCase *bench) {
+    for (int i = 0; i < bench->count; i++)
+        copy_region_pixels(bench->data->pool, bench->data->buffer, bench->pixel, bench->linesize, bench->pixel_step,
+                           &bench->start[i], &bench->end[i]);
+}
+
+// swap reads and writes both regions, scale copies the region into the buffer and gathers it back
+static const MicroBench micro_benches[] = {
+    { "swap", run_swap, 2, 2, false },
+    { "scale", run_scale, 1, 4, true },
+    { "move", run_move, 1, 2, false },
+    { "copy", run_copy, 1, 2, false }
+};
+
+struct argp_option bench_options[] = {
+    {"suite", 's', "NAME", 0, "Benchmarks to run: all, micro, end-to-end or demux (default all)"},
+    {"baseline", 'b', "FILE", 0, "Compare the results with a baseline written by --save-baseline"},
+    {"save-baseline", 'w', "FILE", 0, "Store the results as new baseline"},
+    {"frames", 'n', "NUMBER", 0, "Frames of the synthetic video for the end-to-end runs (default 120)"},
+    {"size", 'r', "WIDTHxHEIGHT", 0, "Resolution of the synthetic video (default 1920x1080)"},
+    {"working-format", 'p', "NAME", 0, "Packed RGB format: rgb24 or rgb0 (default rgb24)"},
+    {"kernels", 'k', "NAME", 0, "Row kernels: auto, scalar, sse2, avx2 or avx512 (default auto)"},
+    {"bands", 'B', "NUMBER", 0, "Horizontal bands per operation, 0 = by frame height and cores, 1 = off (default 0)"},
+    {"demux-input", 'd', "FILE", 0, "Video the demux benchmark reads, e.g. a multi-GB file (default: the synthetic video)"},
+    {"max-regression", 'm', "PERCENT", 0, "Exit with an error if a result is more than PERCENT worse than the --baseline or the kernels are more than PERCENT slower than the scalar ones"},
+    {0}
+};
+
+static error_t parse_bench_option(int key, char *arg, struct argp_state *state) {
+
+    BenchOptions *options = state->input;
+
+    switch (key) {
+        case 's':
+            if (strcmp(arg, "all") == 0)
+                options->suite = SUITE_ALL;
+            else if (strcmp(arg, "micro") == 0)
+                options->suite = SUITE_MICRO;
+            else if (strcmp(arg, "end-to-end") == 0)
+                options->suite = SUITE_END_TO_END;
+            else if (strcmp(arg, "demux") == 0)
+                options->suite = SUITE_DEMUX;
+            else
+                argp_error(state, "Invalid suite. Expected: all, micro, end-to-end or demux");
+            break;
+        case 'b':
+            options->baseline = arg;
+            break;
+        case 'w':
+            options->save_baseline = arg;
+            break;
+        case 'n':
+            options->frames = (int) strtol(arg, NULL, 10);
+            if (options->frames <= 0)
+                argp_error(state, "Invalid frame count");
+            break;
+        case 'r':
+            if (sscanf(arg, "%dx%d", &options->width, &options->height) != 2 || options->width < 64 ||
+                options->height < 64 || options->width % 2 != 0 || options->height % 2 != 0)
+                argp_error(state, "Invalid size. Expected: WIDTHxHEIGHT, even and at least 64x64");
+            break;
+        case 'p':
+            if (strcmp(arg, "rgb24") == 0)
+                options->working_format = WORKING_FORMAT_RGB24;
+            else if (strcmp(arg, "rgb0") == 0)
+                options->working_format = WORKING_FORMAT_RGB0;
+            else
+                argp_error(state, "Invalid working format. Expected: rgb24 or rgb0");
+            break;
+        case 'k':
+            if (find_row_kernels(arg) == NULL)
+                argp_error(state, "Invalid kernels. Expected: auto, scalar, sse2, avx2 or avx512");
+            options->kernels = arg;
+            break;
+        case 'B':
+            options->bands = (int) strtol(arg, NULL, 10);
+            if (options->bands < 0 || options->bands > MAX_BANDS)
+                argp_error(state, "Invalid band count");
+            break;
+        case 'd':
+            options->demux_input = arg;
+            break;
+        case 'm':
+            options->max_regression = strtod(arg, NULL) / 100;
+            if (options->max_regression < 0)
+                argp_error(state, "Invalid regression percentage");
+            break;
+        default:
+            return ARGP_ERR_UNKNOWN;
+    }
+
+    return 0;
+}
+
+static void add_result(ResultList *results, const char *key, const double value) {
+
+    if (results->size == MAX_RESULTS) {
+        fprintf(stderr, "[ERROR] Too many benchmark results\n");
+        exit(EXIT_FAILURE);
+    }
+
+    Result *result = &results->result[results->size++];
+    snprintf(result->key, sizeof(result->key), "%s", key);
+    result->value = value;
+}
+
+static const Result *find_result(const ResultList *results, const char *key) {
+
+    if (results == NULL)
+        return NULL;
+
+    for (int i = 0; i < results->size; i++) {
+        if (strcmp(results->result[i].key, key) == 0)
+            return &results->result[i];
+    }
+
+    return NULL;
+}
+
+// One "<key> <value>" pair per line, lines starting with # are comments
+static void load_baseline(const char *file_path, ResultList *baseline) {
+
+    FILE *file = fopen(file_path, "r");
+    if (file == NULL) {
+        fprintf(stderr, "[ERROR] Could not open the baseline '%s'\n", file_path);
+        exit(EXIT_FAILURE);
+    }
+
+    char line[256];
+    while (fgets(line, sizeof(line), file) != NULL) {
+        char key[MAX_KEY_LENGTH];
+        double value;
+        if (line[0] == '#' || sscanf(line, "%95s %lf", key, &value) != 2)
+            continue;
+        add_result(baseline, key, value);
+    }
+
+    fclose(file);
+}
+
+static void save_baseline(const char *file_path, const ResultList *results) {
+
+    FILE *file = fopen(file_path, "w");
+    if (file == NULL) {
+        fprintf(stderr, "[ERROR] Could not open '%s' for writing\n", file_path);
+        exit(EXIT_FAILURE);
+    }
+
+    fprintf(file, "# video_effects_bench baseline: micro results in ns/pixel, speedups against the scalar kernels, "
+                  "end-to-end results in frames/s, demux results in MB/s\n");
+    for (int i = 0; i < results->size; i++)
+        fprintf(file, "%s %.4f\n", results->result[i].key, results->result[i].value);
+
+    if (ferror(file) || fclose(file) != 0) {
+        fprintf(stderr, "[ERROR] Could not write the baseline '%s'\n", file_path);
+        exit(EXIT_FAILURE);
+    }
+}
+
+// The micro results are times, the speedups against the scalar kernels and all other results are rates
+static bool is_higher_better(const char *key) {
+    return strncmp(key, "micro/", 6) != 0;
+}
+
+static bool is_speedup(const char *key) {
+    return strncmp(key, "speedup/", 8) == 0;
+}
+
+static double get_change(const Result *previous, const double value) {
+    return (value - previous->value) / previous->value;
+}
+
+static bool is_regression(const double change, const bool higher_is_better, const double tolerance) {
+    return higher_is_better ? change < -tolerance : change > tolerance;
+}
+
+// Prints the change against the baseline, e.g. "+3.2%" or "-15.0% REGRESSION"
+static void print_comparison(const ResultList *baseline, const char *key, const double value,
+                             const bool higher_is_better) {
+
+    const Result *previous = find_result(baseline, key);
+    if (previous == NULL || previous->value <= 0) {
+        printf("\n");
+        return;
+    }
+
+    const double change = get_change(previous, value);
+    const bool worse = is_regression(change, higher_is_better, BASELINE_TOLERANCE);
+
+    printf("  %+6.1f%%%s\n", change * 100, worse ? " REGRESSION" : "");
+}
+
+// A speedup is also a regression without a baseline if the kernels lost against the scalar ones. Other results
+// without a baseline value are not counted.
+static int count_regressions(const ResultList *baseline, const ResultList *results, const double tolerance) {
+
+    int regressions = 0;
+    for (int i = 0; i < results->size; i++) {
+        const Result *result = &results->result[i];
+
+        if (is_speedup(result->key) && result->value < 1 - tolerance) {
+            fprintf(stderr, "[ERROR] %s: %.2fx, slower than the scalar kernels\n", result->key, result->value);
+            regressions++;
+            continue;
+        }
+
+        const Result *previous = find_result(baseline, result->key);
+        if (previous == NULL || previous->value <= 0)
+            continue;
+
+        const double change = get_change(previous, result->value);
+        if (is_regression(change, is_higher_better(result->key), tolerance)) {
+            fprintf(stderr, "[ERROR] %s: %+.1f%% against the baseline\n", result->key, change * 100);
+            regressions++;
+        }
+    }
+
+    return regressions;
+}
+
+static double time_micro_operation(const MicroOperation operation, const MicroCase *bench) {
+
+    // the first run builds the scale tables and grows the region buffer
+    operation(bench);
+
+    int iterations = 0;
+    const int64_t start = stats_now();
+    int64_t elapsed;
+    do {
+        operation(bench);
+        iterations++;
+        elapsed = stats_now() - start;
+    } while (elapsed < MIN_BENCH_TIME || iterations < MIN_ITERATIONS);
+
+    return (double) elapsed / iterations;
+}
+
+// With other kernels than the scalar ones, the case is timed with the scalar kernels as well. Their ratio holds on
+// any machine, so it is checked even without a baseline.
+static void run_micro_case(const MicroBench *micro, MicroCase *bench, const Resolution *resolution,
+                           const ResultList *baseline, ResultList *results) {
+
+    const int region_width = bench->end[0].x - bench->start[0].x;
+    const int region_height = bench->end[0].y - bench->start[0].y;
+    const double pixels = (double) region_width * region_height * bench->count * micro->pixels;
+
+    const RowKernels *kernels = get_row_kernels();
+    const RowKernels *scalar = find_row_kernels("scalar");
+
+    const double nanoseconds = time_micro_operation(micro->operation, bench);
+    const double ns_per_pixel = nanoseconds / pixels;
+    const double gigabytes_per_second = pixels * bench->pixel_step * micro->bytes / nanoseconds;
+
+    double speedup = 1.0;
+    if (kernels != scalar) {
+        use_row_kernels(scalar);
+        speedup = time_micro_operation(micro->operation, bench) / nanoseconds;
+        use_row_kernels(kernels);
+    }
+
+    char name[32];
+    if (micro->scaled)
+        snprintf(name, sizeof(name), "%s-%.2f", micro->name, bench->scale_factor);
+    else
+        snprintf(name, sizeof(name), "%s", micro->name);
+
+    char key[MAX_KEY_LENGTH];
+    snprintf(key, sizeof(key), "micro/%s/%s/%d", name, resolution->name, bench->count);
+    add_result(results, key, ns_per_pixel);
+
+    char speedup_key[MAX_KEY_LENGTH];
+    snprintf(speedup_key, sizeof(speedup_key), "speedup/%s/%s/%s/%d", kernels->name, name, resolution->name,
+             bench->count);
+    if (kernels != scalar)
+        add_result(results, speedup_key, speedup);
+
+    printf("%-12s %-6s %7d %10.3f %8.2f %8.2fx%s", name, resolution->name, bench->count, ns_per_pixel,
+           gigabytes_per_second, speedup, speedup < 1 - BASELINE_TOLERANCE ? " SLOWER THAN SCALAR" : "");
+    print_comparison(baseline, key, ns_per_pixel, false);
+}
+
+static void run_micro_benchmarks(const BenchOptions *options, WorkerPool *pool, const ResultList *baseline,
+                                 ResultList *results) {
+
+    const int pixel_step = options->working_format == WORKING_FORMAT_RGB0 ? 4 : 3;
+
+    printf("Region operations (%s, %s kernels)\n", pixel_step == 4 ? "rgb0" : "rgb24", get_row_kernels()->name);
+    printf("%-12s %-6s %7s %10s %8s %9s\n", "operation", "size", "regions", "ns/pixel", "GB/s", "vs scalar");
+
+    for (int r = 0; r < sizeof(resolutions) / sizeof(resolutions[0]); r++) {
+        const Resolution *resolution = &resolutions[r];
+
+        const int linesize = FFALIGN(resolution->width * pixel_step, WORKING_FORMAT_ALIGN);
+        const size_t frame_size = (size_t) linesize * resolution->height;
+        uint8_t *pixel = av_malloc(frame_size);
+        NOT_NULL(pixel);
+        for (size_t i = 0; i < frame_size; i++)
+            pixel[i] = (uint8_t) (i * 7 + i / linesize);
+
+        Regions region_data;
+        Config data;
+        init_config(&data, &region_data);
+        data.pool = pool;
+
+        MicroCase bench = {
+            .data = &data,
+            .pixel = pixel,
+            .linesize = linesize,
+            .pixel_step = pixel_step
+        };
+
+        const int cell_width = resolution->width / GRID;
+        const int cell_height = resolution->height / GRID;
+        for (int i = 0; i < GRID * GRID; i++) {
+            bench.start[i] = (Pixel) { (unsigned short) (i % GRID * cell_width), (unsigned short) (i / GRID * cell_height) };
+            bench.end[i] = (Pixel) { (unsigned short) (bench.start[i].x + cell_width),
+                                     (unsigned short) (bench.start[i].y + cell_height) };
+        }
+
+        // copy_region_pixels() only reads one region into the buffer that scale_pixels() uses
+        data.buffer_size = (size_t) cell_width * cell_height * pixel_step + ROW_GATHER_PADDING;
+        data.buffer = malloc(data.buffer_size);
+        NOT_NULL(data.buffer);
+
+        for (int c = 0; c < sizeof(region_counts) / sizeof(region_counts[0]); c++) {
+            bench.count = region_counts[c];
+
+            for (int m = 0; m < sizeof(micro_benches) / sizeof(micro_benches[0]); m++) {
+                const MicroBench *micro = &micro_benches[m];
+
+                if (!micro->scaled) {
+                    run_micro_case(micro, &bench, resolution, baseline, results);
+                    continue;
+                }
+
+                for (int s = 0; s < sizeof(scale_factors) / sizeof(scale_factors[0]); s++) {
+                    bench.scale_factor = scale_factors[s];
+                    run_micro_case(micro, &bench, resolution, baseline, results);
+                }
+            }
+        }
+
+        // scale_pixels() may have moved the buffer with realloc()
+        free(data.buffer);
+        free_scale_cache(data.scale_cache);
+        av_free(pixel);
+    }
+
+    printf("\n");
+}
+
+typedef struct EndToEndMode {
+    const char *name;
+    int pipeline_depth;
+    bool force_rgb;
+    bool full_frame;
+} EndToEndMode;
+
+static const EndToEndMode end_to_end_modes[] = {
+    { "serial", 0, false, false },
+    { "pipeline", DEFAULT_PIPELINE_DEPTH, false, false },
+    { "rgb-full-frame", DEFAULT_PIPELINE_DEPTH, true, true }
+};
+
+static const char *effect_names[] = { "", "scaling", "swap", "move" };
+
+static void make_temporary_path(char *path, const size_t size) {
+
+    const char *directory = getenv("TMPDIR");
+    snprintf(path, size, "%s/video-effects-bench-XXXXXX.mkv", directory != NULL ? directory : "/tmp");
+
+    const int fd = mkstemps(path, 4);
+    if (fd < 0) {
+        fprintf(stderr, "[ERROR] Could not create a temporary file in '%s'\n", directory != NULL ? directory : "/tmp");
+        exit(EXIT_FAILURE);
+    }
+    close(fd);
+}
+
+static const EffectType chain_effects[] = { EFFECT_ONE, EFFECT_TWO, EFFECT_THREE };
+#define CHAIN_LENGTH ((int) (sizeof(chain_effects) / sizeof(chain_effects[0])))
+
+// One pipelined run with the given filters as -f chain, returns the time in nanoseconds and the processed frames.
+// Stage i of the chain draws its regions from the seed first_stage + i like in the tool.
+static int64_t time_effect_chain(const BenchOptions *options, WorkerPool *pool, const char *input_file,
+                                 const char *output_file, const int first_stage, const int count, uint64_t *frames) {
+
+    Regions region_data;
+    Regions chain_regions[MAX_EFFECT_CHAIN - 1];
+    Config data;
+    init_config(&data, &region_data);
+
+    data.effect_id = chain_effects[first_stage];
+    data.scale_factor = 1.5f;
+    data.input_file = (char *) input_file;
+    data.output_file = (char *) output_file;
+    data.working_format = options->working_format;
+    data.pool = pool;
+    data.seed = 1 + (unsigned int) first_stage * CHAIN_SEED_STEP;
+    data.seed_set = true;
+    region_data.seed = data.seed;
+
+    for (int i = 0; i < count - 1; i++) {
+        chain_regions[i] = (Regions) {
+            .region_pair = NULL,
+            .size = 0,
+            .seed = data.seed + (unsigned int) (i + 1) * CHAIN_SEED_STEP
+        };
+        data.chain[i] = chain_effects[first_stage + i + 1];
+        data.chain_regions[i] = &chain_regions[i];
+    }
+    data.chain_length = count - 1;
+
+    stats_reset();
+    stats_enabled = true;
+
+    const int64_t start = stats_now();
+    process_video(input_file, output_file, &data);
+    const int64_t elapsed = stats_now() - start;
+
+    stats_enabled = false;
+    *frames = get_stats_count(STATS_FRAME_LATENCY);
+
+    cleanup_regions(data.region_data);
+    for (int i = 0; i < data.chain_length; i++)
+        cleanup_regions(data.chain_regions[i]);
+    free(data.buffer);
+    free_scale_cache(data.scale_cache);
+
+    return elapsed;
+}
+
+// The chain of all filters in one pass against one run per filter through intermediate files, i.e. what piping
+// separate processes costs in decoding, converting and encoding
+static void run_chain_benchmarks(const BenchOptions *options, WorkerPool *pool, const char *input_file,
+                                 const char *output_file, const ResultList *baseline, ResultList *results) {
+
+    char intermediate_file[2][512];
+    make_temporary_path(intermediate_file[0], sizeof(intermediate_file[0]));
+    make_temporary_path(intermediate_file[1], sizeof(intermediate_file[1]));
+
+    uint64_t frames;
+    const int64_t fused = time_effect_chain(options, pool, input_file, output_file, 0, CHAIN_LENGTH, &frames);
+
+    int64_t separate = 0;
+    for (int i = 0; i < CHAIN_LENGTH; i++) {
+        const char *source = i == 0 ? input_file : intermediate_file[(i - 1) % 2];
+        const char *target = i == CHAIN_LENGTH - 1 ? output_file : intermediate_file[i % 2];
+        uint64_t pass_frames;
+        separate += time_effect_chain(options, pool, source, target, i, 1, &pass_frames);
+    }
+
+    const char *mode_names[] = { "fused", "separate" };
+    const int64_t elapsed[] = { fused, separate };
+    for (int m = 0; m < 2; m++) {
+        const double frames_per_second = frames * 1e9 / elapsed[m];
+
+        char key[MAX_KEY_LENGTH];
+        snprintf(key, sizeof(key), "end-to-end/chain/%s", mode_names[m]);
+        add_result(results, key, frames_per_second);
+
+        printf("%-8s %-15s %8.1f frames/s", "chain", mode_names[m], frames_per_second);
+        print_comparison(baseline, key, frames_per_second, true);
+    }
+
+    unlink(intermediate_file[0]);
+    unlink(intermediate_file[1]);
+}
+
+static void run_end_to_end_benchmarks(const BenchOptions *options, WorkerPool *pool, const ResultList *baseline,
+                                      ResultList *results) {
+
+    char input_file[512];
+    char output_file[512];
+    make_temporary_path(input_file, sizeof(input_file));
+    make_temporary_path(output_file, sizeof(output_file));
+
+    printf("End to end (synthetic %dx%d, %d frames)\n", options->width, options->height, options->frames);
+    generate_synthetic_video(input_file, options->width, options->height, options->frames, 30);
+
+    for (int effect = EFFECT_ONE; effect <= EFFECT_THREE; effect++) {
+        for (int m = 0; m < sizeof(end_to_end_modes) / sizeof(end_to_end_modes[0]); m++) {
+            const EndToEndMode *mode = &end_to_end_modes[m];
+
+            Regions region_data;
+            Config data;
+            init_config(&data, &region_data);
+
+            data.effect_id = effect;
+            data.scale_factor = 1.5f;
+            data.input_file = input_file;
+            data.output_file = output_file;
+            data.pipeline_depth = mode->pipeline_depth;
+            data.force_rgb = mode->force_rgb;
+            data.full_frame = mode->full_frame;
+            data.working_format = options->working_format;
+            data.pool = pool;
+            data.seed = 1;
+            data.seed_set = true;
+            region_data.seed = data.seed;
+
+            stats_reset();
+            stats_enabled = true;
+
+            const int64_t start = stats_now();
+            process_video(input_file, output_file, &data);
+            const int64_t elapsed = stats_now() - start;
+
+            stats_enabled = false;
+
+            const uint64_t frames = get_stats_count(STATS_FRAME_LATENCY);
+            const double frames_per_second = frames * 1e9 / elapsed;
+
+            char key[MAX_KEY_LENGTH];
+            snprintf(key, sizeof(key), "end-to-end/%s/%s", effect_names[effect], mode->name);
+            add_result(results, key, frames_per_second);
+
+            printf("%-8s %-15s %8.1f frames/s", effect_names[effect], mode->name, frames_per_second);
+            print_comparison(baseline, key, frames_per_second, true);
+
+            // time each stage spent per frame, the pipelined stages overlap
+            for (int timer = 0; timer < STATS_TIMER_COUNT; timer++) {
+                if (timer == STATS_FRAME_LATENCY || get_stats_count(timer) == 0 || frames == 0)
+                    continue;
+                printf("    %-24s %9.3f ms/frame\n", get_stats_timer_name(timer),
+                       get_stats_total(timer) / 1e6 / frames);
+            }
+            printf("    %-24s %9llu\n", "steady_allocations", (unsigned long long) get_steady_allocations());
+
+            cleanup_regions(data.region_data);
+            free(data.buffer);
+            free_scale_cache(data.scale_cache);
+        }
+    }
+
+    run_chain_benchmarks(options, pool, input_file, output_file, baseline, results);
+
+    unlink(input_file);
+    unlink(output_file);
+    printf("\n");
+}
+
+// Reads every packet of the input once, returns the time in nanoseconds and the payload bytes
+static int64_t time_demux(const char *input_file, const bool mapped, int64_t *bytes) {
+
+    AVFormatContext *format_context = NULL;
+    AVIOContext *io = NULL;
+
+    if (mapped) {
+        io = open_mapped_input(input_file);
+        if (io == NULL) {
+            fprintf(stderr, "[ERROR] Could not map '%s'\n", input_file);
+            exit(EXIT_FAILURE);
+        }
+        format_context = avformat_alloc_context();
+        NOT_NULL(format_context);
+        format_context->pb = io;
+        format_context->flags |= AVFMT_FLAG_CUSTOM_IO;
+    }
+
+    AVPacket *packet = av_packet_alloc();
+    NOT_NULL(packet);
+
+    const int64_t start = stats_now();
+
+    AV_NOT_NEGATIVE(avformat_open_input(&format_context, input_file, NULL, NULL));
+    *bytes = 0;
+    while (av_read_frame(format_context, packet) >= 0) {
+        *bytes += packet->size;
+        av_packet_unref(packet);
+    }
+
+    const int64_t elapsed = stats_now() - start;
+
+    av_packet_free(&packet);
+    avformat_close_input(&format_context);
+    close_mapped_input(&io);
+
+    return elapsed;
+}
+
+// The file is read once before the runs, so both readers are measured with the file in the page cache
+static void run_demux_benchmarks(const BenchOptions *options, const ResultList *baseline, ResultList *results) {
+
+    char synthetic_file[512];
+    const char *input_file = options->demux_input;
+
+    if (input_file == NULL) {
+        make_temporary_path(synthetic_file, sizeof(synthetic_file));
+        generate_synthetic_video(synthetic_file, options->width, options->height, options->frames, 30);
+        input_file = synthetic_file;
+    }
+
+    printf("Demux ('%s')\n", input_file);
+    printf("%-8s %10s %10s\n", "reader", "MB/s", "MB");
+
+    int64_t bytes;
+    time_demux(input_file, false, &bytes);
+
+    const char *reader_names[] = { "file", "mmap" };
+    for (int r = 0; r < 2; r++) {
+        int64_t best = INT64_MAX;
+        for (int i = 0; i < MIN_ITERATIONS; i++) {
+            const int64_t elapsed = time_demux(input_file, r == 1, &bytes);
+            best = FFMIN(best, elapsed);
+        }
+
+        const double megabytes_per_second = bytes / 1e6 / (best / 1e9);
+
+        char key[MAX_KEY_LENGTH];
+        snprintf(key, sizeof(key), "demux/%s", reader_names[r]);
+        add_result(results, key, megabytes_per_second);
+
+        printf("%-8s %10.1f %10.1f", reader_names[r], megabytes_per_second, bytes / 1e6);
+        print_comparison(baseline, key, megabytes_per_second, true);
+    }
+
+    if (options->demux_input == NULL)
+        unlink(synthetic_file);
+    printf("\n");
+}
+
+int main(int argc, char **argv) {
+
+    BenchOptions options = {
+        .suite = SUITE_ALL,
+        .baseline = NULL,
+        .save_baseline = NULL,
+        .frames = 120,
+        .width = 1920,
+        .height = 1080,
+        .working_format = WORKING_FORMAT_RGB24,
+        .kernels = "auto",
+        .bands = 0,
+        .demux_input = NULL,
+        .max_regression = -1.0
+    };
+
+    struct argp parser = { bench_options, parse_bench_option, NULL,
+                           "video_effects_bench -- Benchmarks of the region operations and the whole pipeline" };
+    argp_parse(&parser, argc, argv, 0, 0, &options);
+
+    static ResultList baseline;
+    static ResultList results;
+
+    if (options.baseline != NULL)
+        load_baseline(options.baseline, &baseline);
+
+    use_row_kernels(find_row_kernels(options.kernels));
+
+    WorkerPool pool;
+    WorkerPool *band_pool = NULL;
+    const int band_threads = (options.bands > 0 ? options.bands : get_core_count()) - 1;
+    if (options.bands != 1 && band_threads > 0) {
+        pool_init(&pool, band_threads, options.bands);
+        band_pool = &pool;
+    }
+
+    const ResultList *compare = options.baseline != NULL ? &baseline : NULL;
+
+    if (options.suite == SUITE_ALL || options.suite == SUITE_MICRO)
+        run_micro_benchmarks(&options, band_pool, compare, &results);
+
+    if (options.suite == SUITE_ALL || options.suite == SUITE_END_TO_END)
+        run_end_to_end_benchmarks(&options, band_pool, compare, &results);
+
+    if (options.suite == SUITE_ALL || options.suite == SUITE_DEMUX)
+        run_demux_benchmarks(&options, compare, &results);
+
+    if (band_pool != NULL)
+        pool_destroy(band_pool);
+
+    if (options.save_baseline != NULL)
+        save_baseline(options.save_baseline, &results);
+
+    // the speedups against the scalar kernels are checked with or without a baseline
+    if (options.max_regression >= 0) {
+        const int regressions = count_regressions(compare, &results, options.max_regression);
+        if (regressions > 0) {
+            fprintf(stderr, "[ERROR] %d result(s) more than %.0f%% worse than the baseline or the scalar kernels\n",
+                    regressions, options.max_regression * 100);
+            return EXIT_FAILURE;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,615 @@
+#include "synthetic.h"
+#include "video-effects.h"
+#include "cmdline.h"
+#include "region/region.h"
+#include "region/kernels.h"
+#include "region/scale.h"
+#include "region/timeline.h"
+#include "pipeline/pipeline.h"
+#include "pool/pool.h"
+#include "registry/registry.h"
+#include "smart/smart.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <argp.h>
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+#include <libavutil/adler32.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+
+// Synthetic clip and frames every case is processed from, small enough for "make check" and with two GOPs
+#define CHECK_WIDTH 320
+#define CHECK_HEIGHT 240
+#define CHECK_FRAMES 48
+#define CHECK_FRAME_RATE 24
+#define CHECK_SEED 1
+
+// Bands and threads of the threaded paths, independent of the cores of the machine
+#define CHECK_BANDS 4
+
+// Four GOPs in MPEG-TS, the second one is re-encoded by the smart rendering check and the others are copied
+#define SMART_FRAMES 96
+#define SMART_START 1.0
+#define SMART_END 1.5
+
+#define MAX_GOLDEN 64
+#define MAX_KEY_LENGTH 96
+
+typedef struct Golden {
+    char key[MAX_KEY_LENGTH];
+    uint32_t checksum;
+} Golden;
+
+typedef struct GoldenList {
+    Golden golden[MAX_GOLDEN];
+    int size;
+} GoldenList;
+
+typedef struct CheckOptions {
+    char *golden;
+    char *save_golden;
+} CheckOptions;
+
+// Filters of one run, with the seeds of main(): stage i of a chain draws from CHECK_SEED + i * CHAIN_SEED_STEP
+typedef struct CheckCase {
+    const char *name;
+    EffectType filters[MAX_EFFECT_CHAIN];
+    int filter_count;
+    float scale_factor;
+    ScaleFilter scale_filter;
+} CheckCase;
+
+static const CheckCase check_cases[] = {
+    { "scaling", { EFFECT_ONE }, 1, 1.5f, SCALE_NEAREST },
+    { "scaling-bilinear", { EFFECT_ONE }, 1, 0.5f, SCALE_BILINEAR },
+    { "swap", { EFFECT_TWO }, 1, 0.0f, SCALE_NEAREST },
+    { "move", { EFFECT_THREE }, 1, 0.0f, SCALE_NEAREST },
+    { "chain", { EFFECT_ONE, EFFECT_TWO, EFFECT_THREE }, 3, 1.5f, SCALE_NEAREST }
+};
+
+// Paths with the same output have to agree bit for bit, the first path of an output is the reference of the others
+typedef struct CheckPath {
+    const char *name;
+    // the golden value is stored per case and output
+    const char *output;
+    // NULL runs the path once with every kernel set the CPU supports
+    const char *kernels;
+    int pipeline_depth;
+    bool threaded;
+    bool force_rgb;
+    bool full_frame;
+} CheckPath;
+
+static const CheckPath check_paths[] = {
+    { "scalar", "rgb", "scalar", 0, false, true, true },
+    { "simd", "rgb", NULL, 0, false, true, true },
+    { "threaded", "rgb", "auto", DEFAULT_PIPELINE_DEPTH, true, true, true },
+    { "dirty-regions", "dirty-regions", "scalar", 0, false, true, false },
+    { "dirty-regions-threaded", "dirty-regions", "auto", DEFAULT_PIPELINE_DEPTH, true, true, false },
+    { "yuv-native", "yuv-native", "scalar", 0, false, false, false },
+    { "yuv-native-threaded", "yuv-native", "auto", DEFAULT_PIPELINE_DEPTH, true, false, false }
+};
+
+// Frames drawn in memory and hashed right after the effect. They never pass through a codec or libswscale, so
+// their checksums are the same with every FFmpeg build and are compared with check/golden.txt.
+typedef struct FramePath {
+    const char *name;
+    enum AVPixelFormat format;
+    // NULL runs the path once with every kernel set the CPU supports
+    const char *kernels;
+    bool threaded;
+} FramePath;
+
+static const FramePath frame_paths[] = {
+    { "rgb24", AV_PIX_FMT_RGB24, "scalar", false },
+    { "rgb24", AV_PIX_FMT_RGB24, NULL, false },
+    { "rgb24-threaded", AV_PIX_FMT_RGB24, "auto", true },
+    { "rgb0", AV_PIX_FMT_RGB0, "scalar", false },
+    { "rgb0", AV_PIX_FMT_RGB0, NULL, false },
+    { "rgb0-threaded", AV_PIX_FMT_RGB0, "auto", true },
+    { "yuv420p", AV_PIX_FMT_YUV420P, "scalar", false },
+    { "yuv420p", AV_PIX_FMT_YUV420P, NULL, false },
+    { "yuv420p-threaded", AV_PIX_FMT_YUV420P, "auto", true }
+};
+
+static const char *simd_kernels[] = { "sse2", "avx2", "avx512" };
+
+static const CheckCase smart_case = { "smart-render", { EFFECT_ONE }, 1, 1.5f, SCALE_NEAREST };
+
+struct argp_option check_options[] = {
+    {"golden", 'g', "FILE", 0, "Compare the checksums with golden values written by --save-golden"},
+    {"save-golden", 'w', "FILE", 0, "Store the checksums as new golden values"},
+    {0}
+};
+
+static error_t parse_check_option(int key, char *arg, struct argp_state *state) {
+
+    CheckOptions *options = state->input;
+
+    switch (key) {
+        case 'g':
+            options->golden = arg;
+            break;
+        case 'w':
+            options->save_golden = arg;
+            break;
+        default:
+            return ARGP_ERR_UNKNOWN;
+    }
+
+    return 0;
+}
+
+static void add_golden(GoldenList *list, const char *key, const uint32_t checksum) {
+
+    if (list->size == MAX_GOLDEN) {
+        fprintf(stderr, "[ERROR] Too many golden values\n");
+        exit(EXIT_FAILURE);
+    }
+
+    Golden *golden = &list->golden[list->size++];
+    snprintf(golden->key, sizeof(golden->key), "%s", key);
+    golden->checksum = checksum;
+}
+
+static const Golden *find_golden(const GoldenList *list, const char *key) {
+
+    for (int i = 0; i < list->size; i++) {
+        if (strcmp(list->golden[i].key, key) == 0)
+            return &list->golden[i];
+    }
+
+    return NULL;
+}
+
+// One "<key> <checksum>" pair per line, lines starting with # are comments
+static void load_golden(const char *file_path, GoldenList *list) {
+
+    FILE *file = fopen(file_path, "r");
+    if (file == NULL) {
+        fprintf(stderr, "[ERROR] Could not open the golden values '%s'\n", file_path);
+        exit(EXIT_FAILURE);
+    }
+
+    char line[256];
+    while (fgets(line, sizeof(line), file) != NULL) {
+        char key[MAX_KEY_LENGTH];
+        unsigned int checksum;
+        if (line[0] == '#' || sscanf(line, "%95s %x", key, &checksum) != 2)
+            continue;
+        add_golden(list, key, checksum);
+    }
+
+    fclose(file);
+}
+
+static void save_golden(const char *file_path, const GoldenList *list) {
+
+    FILE *file = fopen(file_path, "w");
+    if (file == NULL) {
+        fprintf(stderr, "[ERROR] Could not open '%s' for writing\n", file_path);
+        exit(EXIT_FAILURE);
+    }
+
+    fprintf(file, "# video_effects_check golden values: Adler-32 of the processed frames per case and format,\n");
+    fprintf(file, "# taken before any encoding and the same with every FFmpeg build.\n");
+    fprintf(file, "# Record new ones with \"make check-golden\" only when the output of an effect changes.\n");
+    for (int i = 0; i < list->size; i++)
+        fprintf(file, "%s %08x\n", list->golden[i].key, list->golden[i].checksum);
+
+    if (ferror(file) || fclose(file) != 0) {
+        fprintf(stderr, "[ERROR] Could not write the golden values '%s'\n", file_path);
+        exit(EXIT_FAILURE);
+    }
+}
+
+// The extension selects the format of the synthetic clips and outputs
+static void make_temporary_path(char *path, const size_t size, const char *extension) {
+
+    const char *directory = getenv("TMPDIR");
+    snprintf(path, size, "%s/video-effects-check-XXXXXX%s", directory != NULL ? directory : "/tmp", extension);
+
+    const int fd = mkstemps(path, (int) strlen(extension));
+    if (fd < 0) {
+        fprintf(stderr, "[ERROR] Could not create a temporary file in '%s'\n", directory != NULL ? directory : "/tmp");
+        exit(EXIT_FAILURE);
+    }
+    close(fd);
+}
+
+// Visible pixels only, the padding of the rows is not part of the frame
+static uint32_t update_frame_checksum(uint32_t checksum, const AVFrame *frame) {
+
+    const AVPixFmtDescriptor *descriptor = av_pix_fmt_desc_get(frame->format);
+    NOT_NULL(descriptor);
+
+    for (int plane = 0; plane < av_pix_fmt_count_planes(frame->format); plane++) {
+        const int bytes = av_image_get_linesize(frame->format, frame->width, plane);
+        AV_NOT_NEGATIVE(bytes);
+        const int chroma = plane == 1 || plane == 2;
+        const int rows = chroma ? AV_CEIL_RSHIFT(frame->height, descriptor->log2_chroma_h) : frame->height;
+
+        for (int y = 0; y < rows; y++)
+            checksum = av_adler32_update(checksum, frame->data[plane] + (ptrdiff_t) y * frame->linesize[plane], bytes);
+    }
+
+    return checksum;
+}
+
+// Damaged frames are errors, not frames the decoder conceals
+static void decode_into_checksum(AVCodecContext *decoder_context, const AVPacket *packet, AVFrame *frame,
+                                 uint32_t *checksum, int *frames) {
+
+    AV_NOT_NEGATIVE(avcodec_send_packet(decoder_context, packet));
+
+    int ret;
+    while ((ret = avcodec_receive_frame(decoder_context, frame)) >= 0) {
+        if (frame->decode_error_flags != 0 || (frame->flags & AV_FRAME_FLAG_CORRUPT)) {
+            fprintf(stderr, "[ERROR] Frame %d of the output is damaged\n", *frames);
+            exit(EXIT_FAILURE);
+        }
+        *checksum = update_frame_checksum(*checksum, frame);
+        (*frames)++;
+        av_frame_unref(frame);
+    }
+
+    if (ret != AVERROR(EAGAIN) && ret != AVERROR_EOF)
+        AV_NOT_NEGATIVE(ret);
+}
+
+// Adler-32 over the decoded frames of the video stream in presentation order, every decoding error is fatal
+static uint32_t checksum_video(const char *file_path, int *frames) {
+
+    AVFormatContext *format_context = NULL;
+    AV_NOT_NEGATIVE(avformat_open_input(&format_context, file_path, NULL, NULL));
+    AV_NOT_NEGATIVE(avformat_find_stream_info(format_context, NULL));
+
+    const AVCodec *decoder = NULL;
+    const int stream_index = av_find_best_stream(format_context, AVMEDIA_TYPE_VIDEO, -1, -1, &decoder, 0);
+    AV_NOT_NEGATIVE(stream_index);
+
+    AVCodecContext *decoder_context = avcodec_alloc_context3(decoder);
+    NOT_NULL(decoder_context);
+    AV_NOT_NEGATIVE(avcodec_parameters_to_context(decoder_context, format_context->streams[stream_index]->codecpar));
+    decoder_context->err_recognition = AV_EF_EXPLODE;
+    AV_NOT_NEGATIVE(avcodec_open2(decoder_context, decoder, NULL));
+
+    AVPacket *packet = av_packet_alloc();
+    AVFrame *frame = av_frame_alloc();
+    NOT_NULL(packet);
+    NOT_NULL(frame);
+
+    uint32_t checksum = 1;
+    *frames = 0;
+    while (av_read_frame(format_context, packet) >= 0) {
+        if (packet->stream_index == stream_index)
+            decode_into_checksum(decoder_context, packet, frame, &checksum, frames);
+        av_packet_unref(packet);
+    }
+    decode_into_checksum(decoder_context, NULL, frame, &checksum, frames);
+
+    av_frame_free(&frame);
+    av_packet_free(&packet);
+    avcodec_free_context(&decoder_context);
+    avformat_close_input(&format_context);
+
+    return checksum;
+}
+
+// The filters of the case with the seeds of main(), the chain stages draw from regions of their own
+static void init_case_config(const CheckCase *check, Config *data, Regions *region_data,
+                             Regions chain_regions[MAX_EFFECT_CHAIN - 1]) {
+
+    init_config(data, region_data);
+
+    data->effect_id = check->filters[0];
+    data->scale_factor = check->scale_factor;
+    data->scale_filter = check->scale_filter;
+    data->seed = CHECK_SEED;
+    data->seed_set = true;
+    region_data->seed = data->seed;
+
+    for (int i = 0; i < check->filter_count - 1; i++) {
+        chain_regions[i] = (Regions) {
+            .region_pair = NULL,
+            .size = 0,
+            .seed = data->seed + (unsigned int) (i + 1) * CHAIN_SEED_STEP
+        };
+        data->chain[i] = check->filters[i + 1];
+        data->chain_regions[i] = &chain_regions[i];
+    }
+    data->chain_length = check->filter_count - 1;
+}
+
+static void cleanup_case_config(Config *data) {
+    cleanup_regions(data->region_data);
+    for (int i = 0; i < data->chain_length; i++)
+        cleanup_regions(data->chain_regions[i]);
+    free(data->buffer);
+    free_scale_cache(data->scale_cache);
+}
+
+// The same pattern for every format and frame number, every visible byte of every plane is set
+static void draw_check_frame(AVFrame *frame, const int number) {
+
+    const AVPixFmtDescriptor *descriptor = av_pix_fmt_desc_get(frame->format);
+    NOT_NULL(descriptor);
+
+    for (int plane = 0; plane < av_pix_fmt_count_planes(frame->format); plane++) {
+        const int bytes = av_image_get_linesize(frame->format, frame->width, plane);
+        AV_NOT_NEGATIVE(bytes);
+        const int chroma = plane == 1 || plane == 2;
+        const int rows = chroma ? AV_CEIL_RSHIFT(frame->height, descriptor->log2_chroma_h) : frame->height;
+
+        for (int y = 0; y < rows; y++) {
+            uint8_t *row = frame->data[plane] + (ptrdiff_t) y * frame->linesize[plane];
+            for (int x = 0; x < bytes; x++)
+                row[x] = (uint8_t) (x * 7 + y * 13 + ((x >> 4) ^ (y >> 4)) * 32 + number * 29 + plane * 61);
+        }
+    }
+}
+
+static uint32_t run_frame_check(const CheckCase *check, const FramePath *path, const RowKernels *kernels,
+                                WorkerPool *pool) {
+
+    use_row_kernels(kernels);
+
+    Regions region_data;
+    Regions chain_regions[MAX_EFFECT_CHAIN - 1];
+    Config data;
+    init_case_config(check, &data, &region_data, chain_regions);
+    data.pool = path->threaded ? pool : NULL;
+
+    AVFrame *frame = av_frame_alloc();
+    NOT_NULL(frame);
+    frame->format = path->format;
+    frame->width = CHECK_WIDTH;
+    frame->height = CHECK_HEIGHT;
+    AV_NOT_NEGATIVE(av_frame_get_buffer(frame, WORKING_FORMAT_ALIGN));
+
+    // like open_encoder(), the scratch memory is reserved for the largest regions up front
+    const int pixel_step = path->format == AV_PIX_FMT_RGB0 ? 4 : path->format == AV_PIX_FMT_RGB24 ? 3 : 1;
+    reserve_chain_scratch(&data, CHECK_WIDTH, CHECK_HEIGHT, pixel_step);
+
+    uint32_t checksum = 1;
+    for (int i = 0; i < CHECK_FRAMES; i++) {
+        draw_check_frame(frame, i);
+        process_frame(frame, &data);
+        checksum = update_frame_checksum(checksum, frame);
+    }
+
+    av_frame_free(&frame);
+    cleanup_case_config(&data);
+
+    return checksum;
+}
+
+static uint32_t run_check(const CheckCase *check, const CheckPath *path, const RowKernels *kernels,
+                          WorkerPool *pool, const char *input_file, const char *output_file) {
+
+    use_row_kernels(kernels);
+
+    Regions region_data;
+    Regions chain_regions[MAX_EFFECT_CHAIN - 1];
+    Config data;
+    init_case_config(check, &data, &region_data, chain_regions);
+
+    data.input_file = (char *) input_file;
+    data.output_file = (char *) output_file;
+    data.pipeline_depth = path->pipeline_depth;
+    data.force_rgb = path->force_rgb;
+    data.full_frame = path->full_frame;
+    data.pool = path->threaded ? pool : NULL;
+
+    process_video(input_file, output_file, &data);
+
+    cleanup_case_config(&data);
+
+    int frames;
+    const uint32_t checksum = checksum_video(output_file, &frames);
+    if (frames != CHECK_FRAMES) {
+        fprintf(stderr, "[ERROR] %s/%s: the output has %d instead of %d frames\n", check->name, path->name, frames,
+                CHECK_FRAMES);
+        exit(EXIT_FAILURE);
+    }
+
+    return checksum;
+}
+
+// Joins copied and re-encoded GOPs, the output has to decode without a single error and keep every frame the
+// input decodes to. The plan has to know the same frames, or the regions end up on the wrong ones.
+// The frames themselves are encoded twice and not compared with anything.
+static int check_smart_render(const char *name, const char *input_file, const char *output_file) {
+
+    int input_frames;
+    checksum_video(input_file, &input_frames);
+
+    Regions region_data;
+    Regions chain_regions[MAX_EFFECT_CHAIN - 1];
+    Config data;
+    init_case_config(&smart_case, &data, &region_data, chain_regions);
+
+    Timeline planned;
+    init_timeline(&planned, 0, 0, data.effect_id, data.seed);
+
+    data.input_file = (char *) input_file;
+    data.output_file = (char *) output_file;
+    data.smart_render = true;
+    data.start_time = SMART_START;
+    data.end_time = SMART_END;
+    data.recorded_timeline = &planned;
+
+    process_video(input_file, output_file, &data);
+
+    cleanup_case_config(&data);
+
+    int frames;
+    const uint32_t checksum = checksum_video(output_file, &frames);
+    const bool complete = frames == input_frames;
+    const bool planned_all = planned.frame_count == input_frames;
+    free_timeline(&planned);
+
+    printf("%-18s %-24s %-8s %08x  %s\n", smart_case.name, name, "auto", checksum,
+           !complete ? "FRAMES MISSING" : !planned_all ? "PLAN DIFFERS FROM THE FRAMES" : "ok");
+    return complete && planned_all ? 0 : 1;
+}
+
+// Compares a checksum with the first one of its key and, without golden values to compare with, makes it the
+// reference of the other paths. Returns the number of failures.
+static int check_result(const char *key, const char *case_name, const char *path_name, const char *kernel_name,
+                        const uint32_t checksum, const GoldenList *golden, GoldenList *results) {
+
+    const Golden *reference = find_golden(results, key);
+    const Golden *expected = golden != NULL ? find_golden(golden, key) : NULL;
+
+    const char *status = "ok";
+    int failures = 0;
+    if (reference != NULL && reference->checksum != checksum) {
+        status = "DIFFERS FROM THE FIRST PATH";
+        failures++;
+    }
+    else if (reference == NULL && expected != NULL && expected->checksum != checksum) {
+        status = "DIFFERS FROM THE GOLDEN VALUE";
+        failures++;
+    }
+    else if (reference == NULL && golden != NULL && expected == NULL) {
+        status = "NO GOLDEN VALUE";
+        failures++;
+    }
+    else if (reference == NULL && golden == NULL) {
+        status = "ok, reference";
+    }
+
+    if (reference == NULL)
+        add_golden(results, key, checksum);
+
+    printf("%-18s %-24s %-8s %08x  %s\n", case_name, path_name, kernel_name, checksum, status);
+    return failures;
+}
+
+// The kernel sets of a path, every SIMD set the CPU can run if the path names none
+static int get_path_kernels(const char *name, const RowKernels *kernels[]) {
+
+    if (name != NULL) {
+        kernels[0] = find_row_kernels(name);
+        return 1;
+    }
+
+    int count = 0;
+    for (int k = 0; k < sizeof(simd_kernels) / sizeof(simd_kernels[0]); k++) {
+        const RowKernels *simd = find_row_kernels(simd_kernels[k]);
+        if (simd != NULL)
+            kernels[count++] = simd;
+    }
+
+    return count;
+}
+
+int main(int argc, char **argv) {
+
+    CheckOptions options = {
+        .golden = NULL,
+        .save_golden = NULL
+    };
+
+    struct argp parser = { check_options, parse_check_option, NULL,
+                           "video_effects_check -- Output checksums of every processing path with a fixed seed" };
+    argp_parse(&parser, argc, argv, 0, 0, &options);
+
+    static GoldenList golden;
+    static GoldenList frame_results;
+    static GoldenList output_results;
+
+    if (options.golden != NULL)
+        load_golden(options.golden, &golden);
+
+    WorkerPool pool;
+    pool_init(&pool, CHECK_BANDS - 1, CHECK_BANDS);
+
+    const RowKernels *kernels[sizeof(simd_kernels) / sizeof(simd_kernels[0])];
+    char key[MAX_KEY_LENGTH];
+    int failures = 0;
+
+    printf("Frames: %dx%d, %d frames, seed %d, compared with %s\n", CHECK_WIDTH, CHECK_HEIGHT, CHECK_FRAMES,
+           CHECK_SEED, options.golden != NULL ? options.golden : "the first path");
+    printf("%-18s %-24s %-8s %-8s  %s\n", "case", "path", "kernels", "checksum", "result");
+
+    for (int c = 0; c < sizeof(check_cases) / sizeof(check_cases[0]); c++) {
+        const CheckCase *check = &check_cases[c];
+
+        for (int p = 0; p < sizeof(frame_paths) / sizeof(frame_paths[0]); p++) {
+            const FramePath *path = &frame_paths[p];
+            snprintf(key, sizeof(key), "frame/%s/%s", check->name, av_get_pix_fmt_name(path->format));
+
+            const int kernel_count = get_path_kernels(path->kernels, kernels);
+            for (int k = 0; k < kernel_count; k++) {
+                const uint32_t checksum = run_frame_check(check, path, kernels[k], &pool);
+                failures += check_result(key, check->name, path->name, kernels[k]->name, checksum,
+                                         options.golden != NULL ? &golden : NULL, &frame_results);
+            }
+        }
+    }
+
+    // the encoded outputs depend on the FFmpeg build, only paths with the same output are compared
+    char input_file[512];
+    char output_file[512];
+    make_temporary_path(input_file, sizeof(input_file), ".mkv");
+    make_temporary_path(output_file, sizeof(output_file), ".mkv");
+
+    generate_synthetic_video(input_file, CHECK_WIDTH, CHECK_HEIGHT, CHECK_FRAMES, CHECK_FRAME_RATE);
+
+    printf("\nEncoded outputs: synthetic %dx%d, %d frames, seed %d, compared between the paths\n", CHECK_WIDTH,
+           CHECK_HEIGHT, CHECK_FRAMES, CHECK_SEED);
+    printf("%-18s %-24s %-8s %-8s  %s\n", "case", "path", "kernels", "checksum", "result");
+
+    for (int c = 0; c < sizeof(check_cases) / sizeof(check_cases[0]); c++) {
+        const CheckCase *check = &check_cases[c];
+
+        for (int p = 0; p < sizeof(check_paths) / sizeof(check_paths[0]); p++) {
+            const CheckPath *path = &check_paths[p];
+            snprintf(key, sizeof(key), "%s/%s", check->name, path->output);
+
+            const int kernel_count = get_path_kernels(path->kernels, kernels);
+            for (int k = 0; k < kernel_count; k++) {
+                const uint32_t checksum = run_check(check, path, kernels[k], &pool, input_file, output_file);
+                failures += check_result(key, check->name, path->name, kernels[k]->name, checksum, NULL,
+                                         &output_results);
+            }
+        }
+    }
+
+    unlink(input_file);
+    unlink(output_file);
+
+    printf("\nSmart rendering: synthetic %dx%d, %d frames, effect from %.1f s to %.1f s, decoded without errors\n",
+           CHECK_WIDTH, CHECK_HEIGHT, SMART_FRAMES, SMART_START, SMART_END);
+    make_temporary_path(input_file, sizeof(input_file), ".ts");
+    make_temporary_path(output_file, sizeof(output_file), ".ts");
+
+    use_row_kernels(find_row_kernels("auto"));
+    generate_synthetic_video(input_file, CHECK_WIDTH, CHECK_HEIGHT, SMART_FRAMES, CHECK_FRAME_RATE);
+    failures += check_smart_render("mpegts", input_file, output_file);
+
+    // starts with B-frames the decoder drops
+    generate_open_gop_video(input_file, CHECK_WIDTH, CHECK_HEIGHT, SMART_FRAMES + CHECK_FRAME_RATE,
+                            CHECK_FRAME_RATE);
+    failures += check_smart_render("mpegts, open GOP", input_file, output_file);
+
+    unlink(input_file);
+    unlink(output_file);
+    pool_destroy(&pool);
+
+    if (options.save_golden != NULL)
+        save_golden(options.save_golden, &frame_results);
+
+    if (failures > 0) {
+        fprintf(stderr, "[ERROR] %d checksum(s) differ\n", failures);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
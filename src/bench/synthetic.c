@@ -0,0 +1,138 @@
+#include "synthetic.h"
+#include "video-effects.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+#include <libavutil/avutil.h>
+
+// Diagonal gradient with vertical bars and a bright square moving across the frame, so that the encoder sees
+// motion and texture everywhere and the effects have something to work on
+static void draw_test_pattern(AVFrame *frame, const int index) {
+
+    const int width = frame->width;
+    const int height = frame->height;
+    const int square = height / 6;
+    const int square_x = (index * 8) % (width - square);
+    const int square_y = (index * 3) % (height - square);
+
+    for (int y = 0; y < height; y++) {
+        uint8_t *row = frame->data[0] + (ptrdiff_t) y * frame->linesize[0];
+        for (int x = 0; x < width; x++) {
+            const bool inside = x >= square_x && x < square_x + square && y >= square_y && y < square_y + square;
+            const int bar = (x * 8 / width) * 24;
+            row[x] = inside ? 235 : (uint8_t) (16 + ((x + y + index * 4) & 0x7f) + bar / 2);
+        }
+    }
+
+    for (int y = 0; y < height / 2; y++) {
+        uint8_t *u = frame->data[1] + (ptrdiff_t) y * frame->linesize[1];
+        uint8_t *v = frame->data[2] + (ptrdiff_t) y * frame->linesize[2];
+        for (int x = 0; x < width / 2; x++) {
+            u[x] = (uint8_t) (64 + (x * 128 / (width / 2)));
+            v[x] = (uint8_t) (64 + ((y + index) * 128 / (height / 2)) % 128);
+        }
+    }
+}
+
+// Drops the packets of the first skipped_gops GOPs
+static void write_encoded_packets(AVCodecContext *encoder_context, AVFormatContext *format_context,
+                                  const AVStream *stream, const AVFrame *frame, int *skipped_gops) {
+
+    AV_NOT_NEGATIVE(avcodec_send_frame(encoder_context, frame));
+
+    AVPacket packet = {};
+    while (avcodec_receive_packet(encoder_context, &packet) >= 0) {
+        if (*skipped_gops >= 0 && (packet.flags & AV_PKT_FLAG_KEY))
+            (*skipped_gops)--;
+        if (*skipped_gops >= 0) {
+            av_packet_unref(&packet);
+            continue;
+        }
+
+        packet.stream_index = stream->index;
+        av_packet_rescale_ts(&packet, encoder_context->time_base, stream->time_base);
+        AV_NOT_NEGATIVE(av_interleaved_write_frame(format_context, &packet));
+    }
+}
+
+static void encode_synthetic_video(const char *file_path, const int width, const int height, const int frame_count,
+                                   const int frame_rate, const int b_frames, int skipped_gops) {
+
+    const AVCodec *encoder = avcodec_find_encoder(AV_CODEC_ID_MPEG4);
+    NOT_NULL(encoder);
+
+    AVCodecContext *encoder_context = avcodec_alloc_context3(encoder);
+    NOT_NULL(encoder_context);
+
+    encoder_context->width = width;
+    encoder_context->height = height;
+    encoder_context->pix_fmt = AV_PIX_FMT_YUV420P;
+    encoder_context->time_base = (AVRational) { 1, frame_rate };
+    encoder_context->framerate = (AVRational) { frame_rate, 1 };
+    encoder_context->gop_size = frame_rate;
+    encoder_context->max_b_frames = b_frames;
+    encoder_context->bit_rate = (int64_t) width * height * frame_rate / 8;
+
+    AVFormatContext *format_context = NULL;
+    AV_NOT_NEGATIVE(avformat_alloc_output_context2(&format_context, NULL, NULL, file_path));
+
+    if (format_context->oformat->flags & AVFMT_GLOBALHEADER)
+        encoder_context->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+
+    AV_NOT_NEGATIVE(avcodec_open2(encoder_context, encoder, NULL));
+
+    AVStream *stream = avformat_new_stream(format_context, NULL);
+    NOT_NULL(stream);
+    AV_NOT_NEGATIVE(avcodec_parameters_from_context(stream->codecpar, encoder_context));
+    stream->time_base = encoder_context->time_base;
+
+    // the whole clip is muxed into a dynamic buffer and written out at once
+    AV_NOT_NEGATIVE(avio_open_dyn_buf(&format_context->pb));
+    AV_NOT_NEGATIVE(avformat_write_header(format_context, NULL));
+
+    AVFrame *frame = av_frame_alloc();
+    NOT_NULL(frame);
+    frame->format = AV_PIX_FMT_YUV420P;
+    frame->width = width;
+    frame->height = height;
+    AV_NOT_NEGATIVE(av_frame_get_buffer(frame, 0));
+
+    for (int i = 0; i < frame_count; i++) {
+        AV_NOT_NEGATIVE(av_frame_make_writable(frame));
+        draw_test_pattern(frame, i);
+        frame->pts = i;
+        write_encoded_packets(encoder_context, format_context, stream, frame, &skipped_gops);
+    }
+    write_encoded_packets(encoder_context, format_context, stream, NULL, &skipped_gops);
+
+    AV_NOT_NEGATIVE(av_write_trailer(format_context));
+
+    uint8_t *clip = NULL;
+    const int clip_size = avio_close_dyn_buf(format_context->pb, &clip);
+    format_context->pb = NULL;
+
+    FILE *file = fopen(file_path, "wb");
+    if (file == NULL || fwrite(clip, 1, clip_size, file) != (size_t) clip_size || fclose(file) != 0) {
+        fprintf(stderr, "[ERROR] Could not write the synthetic video '%s'\n", file_path);
+        exit(EXIT_FAILURE);
+    }
+
+    av_free(clip);
+    av_frame_free(&frame);
+    avformat_free_context(format_context);
+    avcodec_free_context(&encoder_context);
+}
+
+void generate_synthetic_video(const char *file_path, const int width, const int height, const int frame_count,
+                              const int frame_rate) {
+    encode_synthetic_video(file_path, width, height, frame_count, frame_rate, 0, 0);
+}
+
+// The B-frames in front of a keyframe refer to the GOP before it, so the clip starts with B-frames that can not
+// be decoded
+void generate_open_gop_video(const char *file_path, const int width, const int height, const int frame_count,
+                             const int frame_rate) {
+    encode_synthetic_video(file_path, width, height, frame_count, frame_rate, 2, 1);
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+// Encodes frame_count frames of a moving test pattern (MPEG-4 part 2 in the format of the file extension, e.g.
+// Matroska for .mkv) into memory and stores the clip in file_path, so the benchmarks do not depend on sample videos
+void generate_synthetic_video(const char *file_path, int width, int height, int frame_count, int frame_rate);
+
+// The same with two B-frames in a row and open GOPs, cut at the second keyframe so that the clip starts with the
+// leading B-frames of an open GOP. frame_count includes the frames of the cut GOP.
+void generate_open_gop_video(const char *file_path, int width, int height, int frame_count, int frame_rate);
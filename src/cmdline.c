@@ -1,22 +1,143 @@
 #include "cmdline.h"
+#include "pipeline/pipeline.h"
+#include "segment/segment.h"
+#include "region/kernels.h"
+#include "pool/pool.h"
+#include "batch/batch.h"
+#include "video-effects.h"
+#include "registry/registry.h"
+#include "io/writer.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <argp.h>
 #include <stdint.h>
+#include <string.h>
+#include <libavformat/avformat.h>
 
 const char *argp_program_version = "video-effects 2025-beta1";
 char doc[] = "A program that applies post-processing effects on a video";
 char args_doc[] = "";
 
+enum {
+    OPTION_PIPELINE_DEPTH = 0x100,
+    OPTION_SEGMENTS,
+    OPTION_SEED,
+    OPTION_FORCE_RGB,
+    OPTION_FULL_FRAME,
+    OPTION_KERNELS,
+    OPTION_SCALE_FILTER,
+    OPTION_WORKING_FORMAT,
+    OPTION_BANDS,
+    OPTION_EXPORT_TIMELINE,
+    OPTION_IMPORT_TIMELINE,
+    OPTION_STATS_JSON,
+    OPTION_BATCH,
+    OPTION_BATCH_JOBS,
+    OPTION_BATCH_RESULTS,
+    OPTION_TARGET,
+    OPTION_OUTPUT_FORMAT,
+    OPTION_IO_BUFFER_SIZE,
+    OPTION_NO_MMAP,
+    OPTION_WRITER_QUEUE,
+    OPTION_SYNC_EVERY,
+    OPTION_REALTIME,
+    OPTION_PREVIEW_SCALE,
+    OPTION_START,
+    OPTION_END,
+    OPTION_SMART_RENDER,
+    OPTION_INDEX,
+    OPTION_BUILD_INDEX,
+    OPTION_INDEX_FILE,
+    OPTION_PLUGIN
+};
+
 struct argp_option options[] = {
-    {"input", 'i', "FILE", 0, "Input video file"},
-    {"output", 'o', "FILE", 0, "Output video file"},
-    {"filter", 'f', "NUMBER", 0, "Effect type: 1 = Region Scaling, 2 = Region Swap, 3 = Region Move"},
+    {"input", 'i', "FILE", 0, "Input video file, - reads from stdin"},
+    {"output", 'o', "FILE", 0, "Output video file, - writes to stdout"},
+    {"filter", 'f', "NUMBER[,NUMBER...]", 0, "Effect type: 1 = Region Scaling, 2 = Region Swap, 3 = Region Move, a list like 1,2,3 applies them in this order"},
     {"scale", 's', "FLOAT", 0, "Scale factor (only for Region Scaling, between 0.1 and 3.0)"},
+    {"start", OPTION_START, "SECONDS", 0, "Only apply the effect to frames from this time on (default 0)"},
+    {"end", OPTION_END, "SECONDS", 0, "Only apply the effect to frames before this time (default: until the end)"},
+    {"realtime", OPTION_REALTIME, 0, 0, "Low latency encoding with a deadline per frame, late frames get a cheaper effect, none or are dropped"},
+    {"preview-scale", OPTION_PREVIEW_SCALE, "NUMBER", 0, "Render and encode a preview at 1/NUMBER of the width and height with a fast encoder preset, the regions match a full run with the same seed (default 1 = off)"},
+    {"smart-render", OPTION_SMART_RENDER, 0, 0, "Re-encode only the GOPs with modified frames and stream-copy all others"},
+    {"scale-filter", OPTION_SCALE_FILTER, "NAME", 0, "Interpolation for Region Scaling: nearest or bilinear (default nearest)"},
+    {"pipeline-depth", OPTION_PIPELINE_DEPTH, "NUMBER", 0, "Frames in flight between the threaded stages, 0 = single threaded (default 4)"},
+    {"bands", OPTION_BANDS, "NUMBER", 0, "Horizontal bands each frame is split into for conversion and effects, 0 = by frame height and cores, 1 = off (default 0)"},
+    {"segments", OPTION_SEGMENTS, "NUMBER", 0, "Split the input at keyframes into NUMBER segments that are processed in parallel"},
+    {"force-rgb", OPTION_FORCE_RGB, 0, 0, "Always apply the effects on RGB24 frames, even if the decoded format is supported natively"},
+    {"working-format", OPTION_WORKING_FORMAT, "NAME", 0, "Packed RGB format the effects work on: rgb24 or rgb0 (default rgb24)"},
+    {"full-frame", OPTION_FULL_FRAME, 0, 0, "Convert whole frames to RGB even if the effect only touches some regions"},
+    {"kernels", OPTION_KERNELS, "NAME", 0, "Row kernels for the region operations: auto, scalar, sse2, avx2 or avx512 (default auto)"},
+    {"seed", OPTION_SEED, "NUMBER", 0, "Seed for the random region decisions (default: current time)"},
+    {"export-timeline", OPTION_EXPORT_TIMELINE, "FILE", 0, "Write the planned regions of every frame to FILE"},
+    {"import-timeline", OPTION_IMPORT_TIMELINE, "FILE", 0, "Use the regions from a timeline written with --export-timeline instead of random ones"},
+    {"output-format", OPTION_OUTPUT_FORMAT, "NAME", 0, "Muxer of the output, e.g. mpegts, nut or mp4 (default: by file extension, mpegts for stdout)"},
+    {"io-buffer-size", OPTION_IO_BUFFER_SIZE, "BYTES", 0, "Buffer size for reading from stdin and writing the outputs (default 1048576)"},
+    {"writer-queue", OPTION_WRITER_QUEUE, "PACKETS", 0, "Packets queued for the thread that muxes and writes each output, 0 = write on the encoding thread (default 256)"},
+    {"sync-every", OPTION_SYNC_EVERY, "MIB", 0, "Flush the output files to the storage with fdatasync() after every MIB mebibytes, 0 = only the page cache (default 0)"},
+    {"index", OPTION_INDEX, 0, 0, "Read the stream parameters and keyframes from the sidecar index of the input, build it if it is missing or outdated"},
+    {"build-index", OPTION_BUILD_INDEX, 0, 0, "Only build the sidecar index of the input and exit"},
+    {"index-file", OPTION_INDEX_FILE, "FILE", 0, "Sidecar index to use instead of '<input>.vfxindex'"},
+    {"plugin", OPTION_PLUGIN, "FILE", 0, "Load the effect of a shared object as another filter, can be repeated"},
+    {"no-mmap", OPTION_NO_MMAP, 0, 0, "Read the input with the default file I/O instead of mapping it into memory"},
+    {"stats-json", OPTION_STATS_JSON, "FILE", 0, "Time every processing stage and write a JSON report with latency percentiles and memory use to FILE"},
+    {"target", OPTION_TARGET, "FILTER[,SCALE]:FILE", 0, "Also write FILE with another filter from the same decoded frames, can be repeated"},
+    {"batch", OPTION_BATCH, "FILE", 0, "Process every job of a manifest, one '<input> <output> <filter> [<scale>]' per line"},
+    {"batch-jobs", OPTION_BATCH_JOBS, "NUMBER", 0, "Jobs of --batch that run at the same time (default: number of cores)"},
+    {"batch-results", OPTION_BATCH_RESULTS, "FILE", 0, "Write the status and timing of every --batch job to FILE instead of stdout"},
     {0}
 };
 
+// FILTER[,SCALE]:FILE, the file name may contain further colons
+static void parse_target(char *arg, struct argp_state *state, Config *arguments) {
+
+    if (arguments->target_count == MAX_TARGETS)
+        argp_error(state, "At most %d targets are supported", MAX_TARGETS);
+
+    char *separator = strchr(arg, ':');
+    if (separator == NULL || separator[1] == '\0')
+        argp_error(state, "Invalid target. Expected: FILTER[,SCALE]:FILE");
+
+    char *end = NULL;
+    const long id = strtol(arg, &end, 10);
+    if (id <= NONE || id >= MAX_EFFECTS)
+        argp_error(state, "Invalid target filter. Expected: %d, %d, %d or the id of a plugin", EFFECT_ONE, EFFECT_TWO,
+                   EFFECT_THREE);
+
+    OutputTarget *target = &arguments->targets[arguments->target_count++];
+    target->effect_id = (EffectType) id;
+    target->scale_factor = *end == ',' ? strtof(end + 1, NULL) : 0.0f;
+    target->output_file = separator + 1;
+}
+
+// FILTER[,FILTER...], the first filter is effect_id and the others form the chain
+static void parse_filter_chain(const char *arg, struct argp_state *state, Config *arguments) {
+
+    arguments->chain_length = 0;
+
+    const char *current = arg;
+    for (int i = 0;; i++) {
+        char *end = NULL;
+        const long id = strtol(current, &end, 10);
+        if (end == current || (*end != ',' && *end != '\0') || id <= NONE || id >= MAX_EFFECTS)
+            argp_error(state, "Invalid filter value. Expected: %d, %d, %d or the id of a plugin, or a comma separated "
+                       "list of them", EFFECT_ONE, EFFECT_TWO, EFFECT_THREE);
+        if (i == MAX_EFFECT_CHAIN)
+            argp_error(state, "At most %d filters can be chained", MAX_EFFECT_CHAIN);
+
+        if (i == 0)
+            arguments->effect_id = (EffectType) id;
+        else
+            arguments->chain[arguments->chain_length++] = (EffectType) id;
+
+        if (*end == '\0')
+            break;
+        current = end + 1;
+    }
+}
+
 error_t parse_options(int key, char *arg, struct argp_state *state) {
 
     Config *arguments = state->input;
@@ -34,22 +155,107 @@ error_t parse_options(int key, char *arg, struct argp_state *state) {
             }
             break;
         case 'f':
-            if (arg) {
-                const uint8_t id = (uint8_t) strtol(arg, NULL, 10);
-                switch (id) {
-                    case 1:
-                        arguments->effect_id = EFFECT_ONE;
-                        break;
-                    case 2:
-                        arguments->effect_id = EFFECT_TWO;
-                        break;
-                    case 3:
-                        arguments->effect_id = EFFECT_THREE;
-                        break;
-                    default:
-                        argp_error(state, "Invalid filter value. Expected: %d, %d or %d", EFFECT_ONE, EFFECT_TWO, EFFECT_THREE);
-                }
-            }
+            if (arg)
+                parse_filter_chain(arg, state, arguments);
+            break;
+        case OPTION_SCALE_FILTER:
+            if (!parse_scale_filter(arg, &arguments->scale_filter))
+                argp_error(state, "Invalid scale filter. Expected: nearest or bilinear");
+            break;
+        case OPTION_PIPELINE_DEPTH:
+            arguments->pipeline_depth = (int) strtol(arg, NULL, 10);
+            break;
+        case OPTION_BANDS:
+            arguments->bands = (int) strtol(arg, NULL, 10);
+            break;
+        case OPTION_SEGMENTS:
+            arguments->segments = (int) strtol(arg, NULL, 10);
+            break;
+        case OPTION_FORCE_RGB:
+            arguments->force_rgb = true;
+            break;
+        case OPTION_WORKING_FORMAT:
+            if (strcmp(arg, "rgb24") == 0)
+                arguments->working_format = WORKING_FORMAT_RGB24;
+            else if (strcmp(arg, "rgb0") == 0)
+                arguments->working_format = WORKING_FORMAT_RGB0;
+            else
+                argp_error(state, "Invalid working format. Expected: rgb24 or rgb0");
+            break;
+        case OPTION_FULL_FRAME:
+            arguments->full_frame = true;
+            break;
+        case OPTION_SEED:
+            arguments->seed = (unsigned int) strtoul(arg, NULL, 10);
+            arguments->seed_set = true;
+            break;
+        case OPTION_EXPORT_TIMELINE:
+            arguments->export_timeline = arg;
+            break;
+        case OPTION_IMPORT_TIMELINE:
+            arguments->import_timeline = arg;
+            break;
+        case OPTION_KERNELS:
+            arguments->kernels = arg;
+            break;
+        case OPTION_OUTPUT_FORMAT:
+            arguments->output_format = arg;
+            break;
+        case OPTION_IO_BUFFER_SIZE:
+            arguments->io_buffer_size = (int) strtol(arg, NULL, 10);
+            break;
+        case OPTION_WRITER_QUEUE:
+            arguments->writer_queue = (int) strtol(arg, NULL, 10);
+            break;
+        case OPTION_SYNC_EVERY:
+            arguments->sync_bytes = strtoll(arg, NULL, 10) * (1 << 20);
+            break;
+        case OPTION_START:
+            arguments->start_time = strtod(arg, NULL);
+            break;
+        case OPTION_END:
+            arguments->end_time = strtod(arg, NULL);
+            break;
+        case OPTION_SMART_RENDER:
+            arguments->smart_render = true;
+            break;
+        case OPTION_REALTIME:
+            arguments->realtime = true;
+            break;
+        case OPTION_PREVIEW_SCALE:
+            arguments->preview_scale = (int) strtol(arg, NULL, 10);
+            break;
+        case OPTION_INDEX:
+            arguments->use_index = true;
+            break;
+        case OPTION_BUILD_INDEX:
+            arguments->build_index = true;
+            break;
+        case OPTION_INDEX_FILE:
+            arguments->index_file = arg;
+            break;
+        case OPTION_PLUGIN:
+            if (arguments->plugin_count == MAX_PLUGINS)
+                argp_error(state, "At most %d plugins can be loaded", MAX_PLUGINS);
+            arguments->plugins[arguments->plugin_count++] = arg;
+            break;
+        case OPTION_NO_MMAP:
+            arguments->no_mmap = true;
+            break;
+        case OPTION_STATS_JSON:
+            arguments->stats_json = arg;
+            break;
+        case OPTION_TARGET:
+            parse_target(arg, state, arguments);
+            break;
+        case OPTION_BATCH:
+            arguments->batch = arg;
+            break;
+        case OPTION_BATCH_JOBS:
+            arguments->batch_jobs = (int) strtol(arg, NULL, 10);
+            break;
+        case OPTION_BATCH_RESULTS:
+            arguments->batch_results = arg;
             break;
         default:
             return ARGP_ERR_UNKNOWN;
@@ -58,6 +264,66 @@ error_t parse_options(int key, char *arg, struct argp_state *state) {
     return 0;
 }
 
+void init_config(Config *data, Regions *region_data) {
+
+    *region_data = (Regions) {
+        .region_pair = NULL,
+        .size = 0,
+        .seed = 0,
+        .frame = 0,
+        .draw = 0
+    };
+
+    *data = (Config) {
+        .region_data = region_data,
+        .effect_id = NONE,
+        .chain_length = 0,
+        .plugin_count = 0,
+        .scale_factor = 0.0f,
+        .scale_filter = SCALE_NEAREST,
+        .buffer = NULL,
+        .buffer_size = 0,
+        .scale_cache = NULL,
+        .scratch_owner = NULL,
+        .input_file = NULL,
+        .output_file = NULL,
+        .output_format = NULL,
+        .io_buffer_size = DEFAULT_IO_BUFFER_SIZE,
+        .writer_queue = DEFAULT_WRITER_QUEUE,
+        .sync_bytes = 0,
+        .no_mmap = false,
+        .use_index = false,
+        .build_index = false,
+        .index_file = NULL,
+        .index = NULL,
+        .start_time = 0.0,
+        .end_time = -1.0,
+        .smart_render = false,
+        .realtime = false,
+        .preview_scale = 1,
+        .source_width = 0,
+        .source_height = 0,
+        .pipeline_depth = DEFAULT_PIPELINE_DEPTH,
+        .force_rgb = false,
+        .working_format = WORKING_FORMAT_RGB24,
+        .full_frame = false,
+        .segments = 0,
+        .bands = 0,
+        .pool = NULL,
+        .seed = 0,
+        .seed_set = false,
+        .timeline = NULL,
+        .recorded_timeline = NULL,
+        .import_timeline = NULL,
+        .export_timeline = NULL,
+        .kernels = "auto",
+        .stats_json = NULL,
+        .batch = NULL,
+        .batch_results = NULL,
+        .batch_jobs = 0
+    };
+}
+
 int parse_cmdline(int argc, char **argv, Config *data) {
     struct argp parser = { options, parse_options, args_doc, doc };
     const int res = argp_parse(&parser, argc, argv, 0, 0, data);
@@ -70,11 +336,124 @@ int parse_cmdline(int argc, char **argv, Config *data) {
     return res;
 }
 
+static bool check_common_arguments(const Config *data) {
+
+    uint8_t errors = 0;
+
+    if (data->pipeline_depth < 0 || data->pipeline_depth > MAX_PIPELINE_DEPTH) {
+        fprintf(stderr, "[ERROR] Invalid pipeline depth: --pipeline-depth=<number> must be between 0 and %d\n",
+                MAX_PIPELINE_DEPTH);
+        errors++;
+    }
+
+    if (data->bands < 0 || data->bands > MAX_BANDS) {
+        fprintf(stderr, "[ERROR] Invalid band count: --bands=<number> must be between 0 and %d\n", MAX_BANDS);
+        errors++;
+    }
+
+    if (data->segments < 0 || data->segments > MAX_SEGMENTS) {
+        fprintf(stderr, "[ERROR] Invalid segment count: --segments=<number> must be between 0 and %d\n", MAX_SEGMENTS);
+        errors++;
+    }
+
+    if (data->start_time < 0 || (data->end_time >= 0 && data->end_time <= data->start_time)) {
+        fprintf(stderr, "[ERROR] Invalid time range: --start=<seconds> must be at least 0 and before --end=<seconds>\n");
+        errors++;
+    }
+
+    if (data->io_buffer_size < MIN_IO_BUFFER_SIZE || data->io_buffer_size > MAX_IO_BUFFER_SIZE) {
+        fprintf(stderr, "[ERROR] Invalid buffer size: --io-buffer-size=<bytes> must be between %d and %d\n",
+                MIN_IO_BUFFER_SIZE, MAX_IO_BUFFER_SIZE);
+        errors++;
+    }
+
+    if (data->writer_queue < 0 || data->writer_queue > MAX_WRITER_QUEUE) {
+        fprintf(stderr, "[ERROR] Invalid queue size: --writer-queue=<packets> must be between 0 and %d\n",
+                MAX_WRITER_QUEUE);
+        errors++;
+    }
+
+    if (data->sync_bytes < 0) {
+        fprintf(stderr, "[ERROR] Invalid sync interval: --sync-every=<MiB> must not be negative\n");
+        errors++;
+    }
+
+    if (data->preview_scale < 1 || data->preview_scale > MAX_PREVIEW_SCALE) {
+        fprintf(stderr, "[ERROR] Invalid preview scale: --preview-scale=<number> must be between 1 and %d\n",
+                MAX_PREVIEW_SCALE);
+        errors++;
+    }
+
+    if (data->output_format != NULL && av_guess_format(data->output_format, NULL, NULL) == NULL) {
+        fprintf(stderr, "[ERROR] Unknown output format: --output-format=%s\n", data->output_format);
+        errors++;
+    }
+
+    if (find_row_kernels(data->kernels) == NULL) {
+        fprintf(stderr, "[ERROR] Unknown or unsupported kernels: --kernels=<name> must be one of %s on this CPU\n",
+                row_kernel_names());
+        errors++;
+    }
+
+    return errors == 0;
+}
+
+// the jobs bring their own input, output, filter and scale, those are checked per job
+static int validate_batch_arguments(const Config *data) {
+
+    uint8_t errors = check_common_arguments(data) ? 0 : 1;
+
+    if (data->input_file != NULL || data->output_file != NULL || data->effect_id != NONE || data->target_count > 0) {
+        fprintf(stderr, "[ERROR] --input, --output, --filter and --target are given per job in the --batch manifest\n");
+        errors++;
+    }
+
+    if (data->segments > 1 || data->import_timeline != NULL || data->export_timeline != NULL) {
+        fprintf(stderr, "[ERROR] --segments and the region timelines can not be combined with --batch\n");
+        errors++;
+    }
+
+    if (data->smart_render || data->realtime || data->use_index || data->build_index) {
+        fprintf(stderr, "[ERROR] --smart-render, --realtime and the sidecar index can not be combined with --batch\n");
+        errors++;
+    }
+
+    if (data->batch_jobs < 0 || data->batch_jobs > MAX_BATCH_WORKERS) {
+        fprintf(stderr, "[ERROR] Invalid job count: --batch-jobs=<number> must be between 0 and %d\n",
+                MAX_BATCH_WORKERS);
+        errors++;
+    }
+
+    return errors > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+// --build-index only needs the input
+static int validate_index_arguments(const Config *data) {
+
+    if (data->input_file == NULL) {
+        fprintf(stderr, "[ERROR] Missing required argument: --input=<file> (-i <file>)\n");
+        return EXIT_FAILURE;
+    }
+
+    if (is_pipe_path(data->input_file)) {
+        fprintf(stderr, "[ERROR] stdin can not be indexed\n");
+        return EXIT_FAILURE;
+    }
+
+    return check_common_arguments(data) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
 // only being triggered when argp_parse() doesn't exit, e.g. --help
 int validate_arguments(const Config *data) {
 
     uint8_t errors = 0;
 
+    if (data->batch != NULL)
+        return validate_batch_arguments(data);
+
+    if (data->build_index)
+        return validate_index_arguments(data);
+
     if (data->input_file == NULL) {
         fprintf(stderr, "[ERROR] Missing required argument: --input=<file> (-i <file>)\n");
         errors++;
@@ -87,20 +466,114 @@ int validate_arguments(const Config *data) {
         fprintf(stderr, "[ERROR] Missing required argument: --filter=<number>\n");
         errors++;
     }
-    if (data->effect_id == EFFECT_ONE && (data->scale_factor <= 0 || data->scale_factor > 3)) {
+    // the filters are checked here, the plugins are only loaded after parsing
+    bool scaling = false;
+    for (int i = 0; i <= data->chain_length; i++) {
+        const EffectType id = i == 0 ? data->effect_id : data->chain[i - 1];
+        const EffectDescriptor *effect = find_effect(id);
+        if (effect == NULL && id != NONE) {
+            fprintf(stderr, "[ERROR] Unknown filter %d: it is neither built in nor provided by a --plugin\n", id);
+            errors++;
+        }
+        scaling = scaling || (effect != NULL && (effect->capabilities & EFFECT_SCALED));
+    }
+
+    if (scaling && (data->scale_factor <= 0 || data->scale_factor > 3)) {
         fprintf(stderr, "[ERROR] Invalid scale factor: --scale=<float> must be greater than 0 or smaller than 3 for Region Scaling\n");
         errors++;
     }
 
+    for (int i = 0; i < data->target_count; i++) {
+        const OutputTarget *target = &data->targets[i];
+        const EffectDescriptor *effect = find_effect(target->effect_id);
+        if (effect == NULL) {
+            fprintf(stderr, "[ERROR] Unknown filter %d for --target=%d:%s\n", target->effect_id, target->effect_id,
+                    target->output_file);
+            errors++;
+        } else if ((effect->capabilities & EFFECT_SCALED) && (target->scale_factor <= 0 || target->scale_factor > 3)) {
+            fprintf(stderr, "[ERROR] Invalid scale factor for --target=%d,<float>:%s, it must be greater than 0 and at most 3\n",
+                    target->effect_id, target->output_file);
+            errors++;
+        }
+    }
+
+    if (data->target_count > 0 && (data->segments > 1 || data->import_timeline != NULL || data->export_timeline != NULL)) {
+        fprintf(stderr, "[ERROR] --segments and the region timelines can not be combined with --target\n");
+        errors++;
+    }
+
+    // the region stacks of a chain are planned frame by frame, there is no timeline that holds all of them
+    if (data->chain_length > 0 && (data->segments > 1 || data->target_count > 0 || data->smart_render ||
+                                   data->import_timeline != NULL || data->export_timeline != NULL)) {
+        fprintf(stderr, "[ERROR] A filter chain can not be combined with --segments, --target, --smart-render or the region timelines\n");
+        errors++;
+    }
+
+    // segments, smart rendering and the timelines rely on a frame looking the same whenever it is processed
+    const bool replayed = data->segments > 1 || data->smart_render || data->import_timeline != NULL ||
+                          data->export_timeline != NULL;
+    if (replayed && data->effect_id != NONE && !(get_chain_capabilities(data) & EFFECT_DETERMINISTIC)) {
+        fprintf(stderr, "[ERROR] --segments, --smart-render and the region timelines need a deterministic filter\n");
+        errors++;
+    }
+
+    int piped_outputs = data->output_file != NULL && is_pipe_path(data->output_file) ? 1 : 0;
+    for (int i = 0; i < data->target_count; i++)
+        if (is_pipe_path(data->targets[i].output_file))
+            piped_outputs++;
+
+    if (piped_outputs > 1) {
+        fprintf(stderr, "[ERROR] Only one output can be written to stdout\n");
+        errors++;
+    }
+
+    // smart rendering reads the input twice and writes a single output
+    if (data->smart_render && (data->segments > 1 || data->target_count > 0 ||
+                               (data->input_file != NULL && is_pipe_path(data->input_file)))) {
+        fprintf(stderr, "[ERROR] --smart-render can not be combined with --segments, --target or reading from stdin\n");
+        errors++;
+    }
+
+    // the deadlines follow a single stream of frames through the serial loop or the pipeline
+    if (data->realtime && (data->segments > 1 || data->target_count > 0 || data->smart_render)) {
+        fprintf(stderr, "[ERROR] --realtime can not be combined with --segments, --target or --smart-render\n");
+        errors++;
+    }
+
+    // smart rendering copies GOPs of the source size, segments and targets encode their frames on their own
+    if (data->preview_scale > 1 && (data->segments > 1 || data->target_count > 0 || data->smart_render)) {
+        fprintf(stderr, "[ERROR] --preview-scale can not be combined with --segments, --target or --smart-render\n");
+        errors++;
+    }
+
+    if (data->use_index && data->input_file != NULL && is_pipe_path(data->input_file)) {
+        fprintf(stderr, "[ERROR] --index needs an input file, not stdin\n");
+        errors++;
+    }
+
+    // the segments seek in the input and write the output in parts
+    if (data->segments > 1 && (piped_outputs > 0 || (data->input_file != NULL && is_pipe_path(data->input_file)))) {
+        fprintf(stderr, "[ERROR] --segments can not read from stdin or write to stdout\n");
+        errors++;
+    }
+
+    if (!check_common_arguments(data))
+        errors++;
+
     return errors > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
 
 }
 
-char *get_filter_name(const EffectType id) {
+const char *get_filter_name(const EffectType id) {
+
+    const EffectDescriptor *effect = find_effect(id);
+
+    return effect != NULL ? effect->name : "Unknown Effect";
+}
 
-    if (id == EFFECT_ONE) return "Region Transform";
-    if (id == EFFECT_TWO) return "Region Swap";
-    if (id == EFFECT_THREE) return "Region Move";
+void get_chain_name(const Config *data, char *name, const size_t size) {
 
-    return "Unknown Effect";
+    int length = snprintf(name, size, "%s", get_filter_name(data->effect_id));
+    for (int i = 0; i < data->chain_length && length >= 0 && (size_t) length < size; i++)
+        length += snprintf(name + length, size - length, " + %s", get_filter_name(data->chain[i]));
 }
\ No newline at end of file
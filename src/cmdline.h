@@ -1,9 +1,14 @@
 #pragma once
 
 #include "region/region.h"
+#include "region/scale.h"
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 typedef struct Regions Regions;
+typedef struct Timeline Timeline;
+typedef struct VideoIndex VideoIndex;
 
 typedef enum {
 
@@ -14,19 +19,126 @@ typedef enum {
 
 } EffectType;
 
+// Packed RGB layout the effects work on when frames have to be converted
+typedef enum {
+
+    WORKING_FORMAT_RGB24 = 0,
+    WORKING_FORMAT_RGB0 = 1
+
+} WorkingFormat;
+
+#define MAX_TARGETS 8
+#define MAX_PLUGINS 8
+
+// Effects of one -f chain, e.g. -f 1,2,3
+#define MAX_EFFECT_CHAIN 8
+// Seed distance between the region stacks of a chain, so repeated filters do not draw the same regions
+#define CHAIN_SEED_STEP 0x9e3779b9u
+
+// Another effect output of the same input, see --target
+typedef struct OutputTarget {
+    EffectType effect_id;
+    float scale_factor;
+    char *output_file;
+} OutputTarget;
+
 typedef struct Config {
 
     Regions *region_data;
     EffectType effect_id;
 
+    // -f with several filters: the effects after the first one, applied to the same frame in this order and each
+    // with its own region stack
+    EffectType chain[MAX_EFFECT_CHAIN - 1];
+    Regions *chain_regions[MAX_EFFECT_CHAIN - 1];
+    int chain_length;
+
     float scale_factor;
+    ScaleFilter scale_filter;
     uint8_t *buffer;
+    size_t buffer_size;
+    ScaleCache *scale_cache;
+    // the Config a render stage was copied from, the stage (re)allocates the scratch memory above in it
+    struct Config *scratch_owner;
+
+    // --bands, the pool is NULL when frames are processed by a single thread
+    int bands;
+    WorkerPool *pool;
 
     char *input_file;
     char *output_file;
 
+    // muxer name, needed when the output is stdout; buffer size of stdin and of the output I/O contexts
+    char *output_format;
+    int io_buffer_size;
+    // packets queued for the writer thread of each output, 0 muxes on the encoding thread; see io/writer.h
+    int writer_queue;
+    // fdatasync() of the output files after this many bytes, 0 never
+    int64_t sync_bytes;
+    // local input files are read through a memory mapping unless this is set
+    bool no_mmap;
+
+    // --plugin, shared objects with further effects, see registry/registry.h
+    char *plugins[MAX_PLUGINS];
+    int plugin_count;
+
+    // sidecar index of the input, see index/index.h; index is the loaded one for the input file
+    bool use_index;
+    bool build_index;
+    char *index_file;
+    const VideoIndex *index;
+
+    // decoded once and shared with the output above, see fanout/fanout.h
+    OutputTarget targets[MAX_TARGETS];
+    int target_count;
+
+    // --start/--end in seconds from the start of the video stream, a negative end means until the last frame
+    double start_time;
+    double end_time;
+
+    // stream-copy every GOP without modified frames, see smart/smart.h
+    bool smart_render;
+
+    // low latency encoding with per-frame deadlines, see realtime/realtime.h
+    bool realtime;
+
+    // --preview-scale: frames are rendered and encoded at 1/preview_scale of the source size, 1 is off. The regions
+    // are planned for the source_width x source_height frames, so a preview shows what a full run would.
+    int preview_scale;
+    int source_width;
+    int source_height;
+
+    int pipeline_depth;
+    bool force_rgb;
+    WorkingFormat working_format;
+    bool full_frame;
+    int segments;
+
+    unsigned int seed;
+    bool seed_set;
+
+    // a loaded timeline replaces the random planning, a recorded one collects the planned frames
+    const Timeline *timeline;
+    Timeline *recorded_timeline;
+    char *import_timeline;
+    char *export_timeline;
+
+    char *kernels;
+
+    // run report, see stats/stats.h
+    char *stats_json;
+
+    // manifest of jobs that replace --input, --output, --filter and --scale, see batch/batch.h
+    char *batch;
+    char *batch_results;
+    int batch_jobs;
+
 } Config;
 
+// Defaults for every option, region_data is reset and attached to data
+void init_config(Config *data, Regions *region_data);
 int parse_cmdline(int argc, char **argv, Config *data);
 int validate_arguments(const Config *data);
-char *get_filter_name(EffectType id);
\ No newline at end of file
+const char *get_filter_name(EffectType id);
+// Filter names of the whole -f chain, joined by " + "
+void get_chain_name(const Config *data, char *name, size_t size);
\ No newline at end of file
@@ -1,11 +1,34 @@
 #pragma once
 
 #include "cmdline.h"
+#include "registry/registry.h"
 
 typedef struct Config Config;
 
-void apply_effect_1(uint8_t *pixel, const int linesize, const int width, const int height, Config *data);
+// plan_effect_*() draws the region decisions of a frame, apply_effect_*() renders the planned regions
 
-void apply_effect_2(uint8_t *pixel, const int linesize, const int width, const int height, Config *data);
+void plan_effect_1(const int width, const int height, Config *data);
 
-void apply_effect_3(uint8_t *pixel, const int linesize, const int width, const int height, Config *data);
\ No newline at end of file
+void plan_effect_2(const int width, const int height, Config *data);
+
+void plan_effect_3(const int width, const int height, Config *data);
+
+void apply_effect_1(uint8_t *pixel, const int linesize, const int pixel_step, const int width, const int height,
+                    Config *data);
+
+void apply_effect_2(uint8_t *pixel, const int linesize, const int pixel_step, const int width, const int height,
+                    Config *data);
+
+void apply_effect_3(uint8_t *pixel, const int linesize, const int pixel_step, const int width, const int height,
+                    Config *data);
+
+void apply_effect_1_planar(const PlanarImage *image, Config *data);
+
+void apply_effect_2_planar(const PlanarImage *image, Config *data);
+
+void apply_effect_3_planar(const PlanarImage *image, Config *data);
+
+// Descriptions of the built-in effects, registered as filters 1, 2 and 3
+extern const EffectDescriptor region_scaling_effect;
+extern const EffectDescriptor region_swap_effect;
+extern const EffectDescriptor region_move_effect;
@@ -3,13 +3,39 @@
 #include "region/region.h"
 
 // Region Scaling
-void apply_effect_1(uint8_t *pixel, const int linesize, const int width, const int height, Config *data) {
-
+void plan_effect_1(const int width, const int height, Config *data) {
     randomize_single_region(data->region_data, width, height);
+}
+
+void apply_effect_1(uint8_t *pixel, const int linesize, const int pixel_step, const int width, const int height,
+                    Config *data) {
 
     for (int i = 0; i < data->region_data->size; i++) {
         const Region *current = &data->region_data->region_pair[i].one;
-        scale_pixels(data, pixel, linesize, data->scale_factor, &current->start, &current->end);
+        scale_pixels(data, pixel, linesize, pixel_step, data->scale_factor, &current->start, &current->end);
     }
 
-}
\ No newline at end of file
+}
+
+// Region Scaling on planar YUV frames
+void apply_effect_1_planar(const PlanarImage *image, Config *data) {
+
+    for (int i = 0; i < data->region_data->size; i++) {
+        const Region *current = &data->region_data->region_pair[i].one;
+        scale_pixels_planar(data, image, data->scale_factor, &current->start, &current->end);
+    }
+
+}
+
+const EffectDescriptor region_scaling_effect = {
+    .api_version = EFFECT_API_VERSION,
+    .id = EFFECT_ONE,
+    .name = "Region Transform",
+    .capabilities = EFFECT_PACKED_RGB | EFFECT_PLANAR_YUV | EFFECT_IN_PLACE | EFFECT_BAND_SAFE | EFFECT_DETERMINISTIC |
+                    EFFECT_SCALED,
+    // the region is copied into the scratch buffer and scaled back from there
+    .scratch_per_region = 1,
+    .plan = plan_effect_1,
+    .apply = apply_effect_1,
+    .apply_planar = apply_effect_1_planar
+};
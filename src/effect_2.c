@@ -3,14 +3,40 @@
 #include "region/region.h"
 
 // Region Swap
-void apply_effect_2(uint8_t *pixel, const int linesize, const int width, const int height, Config *data) {
-
+void plan_effect_2(const int width, const int height, Config *data) {
     randomize(data->region_data, width, height);
+}
+
+void apply_effect_2(uint8_t *pixel, const int linesize, const int pixel_step, const int width, const int height,
+                    Config *data) {
 
     for (int i = 0; i < data->region_data->size; i++) {
         const RegionPair *current = &data->region_data->region_pair[i];
-        swap_pixels(data, pixel, linesize, &current->one.start, &current->one.end, &current->two.start,
+        swap_pixels(data, pixel, linesize, pixel_step, &current->one.start, &current->one.end, &current->two.start,
                     &current->two.end);
     }
 
-}
\ No newline at end of file
+}
+
+// Region Swap on planar YUV frames
+void apply_effect_2_planar(const PlanarImage *image, Config *data) {
+
+    for (int i = 0; i < data->region_data->size; i++) {
+        const RegionPair *current = &data->region_data->region_pair[i];
+        swap_pixels_planar(data, image, &current->one.start, &current->one.end, &current->two.start,
+                           &current->two.end);
+    }
+
+}
+
+const EffectDescriptor region_swap_effect = {
+    .api_version = EFFECT_API_VERSION,
+    .id = EFFECT_TWO,
+    .name = "Region Swap",
+    .capabilities = EFFECT_PACKED_RGB | EFFECT_PLANAR_YUV | EFFECT_IN_PLACE | EFFECT_BAND_SAFE | EFFECT_DETERMINISTIC,
+    // chroma regions that share samples after rounding are swapped through the scratch buffer
+    .scratch_per_region = 1,
+    .plan = plan_effect_2,
+    .apply = apply_effect_2,
+    .apply_planar = apply_effect_2_planar
+};
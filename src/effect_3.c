@@ -3,13 +3,44 @@
 #include "region/region.h"
 
 // Region Move
-void apply_effect_3(uint8_t *pixel, const int linesize, const int width, const int height, Config *data) {
-
+void plan_effect_3(const int width, const int height, Config *data) {
     randomize_single_region(data->region_data, width, height);
+    randomize_moves(data->region_data, width, height);
+}
+
+void apply_effect_3(uint8_t *pixel, const int linesize, const int pixel_step, const int width, const int height,
+                    Config *data) {
+
+    for (int i = 0; i < data->region_data->size; i++) {
+        const RegionPair *current = &data->region_data->region_pair[i];
+        if (current->two.width == 0)
+            continue;
+        move_pixels(data, pixel, linesize, pixel_step, &current->one.start, &current->one.end, &current->two.start);
+    }
+
+}
+
+// Region Move on planar YUV frames
+void apply_effect_3_planar(const PlanarImage *image, Config *data) {
 
     for (int i = 0; i < data->region_data->size; i++) {
-        const Region *current = &data->region_data->region_pair[i].one;
-        move_pixels(data, pixel, linesize, width, height, &current->start, &current->end);
+        const RegionPair *current = &data->region_data->region_pair[i];
+        if (current->two.width == 0)
+            continue;
+        move_pixels_planar(data, image, &current->one.start, &current->one.end, &current->two.start);
     }
 
-}
\ No newline at end of file
+}
+
+const EffectDescriptor region_move_effect = {
+    .api_version = EFFECT_API_VERSION,
+    .id = EFFECT_THREE,
+    .name = "Region Move",
+    .capabilities = EFFECT_PACKED_RGB | EFFECT_PLANAR_YUV | EFFECT_IN_PLACE | EFFECT_BAND_SAFE | EFFECT_DETERMINISTIC |
+                    EFFECT_MOVES,
+    // moves run row by row in place
+    .scratch_per_region = 0,
+    .plan = plan_effect_3,
+    .apply = apply_effect_3,
+    .apply_planar = apply_effect_3_planar
+};
@@ -0,0 +1,308 @@
+#include "fanout.h"
+#include "pipeline/queue.h"
+#include "region/region.h"
+#include "region/scale.h"
+#include "stats/stats.h"
+
+#include <libswscale/swscale.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+// One decoded frame or stream-copied packet on its way to a target, all fields are references of their own
+typedef struct FanoutItem {
+    AVFrame *input_frame;
+    AVFrame *rgb_frame;
+    AVPacket *packet;
+    int64_t decoded_at;
+} FanoutItem;
+
+typedef struct FanoutTarget {
+    Config data;
+    Regions region_data;
+
+    // input and decoder are borrowed from the source, encoder, output and conversions belong to the target
+    VideoContext ctx;
+    FrameSlot slot;
+    // works on whole RGB frames, which the source converts once for all such targets. The path depends on the
+    // effect of the target, so native YUV, dirty region and whole frame targets can be mixed.
+    bool shared_rgb;
+
+    Queue items;
+    pthread_t thread;
+} FanoutTarget;
+
+static FanoutItem *alloc_item(void) {
+
+    FanoutItem *item = calloc(1, sizeof(FanoutItem));
+    if (item == NULL) {
+        fprintf(stderr, "[ERROR] Failed to allocate memory.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return item;
+}
+
+static void free_item(FanoutItem *item) {
+    av_frame_free(&item->input_frame);
+    av_frame_free(&item->rgb_frame);
+    av_packet_free(&item->packet);
+    free(item);
+}
+
+static bool has_planned_regions(const Config *data) {
+
+    bool regions = data->region_data->size > 0;
+    for (int i = 0; i < data->chain_length; i++)
+        regions |= data->chain_regions[i]->size > 0;
+
+    return regions;
+}
+
+// The native YUV frame and the whole RGB frame are references shared with the other targets and the decoder. The
+// regions are planned first, the frame is only copied if the effect changes it and encoded as it is otherwise.
+static void apply_shared_frame_effect(VideoContext *ctx, FrameSlot *slot) {
+
+    AVFrame *frame = ctx->native_yuv ? slot->input_frame : slot->rgb_frame;
+    Config *data = ctx->data;
+
+    const int64_t start = stats_start();
+    plan_frame(data, frame->width, frame->height);
+    const int64_t timestamp = slot->input_frame->best_effort_timestamp;
+    if (has_planned_regions(data) && is_effect_time(data, ctx->video_stream, timestamp)) {
+        AV_NOT_NEGATIVE(av_frame_make_writable(frame));
+        render_frame(frame, data, data->scale_filter);
+    }
+    slot->dirty.size = 0;
+    stats_stop(STATS_EFFECT, start);
+}
+
+static void process_target_frame(FanoutTarget *target, FanoutItem *item) {
+
+    VideoContext *ctx = &target->ctx;
+    FrameSlot *slot = &target->slot;
+
+    av_frame_unref(slot->input_frame);
+    av_frame_move_ref(slot->input_frame, item->input_frame);
+    slot->decoded_at = item->decoded_at;
+
+    if (target->shared_rgb) {
+        av_frame_unref(slot->rgb_frame);
+        av_frame_move_ref(slot->rgb_frame, item->rgb_frame);
+    }
+
+    // dirty region targets convert into frames of their own and never write to the decoded one
+    if (ctx->dirty_regions) {
+        convert_to_rgb(ctx, slot);
+        apply_frame_effect(ctx, slot);
+    } else {
+        apply_shared_frame_effect(ctx, slot);
+    }
+
+    convert_to_output(ctx, slot);
+    stats_stop(STATS_FRAME_LATENCY, slot->decoded_at);
+    encode_frame(ctx, slot->encodable, write_packet, NULL);
+}
+
+static void *target_thread(void *arg) {
+
+    FanoutTarget *target = arg;
+
+    FanoutItem *item;
+    while ((item = queue_pop(&target->items)) != NULL) {
+        if (item->packet != NULL)
+            write_packet(&target->ctx, item->packet, NULL);
+        else
+            process_target_frame(target, item);
+        free_item(item);
+    }
+
+    encode_frame(&target->ctx, NULL, write_packet, NULL);
+
+    return NULL;
+}
+
+static void open_target(FanoutTarget *target, const VideoContext *source, const Config *data,
+                        const EffectType effect_id, const float scale_factor, char *output_file) {
+
+    target->data = *data;
+    target->data.effect_id = effect_id;
+    target->data.scale_factor = scale_factor;
+    target->data.output_file = output_file;
+    target->data.target_count = 0;
+    target->data.buffer = NULL;
+    target->data.buffer_size = 0;
+    target->data.scale_cache = NULL;
+
+    // the targets run concurrently, the pool only serves one thread at a time
+    target->data.pool = NULL;
+
+    target->region_data = *data->region_data;
+    target->region_data.region_pair = NULL;
+    target->region_data.size = 0;
+    target->data.region_data = &target->region_data;
+
+    target->ctx = (VideoContext) {
+        .input_format_context = source->input_format_context,
+        .decoder_context = source->decoder_context,
+        .video_stream = source->video_stream,
+        .video_stream_index = source->video_stream_index,
+        .data = &target->data
+    };
+
+    open_encoder(&target->ctx);
+    open_output(&target->ctx, output_file);
+
+    alloc_frame_slot(&target->ctx, &target->slot);
+
+    // whole RGB frames come converted from the source, the slot only takes references to them
+    target->shared_rgb = !target->ctx.native_yuv && !target->ctx.dirty_regions;
+    if (target->shared_rgb)
+        av_freep(&target->slot.rgb_frame->data[0]);
+
+    // at least one frame in flight, the queue also holds the end marker
+    const int depth = data->pipeline_depth > 0 ? data->pipeline_depth : 1;
+    queue_init(&target->items, depth + 1);
+}
+
+static void close_target(FanoutTarget *target) {
+
+    // the source closes the shared input and decoder
+    target->ctx.input_format_context = NULL;
+    target->ctx.decoder_context = NULL;
+    close_video_context(&target->ctx);
+
+    // a shared rgb frame is a reference, free_frame_slot() only frees buffers the slot allocated itself
+    if (target->slot.rgb_frame->buf[0] != NULL)
+        av_frame_unref(target->slot.rgb_frame);
+    free_frame_slot(&target->slot);
+
+    queue_destroy(&target->items);
+    cleanup_regions(&target->region_data);
+    free(target->data.buffer);
+    free_scale_cache(target->data.scale_cache);
+}
+
+// Converts the decoded frame once for all targets on whole RGB frames, returns NULL if there is none. Their
+// conversions only differ in the effect, so the first such target's context is used.
+static AVFrame *convert_shared_rgb_frame(const FanoutTarget *targets, const int target_count,
+                                         const AVFrame *input_frame) {
+
+    const VideoContext *ctx = NULL;
+    for (int i = 0; i < target_count && ctx == NULL; i++) {
+        if (targets[i].shared_rgb)
+            ctx = &targets[i].ctx;
+    }
+    if (ctx == NULL)
+        return NULL;
+
+    AVFrame *rgb_frame = av_frame_alloc();
+    NOT_NULL(rgb_frame);
+    rgb_frame->format = ctx->working_format;
+    rgb_frame->width = ctx->encoder_context->width;
+    rgb_frame->height = ctx->encoder_context->height;
+    AV_NOT_NEGATIVE(av_frame_get_buffer(rgb_frame, WORKING_FORMAT_ALIGN));
+
+    const int64_t start = stats_start();
+    AV_NOT_NEGATIVE(sws_scale(ctx->input_format_to_rgb_sws_context,
+                              (const uint8_t * const *) input_frame->data,
+                              input_frame->linesize,
+                              0,
+                              input_frame->height,
+                              rgb_frame->data,
+                              rgb_frame->linesize));
+    stats_stop(STATS_SWS_TO_RGB, start);
+
+    rgb_frame->pts = input_frame->pts;
+
+    return rgb_frame;
+}
+
+static void distribute_decoded_frames(VideoContext *source, FrameSlot *slot, FanoutTarget *targets,
+                                      const int target_count) {
+
+    while (receive_frame(source, slot)) {
+        AVFrame *rgb_frame = convert_shared_rgb_frame(targets, target_count, slot->input_frame);
+
+        for (int i = 0; i < target_count; i++) {
+            FanoutItem *item = alloc_item();
+            item->input_frame = av_frame_clone(slot->input_frame);
+            NOT_NULL(item->input_frame);
+            if (targets[i].shared_rgb) {
+                item->rgb_frame = av_frame_clone(rgb_frame);
+                NOT_NULL(item->rgb_frame);
+            }
+            item->decoded_at = slot->decoded_at;
+            queue_push(&targets[i].items, item);
+        }
+
+        av_frame_free(&rgb_frame);
+        av_frame_unref(slot->input_frame);
+    }
+}
+
+static void distribute_packet(const AVPacket *packet, FanoutTarget *targets, const int target_count) {
+    for (int i = 0; i < target_count; i++) {
+        FanoutItem *item = alloc_item();
+        item->packet = av_packet_clone(packet);
+        NOT_NULL(item->packet);
+        queue_push(&targets[i].items, item);
+    }
+}
+
+void process_video_fanout(const char *input_file_path, Config *data) {
+
+    VideoContext source = { .data = data };
+    open_input(&source, input_file_path);
+
+    const int target_count = data->target_count + 1;
+    FanoutTarget *targets = calloc(target_count, sizeof(FanoutTarget));
+    if (targets == NULL) {
+        fprintf(stderr, "[ERROR] Failed to allocate memory.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    open_target(&targets[0], &source, data, data->effect_id, data->scale_factor, data->output_file);
+    for (int i = 1; i < target_count; i++) {
+        const OutputTarget *output = &data->targets[i - 1];
+        open_target(&targets[i], &source, data, output->effect_id, output->scale_factor, output->output_file);
+    }
+
+    for (int i = 0; i < target_count; i++) {
+        if (pthread_create(&targets[i].thread, NULL, target_thread, &targets[i]) != 0) {
+            fprintf(stderr, "[ERROR] Failed to start target thread.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // the source only decodes, its slot holds nothing but the decoded frame
+    FrameSlot slot = { .input_frame = av_frame_alloc() };
+    NOT_NULL(slot.input_frame);
+
+    AVPacket packet;
+    while (read_packet(&source, &packet) >= 0) {
+        if (packet.stream_index == source.video_stream_index) {
+            send_packet(&source, &packet);
+            distribute_decoded_frames(&source, &slot, targets, target_count);
+        } else {
+            distribute_packet(&packet, targets, target_count);
+        }
+        av_packet_unref(&packet);
+    }
+
+    send_packet(&source, NULL);
+    distribute_decoded_frames(&source, &slot, targets, target_count);
+
+    for (int i = 0; i < target_count; i++)
+        queue_push(&targets[i].items, NULL);
+
+    for (int i = 0; i < target_count; i++) {
+        pthread_join(targets[i].thread, NULL);
+        close_target(&targets[i]);
+    }
+
+    av_frame_free(&slot.input_frame);
+    free(targets);
+    close_video_context(&source);
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include "video-effects.h"
+
+// Writes the output of data and one more output per data->targets from a single demux and decode pass. Every
+// output has its own region state, encoder and muxer and runs on its own thread. The outputs share the decoded
+// frames, and the outputs that convert whole frames to RGB share that conversion as well. A target only copies a
+// frame when it applies its effect, so the extra memory per target is limited to its frames in flight
+// (data->pipeline_depth).
+void process_video_fanout(const char *input_file_path, Config *data);
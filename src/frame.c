@@ -0,0 +1,262 @@
+#include "video-effects.h"
+#include "cmdline.h"
+#include "effect.h"
+#include "region/timeline.h"
+#include "registry/registry.h"
+#include "stats/stats.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <libavutil/error.h>
+#include <libavutil/pixdesc.h>
+
+// Frame level processing and the failure handling it shares with the I/O code, built into libvideoeffects. What
+// happens to a failure is up to report_job_failure() of the executable or the library.
+
+static const unsigned int max_error_message_size = 64;
+
+#define JOB_ERROR_SIZE 256
+
+static _Thread_local jmp_buf *job_recovery;
+static _Thread_local char job_error[JOB_ERROR_SIZE];
+
+void set_job_recovery(jmp_buf *recovery) {
+    job_recovery = recovery;
+}
+
+const char *get_job_error(void) {
+    return job_error;
+}
+
+// Ends the current job if there is a recovery point, otherwise report_job_failure() ends the process
+__attribute__((noreturn)) static void fail(void) {
+
+    jmp_buf *recovery = job_recovery;
+    report_job_failure(job_error, recovery != NULL);
+
+    if (recovery == NULL)
+        abort();
+
+    job_recovery = NULL;
+    longjmp(*recovery, 1);
+}
+
+void fail_job(const char *format, ...) {
+
+    va_list arguments;
+    va_start(arguments, format);
+    vsnprintf(job_error, JOB_ERROR_SIZE, format, arguments);
+    va_end(arguments);
+
+    fail();
+}
+
+void check_av_error_positive(int err, const char *file_name, const char *function_name, int line) {
+    if (err < 0) {
+        char err_message[max_error_message_size];
+        snprintf(job_error, JOB_ERROR_SIZE,
+                 "AVError returned %d: %s in file %s %s line %d",
+                 err,
+                 av_make_error_string(err_message, max_error_message_size, err),
+                 file_name,
+                 function_name,
+                 line);
+        fail();
+	}
+}
+
+void check_not_null(const void* ptr, const char *file_name, const char *function_name, int line) {
+    if (ptr == NULL) {
+        snprintf(job_error, JOB_ERROR_SIZE,
+                 "Nullpointer in file %s in function %s line %d",
+                 file_name,
+                 function_name,
+                 line);
+        fail();
+    }
+}
+
+bool is_native_format(const enum AVPixelFormat pix_fmt) {
+    switch (pix_fmt) {
+        case AV_PIX_FMT_YUV420P:
+        case AV_PIX_FMT_YUVJ420P:
+        case AV_PIX_FMT_NV12:
+        case AV_PIX_FMT_YUV444P:
+        case AV_PIX_FMT_YUVJ444P:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool is_working_format(const enum AVPixelFormat pix_fmt) {
+    return pix_fmt == AV_PIX_FMT_RGB24 || pix_fmt == AV_PIX_FMT_RGB0;
+}
+
+void map_planar_image(const AVFrame *frame, PlanarImage *image) {
+
+    const bool full_range = frame->color_range == AVCOL_RANGE_JPEG || frame->format == AV_PIX_FMT_YUVJ420P ||
+                            frame->format == AV_PIX_FMT_YUVJ444P;
+
+    int shift_x = 0, shift_y = 0;
+    AV_NOT_NEGATIVE(av_pix_fmt_get_chroma_sub_sample(frame->format, &shift_x, &shift_y));
+
+    image->width = frame->width;
+    image->height = frame->height;
+    image->plane_count = frame->format == AV_PIX_FMT_NV12 ? 2 : 3;
+
+    for (int i = 0; i < image->plane_count; i++) {
+        ImagePlane *plane = &image->plane[i];
+        plane->data = frame->data[i];
+        plane->linesize = frame->linesize[i];
+        plane->pixel_step = frame->format == AV_PIX_FMT_NV12 && i == 1 ? 2 : 1;
+        plane->shift_x = i == 0 ? 0 : shift_x;
+        plane->shift_y = i == 0 ? 0 : shift_y;
+        plane->black = i == 0 ? (full_range ? 0 : 16) : 128;
+    }
+}
+
+static void render_planar_frame(AVFrame *frame, const EffectDescriptor *effect, Config *data) {
+
+    PlanarImage image;
+    map_planar_image(frame, &image);
+
+    reserve_effect_scratch(data, effect, 1);
+    effect->apply_planar(&image, data);
+}
+
+static void check_timeline_size(const Timeline *timeline, const int width, const int height) {
+    if (timeline->width != width || timeline->height != height) {
+        fail_job("The region timeline was made for %dx%d frames, the video has %dx%d",
+                timeline->width, timeline->height, width, height);
+    }
+}
+
+static void plan_stage(Config *data, const int width, const int height) {
+
+    data->region_data->draw = 0;
+    find_effect(data->effect_id)->plan(width, height, data);
+    data->region_data->frame++;
+}
+
+// The effects of a -f chain run on a copy of the config that points at their own filter and region stack
+static void select_chain_stage(Config *stage, const Config *data, const int index) {
+    stage->effect_id = data->chain[index];
+    stage->region_data = data->chain_regions[index];
+}
+
+void plan_frame(Config *data, int width, int height) {
+
+    const int64_t start = stats_start();
+
+    if (data->preview_scale > 1) {
+        width = data->source_width;
+        height = data->source_height;
+    }
+
+    Regions *region_data = data->region_data;
+
+    if (data->timeline != NULL) {
+        check_timeline_size(data->timeline, width, height);
+        load_timeline_frame(data->timeline, region_data->frame, region_data);
+        region_data->frame++;
+    } else {
+        plan_stage(data, width, height);
+
+        Config stage = *data;
+        for (int i = 0; i < data->chain_length; i++) {
+            select_chain_stage(&stage, data, i);
+            plan_stage(&stage, width, height);
+        }
+    }
+
+    Timeline *recorded_timeline = data->recorded_timeline;
+    if (recorded_timeline != NULL) {
+        if (recorded_timeline->frame_count == 0) {
+            recorded_timeline->width = width;
+            recorded_timeline->height = height;
+        }
+        check_timeline_size(recorded_timeline, width, height);
+        record_timeline_frame(recorded_timeline, region_data,
+                              find_effect(data->effect_id)->capabilities & EFFECT_MOVES);
+    }
+
+    stats_stop(STATS_PLAN, start);
+}
+
+static void render_packed_frame(AVFrame *frame, const EffectDescriptor *effect, Config *data) {
+
+    const int pixel_step = frame->format == AV_PIX_FMT_RGB0 ? 4 : 3;
+
+    reserve_effect_scratch(data, effect, pixel_step);
+    effect->apply(frame->data[0], frame->linesize[0], pixel_step, frame->width, frame->height, data);
+}
+
+static void render_stage(AVFrame *frame, Config *data) {
+
+    const int64_t start = stats_start();
+
+    const EffectDescriptor *effect = find_effect(data->effect_id);
+
+    // effects that are not safe to split work on whole regions on this thread
+    WorkerPool *pool = data->pool;
+    if (!(effect->capabilities & EFFECT_BAND_SAFE))
+        data->pool = NULL;
+
+    if (is_working_format(frame->format))
+        render_packed_frame(frame, effect, data);
+    else
+        render_planar_frame(frame, effect, data);
+
+    data->pool = pool;
+
+    stats_stop(get_effect_timer(data->effect_id), start);
+}
+
+// A preview renders the planned regions mapped onto its smaller frame
+static void select_preview_regions(Config *stage, const AVFrame *frame, Regions *view) {
+    if (stage->preview_scale > 1) {
+        scale_regions(stage->region_data, stage->source_width, stage->source_height, frame->width, frame->height,
+                      view);
+        stage->region_data = view;
+    }
+}
+
+void render_frame(AVFrame *frame, Config *data, const ScaleFilter scale_filter) {
+
+    Config stage = *data;
+    Regions view;
+
+    stage.scale_filter = scale_filter;
+    stage.scratch_owner = data;
+
+    select_preview_regions(&stage, frame, &view);
+    render_stage(frame, &stage);
+
+    // every stage sees the output of the ones before, overlapping regions are changed in chain order. The scratch
+    // buffer and the scale cache are shared, any stage (re)allocates them in data.
+    for (int i = 0; i < data->chain_length; i++) {
+        select_chain_stage(&stage, data, i);
+        select_preview_regions(&stage, frame, &view);
+        render_stage(frame, &stage);
+    }
+}
+
+void process_frame(AVFrame *rgb_frame, void *user_data) {
+
+    Config *data = user_data;
+
+    plan_frame(data, rgb_frame->width, rgb_frame->height);
+    render_frame(rgb_frame, data, data->scale_filter);
+}
+
+void set_rgb_value(uint8_t *pixel, const int offset, const uint8_t r, const bool update_r, const uint8_t g,
+                   const bool update_g, const uint8_t b, const bool update_b) {
+    if (update_r)
+        *(pixel + offset) = r;
+    if (update_g)
+        *(pixel + offset + 1) = g;
+    if (update_b)
+        *(pixel + offset + 2) = b;
+}
\ No newline at end of file
@@ -0,0 +1,312 @@
+#include "index.h"
+#include "video-effects.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <libavformat/avformat.h>
+
+#define INDEX_MAGIC "VFXINDEX"
+#define INDEX_VERSION 1
+
+_Static_assert(sizeof(IndexHeader) % 8 == 0, "the keyframes have to start 8 byte aligned");
+_Static_assert(sizeof(IndexKeyframe) == 32, "the index layout must not depend on the compiler");
+
+typedef struct IndexBuilder {
+    IndexKeyframe *keyframe;
+    int keyframe_count;
+    int keyframe_capacity;
+
+    int64_t *frame_pts;
+    int frame_count;
+    int frame_capacity;
+} IndexBuilder;
+
+static void *grow(void *array, int *capacity, const size_t element_size) {
+
+    *capacity = *capacity > 0 ? *capacity * 2 : 1024;
+    void *buffer = realloc(array, element_size * *capacity);
+    if (buffer == NULL) {
+        fprintf(stderr, "[ERROR] Failed to allocate memory.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return buffer;
+}
+
+static void add_packet(IndexBuilder *builder, const AVPacket *packet) {
+
+    if (packet->flags & AV_PKT_FLAG_KEY) {
+        if (builder->keyframe_count == builder->keyframe_capacity)
+            builder->keyframe = grow(builder->keyframe, &builder->keyframe_capacity, sizeof(IndexKeyframe));
+
+        builder->keyframe[builder->keyframe_count++] = (IndexKeyframe) {
+            .pts = packet->pts,
+            .dts = packet->dts,
+            .position = packet->pos,
+            .frame_index = builder->frame_count,
+            .reserved = 0
+        };
+    }
+
+    if (builder->frame_count == builder->frame_capacity)
+        builder->frame_pts = grow(builder->frame_pts, &builder->frame_capacity, sizeof(int64_t));
+
+    builder->frame_pts[builder->frame_count++] = packet->pts;
+}
+
+void get_index_path(const Config *data, char *path, const size_t size) {
+    if (data->index_file != NULL)
+        snprintf(path, size, "%s", data->index_file);
+    else
+        snprintf(path, size, "%s%s", data->input_file, INDEX_EXTENSION);
+}
+
+static void fill_header(IndexHeader *header, const VideoContext *ctx, const struct stat *status,
+                        const IndexBuilder *builder) {
+
+    const AVStream *stream = ctx->video_stream;
+    const AVCodecParameters *parameters = stream->codecpar;
+
+    *header = (IndexHeader) {
+        .version = INDEX_VERSION,
+        .header_size = sizeof(IndexHeader),
+        .file_size = status->st_size,
+        .file_mtime = status->st_mtime,
+        .stream_count = (int32_t) ctx->input_format_context->nb_streams,
+        .video_stream_index = ctx->video_stream_index,
+        .codec_id = parameters->codec_id,
+        .format = parameters->format,
+        .width = parameters->width,
+        .height = parameters->height,
+        .profile = parameters->profile,
+        .level = parameters->level,
+        .bit_rate = parameters->bit_rate,
+        .sample_aspect_ratio_num = parameters->sample_aspect_ratio.num,
+        .sample_aspect_ratio_den = parameters->sample_aspect_ratio.den,
+        .time_base_num = stream->time_base.num,
+        .time_base_den = stream->time_base.den,
+        .frame_rate_num = stream->avg_frame_rate.num,
+        .frame_rate_den = stream->avg_frame_rate.den,
+        .color_range = parameters->color_range,
+        .color_primaries = parameters->color_primaries,
+        .color_trc = parameters->color_trc,
+        .color_space = parameters->color_space,
+        .chroma_location = parameters->chroma_location,
+        .field_order = parameters->field_order,
+        .start_time = stream->start_time,
+        .duration = stream->duration,
+        .keyframe_count = builder->keyframe_count,
+        .frame_count = builder->frame_count,
+        .extradata_size = parameters->extradata_size,
+        .reserved = 0
+    };
+    memcpy(header->magic, INDEX_MAGIC, sizeof(header->magic));
+
+    header->keyframe_offset = sizeof(IndexHeader);
+    header->frame_offset = header->keyframe_offset + (int64_t) sizeof(IndexKeyframe) * builder->keyframe_count;
+    header->extradata_offset = header->frame_offset + (int64_t) sizeof(int64_t) * builder->frame_count;
+}
+
+void build_index(const char *input_file_path, Config *data, const char *index_path) {
+
+    struct stat status;
+    if (stat(input_file_path, &status) != 0 || !S_ISREG(status.st_mode)) {
+        fprintf(stderr, "[ERROR] Only regular files can be indexed: '%s'\n", input_file_path);
+        exit(EXIT_FAILURE);
+    }
+
+    // probes the streams the usual way, an outdated index is not used for that
+    Config probe = *data;
+    probe.index = NULL;
+
+    VideoContext ctx = { .data = &probe };
+    open_input(&ctx, input_file_path);
+
+    AVPacket *packet = av_packet_alloc();
+    NOT_NULL(packet);
+
+    IndexBuilder builder = { 0 };
+    while (av_read_frame(ctx.input_format_context, packet) >= 0) {
+        if (packet->stream_index == ctx.video_stream_index)
+            add_packet(&builder, packet);
+        av_packet_unref(packet);
+    }
+    av_packet_free(&packet);
+
+    IndexHeader header;
+    fill_header(&header, &ctx, &status, &builder);
+
+    // a run reading the index at the same time never sees a partial file
+    const size_t temp_path_size = strlen(index_path) + 8;
+    char *temp_path = malloc(temp_path_size);
+    NOT_NULL(temp_path);
+    snprintf(temp_path, temp_path_size, "%s.tmp", index_path);
+
+    FILE *file = fopen(temp_path, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "[ERROR] Could not open '%s' for writing\n", temp_path);
+        exit(EXIT_FAILURE);
+    }
+
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(builder.keyframe, sizeof(IndexKeyframe), builder.keyframe_count, file);
+    fwrite(builder.frame_pts, sizeof(int64_t), builder.frame_count, file);
+    fwrite(ctx.video_stream->codecpar->extradata, 1, header.extradata_size, file);
+
+    if (ferror(file) || fclose(file) != 0 || rename(temp_path, index_path) != 0) {
+        fprintf(stderr, "[ERROR] Could not write the index '%s'\n", index_path);
+        remove(temp_path);
+        exit(EXIT_FAILURE);
+    }
+
+    close_video_context(&ctx);
+    free(temp_path);
+    free(builder.keyframe);
+    free(builder.frame_pts);
+}
+
+static bool valid_array(const IndexHeader *header, const size_t file_size, const int64_t offset, const int64_t count,
+                        const size_t element_size) {
+    return count >= 0 && offset >= (int64_t) header->header_size && offset % 8 == 0 &&
+           (uint64_t) offset + (uint64_t) count * element_size <= file_size;
+}
+
+static bool valid_header(const IndexHeader *header, const size_t file_size, const struct stat *input_status) {
+    return memcmp(header->magic, INDEX_MAGIC, sizeof(header->magic)) == 0 && header->version == INDEX_VERSION &&
+           header->header_size == sizeof(IndexHeader) && header->file_size == input_status->st_size &&
+           header->file_mtime == input_status->st_mtime && header->time_base_num > 0 && header->time_base_den > 0 &&
+           valid_array(header, file_size, header->keyframe_offset, header->keyframe_count, sizeof(IndexKeyframe)) &&
+           valid_array(header, file_size, header->frame_offset, header->frame_count, sizeof(int64_t)) &&
+           header->extradata_offset >= (int64_t) header->header_size && header->extradata_size >= 0 &&
+           (uint64_t) header->extradata_offset + (uint64_t) header->extradata_size <= file_size;
+}
+
+bool load_index(const char *input_file_path, const char *index_path, VideoIndex *index) {
+
+    // the layout is the one of a little endian host
+#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+    return false;
+#endif
+
+    struct stat input_status;
+    if (stat(input_file_path, &input_status) != 0)
+        return false;
+
+    const int fd = open(index_path, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat status;
+    if (fstat(fd, &status) != 0 || (size_t) status.st_size < sizeof(IndexHeader)) {
+        close(fd);
+        return false;
+    }
+
+    void *mapping = mmap(NULL, (size_t) status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+        return false;
+
+    const IndexHeader *header = mapping;
+    if (!valid_header(header, (size_t) status.st_size, &input_status)) {
+        munmap(mapping, (size_t) status.st_size);
+        return false;
+    }
+
+    const uint8_t *base = mapping;
+    *index = (VideoIndex) {
+        .header = header,
+        .keyframe = (const IndexKeyframe *) (base + header->keyframe_offset),
+        .frame_pts = (const int64_t *) (base + header->frame_offset),
+        .extradata = base + header->extradata_offset,
+        .mapping = mapping,
+        .mapping_size = (size_t) status.st_size
+    };
+
+    return true;
+}
+
+void close_index(VideoIndex *index) {
+
+    if (index->mapping != NULL)
+        munmap(index->mapping, index->mapping_size);
+
+    *index = (VideoIndex) { 0 };
+}
+
+// The demuxer fills in what the container header declares. Streams that only get their parameters from probing,
+// e.g. audio in MPEG-TS, would be stream copied without sample rate or channel layout.
+static bool has_complete_parameters(const AVCodecParameters *parameters) {
+
+    switch (parameters->codec_type) {
+        case AVMEDIA_TYPE_VIDEO:
+            return parameters->codec_id != AV_CODEC_ID_NONE && parameters->width > 0 && parameters->height > 0;
+        case AVMEDIA_TYPE_AUDIO:
+            return parameters->codec_id != AV_CODEC_ID_NONE && parameters->format >= 0 &&
+                   parameters->sample_rate > 0 && parameters->ch_layout.nb_channels > 0;
+        case AVMEDIA_TYPE_SUBTITLE:
+            return parameters->codec_id != AV_CODEC_ID_NONE;
+        default:
+            // data and attachment streams have nothing the probing could add
+            return true;
+    }
+}
+
+bool apply_index(const VideoIndex *index, AVFormatContext *format_context) {
+
+    const IndexHeader *header = index->header;
+
+    if (format_context->nb_streams != (unsigned int) header->stream_count || header->video_stream_index < 0 ||
+        header->video_stream_index >= header->stream_count)
+        return false;
+
+    AVStream *stream = format_context->streams[header->video_stream_index];
+    AVCodecParameters *parameters = stream->codecpar;
+
+    if (parameters->codec_type != AVMEDIA_TYPE_VIDEO || parameters->codec_id != header->codec_id ||
+        stream->time_base.num != header->time_base_num || stream->time_base.den != header->time_base_den)
+        return false;
+
+    // the index only stores the video stream, the others are copied with what the demuxer found
+    for (unsigned int i = 0; i < format_context->nb_streams; i++) {
+        if (i != (unsigned int) header->video_stream_index &&
+            !has_complete_parameters(format_context->streams[i]->codecpar))
+            return false;
+    }
+
+    if (parameters->extradata == NULL && header->extradata_size > 0) {
+        parameters->extradata = av_mallocz(header->extradata_size + AV_INPUT_BUFFER_PADDING_SIZE);
+        NOT_NULL(parameters->extradata);
+        memcpy(parameters->extradata, index->extradata, header->extradata_size);
+        parameters->extradata_size = header->extradata_size;
+    }
+
+    parameters->format = header->format;
+    parameters->width = header->width;
+    parameters->height = header->height;
+    parameters->profile = header->profile;
+    parameters->level = header->level;
+    parameters->bit_rate = header->bit_rate;
+    parameters->sample_aspect_ratio = (AVRational) { header->sample_aspect_ratio_num, header->sample_aspect_ratio_den };
+    parameters->color_range = header->color_range;
+    parameters->color_primaries = header->color_primaries;
+    parameters->color_trc = header->color_trc;
+    parameters->color_space = header->color_space;
+    parameters->chroma_location = header->chroma_location;
+    parameters->field_order = header->field_order;
+
+    stream->avg_frame_rate = (AVRational) { header->frame_rate_num, header->frame_rate_den };
+    if (stream->r_frame_rate.num == 0)
+        stream->r_frame_rate = stream->avg_frame_rate;
+    if (stream->start_time == AV_NOPTS_VALUE)
+        stream->start_time = header->start_time;
+    if (stream->duration == AV_NOPTS_VALUE)
+        stream->duration = header->duration;
+
+    return true;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct Config Config;
+struct AVFormatContext;
+
+#define INDEX_EXTENSION ".vfxindex"
+
+// Sidecar index of an input file. The file is read by mapping it, the structs below are its layout: a header,
+// the keyframes, the pts of every video packet in decode order and the extradata of the video stream, all values
+// little endian and every array 8 byte aligned. An index only belongs to the file size and modification time it
+// was built for.
+typedef struct IndexHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+
+    int64_t file_size;
+    int64_t file_mtime;
+
+    int32_t stream_count;
+    int32_t video_stream_index;
+
+    // parameters of the video stream as found by avformat_find_stream_info()
+    int32_t codec_id;
+    int32_t format;
+    int32_t width;
+    int32_t height;
+    int32_t profile;
+    int32_t level;
+    int64_t bit_rate;
+    int32_t sample_aspect_ratio_num;
+    int32_t sample_aspect_ratio_den;
+    int32_t time_base_num;
+    int32_t time_base_den;
+    int32_t frame_rate_num;
+    int32_t frame_rate_den;
+    int32_t color_range;
+    int32_t color_primaries;
+    int32_t color_trc;
+    int32_t color_space;
+    int32_t chroma_location;
+    int32_t field_order;
+    int64_t start_time;
+    int64_t duration;
+
+    int32_t keyframe_count;
+    int32_t frame_count;
+    int32_t extradata_size;
+    int32_t reserved;
+
+    // from the start of the file
+    int64_t keyframe_offset;
+    int64_t frame_offset;
+    int64_t extradata_offset;
+} IndexHeader;
+
+typedef struct IndexKeyframe {
+    int64_t pts;
+    int64_t dts;
+    // byte position of the packet in the input, -1 if the demuxer does not know it
+    int64_t position;
+    // number of video packets before this one
+    int32_t frame_index;
+    int32_t reserved;
+} IndexKeyframe;
+
+typedef struct VideoIndex {
+    const IndexHeader *header;
+    const IndexKeyframe *keyframe;
+    const int64_t *frame_pts;
+    const uint8_t *extradata;
+
+    void *mapping;
+    size_t mapping_size;
+} VideoIndex;
+
+// "<input>.vfxindex" unless --index-file is given
+void get_index_path(const Config *data, char *path, size_t size);
+
+// Opens the input, probes it and scans all video packets once, the index is written to a temporary file first
+void build_index(const char *input_file_path, Config *data, const char *index_path);
+
+// Returns false if there is no index or it does not belong to the current input file
+bool load_index(const char *input_file_path, const char *index_path, VideoIndex *index);
+void close_index(VideoIndex *index);
+
+// Replaces avformat_find_stream_info(): returns false if the streams of the opened input do not match the index
+bool apply_index(const VideoIndex *index, struct AVFormatContext *format_context);
@@ -0,0 +1,138 @@
+#include "mmap_input.h"
+#include "video-effects.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <libavutil/common.h>
+#include <libavutil/mem.h>
+
+typedef struct MappedFile {
+    uint8_t *data;
+    int64_t size;
+    int64_t position;
+    // end of the range last passed to madvise(MADV_WILLNEED)
+    int64_t advised;
+    int64_t page_size;
+} MappedFile;
+
+// Keeps the readahead one window ahead of the demuxer, the kernel reads the pages before they are touched
+static void advise_readahead(MappedFile *file) {
+
+    if (file->position + MAPPED_READAHEAD / 2 < file->advised)
+        return;
+
+    const int64_t start = file->position & ~(file->page_size - 1);
+    const int64_t end = FFMIN(start + MAPPED_READAHEAD, file->size);
+
+    if (end > start)
+        madvise(file->data + start, (size_t) (end - start), MADV_WILLNEED);
+    file->advised = end;
+}
+
+static int read_mapped(void *opaque, uint8_t *buffer, const int size) {
+
+    MappedFile *file = opaque;
+
+    const int64_t remaining = file->size - file->position;
+    if (remaining <= 0)
+        return AVERROR_EOF;
+
+    const int bytes = (int) FFMIN(remaining, size);
+    advise_readahead(file);
+    memcpy(buffer, file->data + file->position, bytes);
+    file->position += bytes;
+
+    return bytes;
+}
+
+static int64_t seek_mapped(void *opaque, const int64_t offset, int whence) {
+
+    MappedFile *file = opaque;
+
+    whence &= ~AVSEEK_FORCE;
+    if (whence == AVSEEK_SIZE)
+        return file->size;
+
+    int64_t position;
+    switch (whence) {
+        case SEEK_SET:
+            position = offset;
+            break;
+        case SEEK_CUR:
+            position = file->position + offset;
+            break;
+        case SEEK_END:
+            position = file->size + offset;
+            break;
+        default:
+            return AVERROR(EINVAL);
+    }
+
+    if (position < 0 || position > file->size)
+        return AVERROR(EINVAL);
+
+    file->position = position;
+    file->advised = 0;
+    return position;
+}
+
+AVIOContext *open_mapped_input(const char *file_path) {
+
+    const int fd = open(file_path, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+
+    struct stat status;
+    if (fstat(fd, &status) != 0 || !S_ISREG(status.st_mode) || status.st_size == 0 ||
+        (uint64_t) status.st_size > SIZE_MAX) {
+        close(fd);
+        return NULL;
+    }
+
+    // the mapping keeps its own reference to the file
+    uint8_t *data = mmap(NULL, (size_t) status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return NULL;
+
+    madvise(data, (size_t) status.st_size, MADV_SEQUENTIAL);
+
+    MappedFile *file = av_mallocz(sizeof(MappedFile));
+    NOT_NULL(file);
+    *file = (MappedFile) {
+        .data = data,
+        .size = status.st_size,
+        .position = 0,
+        .advised = 0,
+        .page_size = sysconf(_SC_PAGESIZE)
+    };
+
+    uint8_t *buffer = av_malloc(MAPPED_IO_BUFFER_SIZE);
+    NOT_NULL(buffer);
+
+    AVIOContext *io = avio_alloc_context(buffer, MAPPED_IO_BUFFER_SIZE, 0, file, read_mapped, NULL, seek_mapped);
+    NOT_NULL(io);
+
+    // avio_read() copies packet payloads straight from the mapping into the packet, seeks only move the position
+    io->direct = 1;
+    return io;
+}
+
+void close_mapped_input(AVIOContext **io) {
+
+    if (*io == NULL)
+        return;
+
+    MappedFile *file = (*io)->opaque;
+    munmap(file->data, (size_t) file->size);
+    av_free(file);
+
+    av_freep(&(*io)->buffer);
+    avio_context_free(io);
+}
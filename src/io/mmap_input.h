@@ -0,0 +1,15 @@
+#pragma once
+
+#include <libavformat/avio.h>
+
+// Buffer for the small reads of the demuxers (headers, box sizes), larger reads are copied straight from the mapping
+#define MAPPED_IO_BUFFER_SIZE (64 << 10)
+
+// Pages requested ahead of the read position
+#define MAPPED_READAHEAD (8 << 20)
+
+// Maps a local file and wraps it in a read-only, seekable AVIOContext. Reads are served from the mapped pages without
+// read() calls. Returns NULL if the file can not be mapped (pipes, devices, empty files), the caller then opens it
+// the usual way. The file must not be truncated while it is mapped.
+AVIOContext *open_mapped_input(const char *file_path);
+void close_mapped_input(AVIOContext **io);
@@ -0,0 +1,128 @@
+#include "output_file.h"
+#include "video-effects.h"
+#include "stats/stats.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <libavutil/avstring.h>
+#include <libavutil/error.h>
+#include <libavutil/mem.h>
+
+typedef struct OutputFile {
+    int fd;
+    int64_t sync_bytes;
+    // written since the last fdatasync()
+    int64_t unsynced;
+} OutputFile;
+
+static int sync_output(OutputFile *file) {
+
+    const int64_t start = stats_start();
+    const int ret = fdatasync(file->fd);
+    stats_stop(STATS_OUTPUT_SYNC, start);
+
+    file->unsynced = 0;
+    return ret != 0 ? AVERROR(errno) : 0;
+}
+
+// the write callback lost its non-const buffer with libavformat 61
+#if LIBAVFORMAT_VERSION_MAJOR < 61
+static int write_output(void *opaque, uint8_t *buffer, const int size) {
+#else
+static int write_output(void *opaque, const uint8_t *buffer, const int size) {
+#endif
+
+    OutputFile *file = opaque;
+
+    const int64_t start = stats_start();
+    int written = 0;
+    while (written < size) {
+        const ssize_t bytes = write(file->fd, buffer + written, size - written);
+        if (bytes < 0 && errno == EINTR)
+            continue;
+        if (bytes < 0)
+            return AVERROR(errno);
+        written += (int) bytes;
+    }
+    stats_stop(STATS_OUTPUT_WRITE, start);
+
+    file->unsynced += written;
+    if (file->sync_bytes > 0 && file->unsynced >= file->sync_bytes) {
+        const int ret = sync_output(file);
+        if (ret < 0)
+            return ret;
+    }
+
+    return written;
+}
+
+// MP4 and MOV seek back to write the sizes of their boxes
+static int64_t seek_output(void *opaque, const int64_t offset, const int whence) {
+
+    const OutputFile *file = opaque;
+
+    if ((whence & ~AVSEEK_FORCE) == AVSEEK_SIZE) {
+        struct stat status;
+        return fstat(file->fd, &status) == 0 ? status.st_size : AVERROR(errno);
+    }
+
+    const off_t position = lseek(file->fd, offset, whence & ~AVSEEK_FORCE);
+    return position < 0 ? AVERROR(errno) : position;
+}
+
+bool is_local_output(const char *file_path) {
+    const char *protocol = avio_find_protocol_name(file_path);
+    return protocol != NULL ? strcmp(protocol, "file") == 0 : strchr(file_path, ':') == NULL;
+}
+
+AVIOContext *open_output_file(const char *file_path, const int buffer_size, const int64_t sync_bytes) {
+
+    // a file: URL names the same file as the plain path
+    av_strstart(file_path, "file:", &file_path);
+
+    const int fd = open(file_path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0)
+        fail_job("Could not open '%s' for writing", file_path);
+
+    OutputFile *file = av_mallocz(sizeof(OutputFile));
+    NOT_NULL(file);
+    *file = (OutputFile) {
+        .fd = fd,
+        .sync_bytes = sync_bytes,
+        .unsynced = 0
+    };
+
+    uint8_t *buffer = av_malloc(buffer_size);
+    NOT_NULL(buffer);
+
+    AVIOContext *io = avio_alloc_context(buffer, buffer_size, 1, file, NULL, write_output, seek_output);
+    NOT_NULL(io);
+
+    return io;
+}
+
+int close_output_file(AVIOContext **io) {
+
+    if (*io == NULL)
+        return 0;
+
+    OutputFile *file = (*io)->opaque;
+
+    avio_flush(*io);
+    int ret = (*io)->error;
+
+    if (ret >= 0 && file->sync_bytes > 0 && file->unsynced > 0)
+        ret = sync_output(file);
+    if (close(file->fd) != 0 && ret >= 0)
+        ret = AVERROR(errno);
+    av_free(file);
+
+    av_freep(&(*io)->buffer);
+    avio_context_free(io);
+
+    return ret;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <stdbool.h>
+#include <libavformat/avio.h>
+
+// Whether the output path names a local file, either as a plain path or as a file: URL. Other protocols such as
+// udp:// or rtmp:// are opened with avio_open2() instead of open_output_file().
+bool is_local_output(const char *file_path);
+
+// Opens a local output file, a plain path or a file: URL, and wraps it in a seekable AVIOContext that collects buffer_size bytes before every
+// write(). With sync_bytes > 0 the written data is flushed to the storage with fdatasync() every sync_bytes bytes
+// and when the file is closed, so the page cache never holds more than that of the output.
+AVIOContext *open_output_file(const char *file_path, int buffer_size, int64_t sync_bytes);
+
+// Flushes the buffer and closes the file, a negative AVERROR if any of the writes failed
+int close_output_file(AVIOContext **io);
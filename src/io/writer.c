@@ -0,0 +1,79 @@
+#include "writer.h"
+#include "video-effects.h"
+#include "stats/stats.h"
+
+#include <stdlib.h>
+#include <libavutil/common.h>
+
+static void *writer_thread(void *arg) {
+
+    OutputWriter *writer = arg;
+
+    AVPacket *packet;
+    while ((packet = queue_pop(&writer->packets)) != NULL) {
+        if (__atomic_load_n(&writer->error, __ATOMIC_ACQUIRE) == 0) {
+            const int64_t start = stats_start();
+            const int ret = av_interleaved_write_frame(writer->format_context, packet);
+            stats_stop(STATS_MUX, start);
+            if (ret < 0)
+                __atomic_store_n(&writer->error, ret, __ATOMIC_RELEASE);
+        }
+        av_packet_free(&packet);
+    }
+
+    return NULL;
+}
+
+OutputWriter *start_output_writer(AVFormatContext *format_context, const int queue_size) {
+
+    OutputWriter *writer = malloc(sizeof(OutputWriter));
+    if (writer == NULL)
+        fail_job("Failed to allocate memory.");
+
+    writer->format_context = format_context;
+    writer->error = 0;
+
+    // room for the end-of-stream marker
+    queue_init(&writer->packets, queue_size + 1);
+
+    if (pthread_create(&writer->thread, NULL, writer_thread, writer) != 0) {
+        queue_destroy(&writer->packets);
+        free(writer);
+        fail_job("Failed to start the output writer thread");
+    }
+
+    return writer;
+}
+
+void queue_output_packet(OutputWriter *writer, AVPacket *packet) {
+
+    AV_NOT_NEGATIVE(__atomic_load_n(&writer->error, __ATOMIC_ACQUIRE));
+
+    AVPacket *queued = av_packet_alloc();
+    NOT_NULL(queued);
+    av_packet_move_ref(queued, packet);
+
+    const int64_t start = stats_start();
+    if (queue_push(&writer->packets, queued))
+        stats_stop(STATS_WRITER_QUEUE_FULL, start);
+}
+
+int stop_output_writer(OutputWriter **writer) {
+
+    if (*writer == NULL)
+        return 0;
+
+    queue_push(&(*writer)->packets, NULL);
+    pthread_join((*writer)->thread, NULL);
+
+    // without the end-of-stream marker
+    const int capacity = (*writer)->packets.capacity - 1;
+    stats_queue_high_water(STATS_QUEUE_WRITER, FFMIN((*writer)->packets.high_water, capacity), capacity);
+    queue_destroy(&(*writer)->packets);
+
+    const int error = (*writer)->error;
+    free(*writer);
+    *writer = NULL;
+
+    return error;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "pipeline/queue.h"
+
+#include <pthread.h>
+#include <libavformat/avformat.h>
+
+// Packets the encoding thread may be ahead of the output, see --writer-queue
+#define DEFAULT_WRITER_QUEUE 256
+#define MAX_WRITER_QUEUE 65536
+
+// Thread that muxes and writes the packets of one output, so a slow disk only stalls the encoder once its queue is
+// full. The header and the trailer are written by the caller while no writer runs.
+typedef struct OutputWriter {
+    AVFormatContext *format_context;
+    Queue packets;
+    pthread_t thread;
+    // first error of the muxer, the packets after it are dropped
+    int error;
+} OutputWriter;
+
+OutputWriter *start_output_writer(AVFormatContext *format_context, int queue_size);
+
+// Takes over the packet reference, fails the job if the writer has failed
+void queue_output_packet(OutputWriter *writer, AVPacket *packet);
+
+// Writes the queued packets and ends the thread, returns the error of the muxer or 0
+int stop_output_writer(OutputWriter **writer);
@@ -0,0 +1,256 @@
+#include "videoeffects.h"
+#include "video-effects.h"
+#include "cmdline.h"
+#include "pool/pool.h"
+#include "region/region.h"
+#include "region/scale.h"
+#include "registry/registry.h"
+
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <libavutil/error.h>
+
+_Static_assert(VIDEO_EFFECTS_MAX_FILTERS == MAX_EFFECT_CHAIN, "the filters of an instance are one -f chain");
+
+struct VideoEffects {
+
+    // only the fields of the frame processing are used, there is no input or output
+    Config data;
+
+    Regions regions[VIDEO_EFFECTS_MAX_FILTERS];
+
+    WorkerPool pool;
+    bool pool_started;
+
+    // wraps the planes of video_effects_process_planes()
+    AVFrame *planes;
+
+    // frame size the scratch memory was reserved for
+    int width;
+    int height;
+
+    char error[VIDEO_EFFECTS_ERROR_SIZE];
+};
+
+void video_effects_default_options(VideoEffectsOptions *options) {
+    *options = (VideoEffectsOptions) {
+        .filters = { EFFECT_ONE },
+        .filter_count = 1,
+        .scale_factor = 0.0f,
+        .scale_filter = NULL,
+        .seed = 0,
+        .threads = 1
+    };
+}
+
+// Failures of the library are returned by the API functions, which all set a recovery point
+void report_job_failure(const char *message, const bool recoverable) {
+    (void) message;
+    if (!recoverable)
+        abort();
+}
+
+static bool check_options(const VideoEffectsOptions *options, char *error) {
+
+    if (options->filter_count < 1 || options->filter_count > VIDEO_EFFECTS_MAX_FILTERS) {
+        snprintf(error, VIDEO_EFFECTS_ERROR_SIZE, "Between 1 and %d filters are supported",
+                 VIDEO_EFFECTS_MAX_FILTERS);
+        return false;
+    }
+
+    for (int i = 0; i < options->filter_count; i++) {
+        const EffectDescriptor *effect = find_effect(options->filters[i]);
+        if (effect == NULL) {
+            snprintf(error, VIDEO_EFFECTS_ERROR_SIZE, "Unknown filter %d", options->filters[i]);
+            return false;
+        }
+        if ((effect->capabilities & EFFECT_SCALED) && (options->scale_factor <= 0 || options->scale_factor > 3)) {
+            snprintf(error, VIDEO_EFFECTS_ERROR_SIZE,
+                     "The filter '%s' needs a scale factor greater than 0 and at most 3", effect->name);
+            return false;
+        }
+    }
+
+    ScaleFilter scale_filter;
+    if (options->scale_filter != NULL && !parse_scale_filter(options->scale_filter, &scale_filter)) {
+        snprintf(error, VIDEO_EFFECTS_ERROR_SIZE, "Unknown scale filter '%s'", options->scale_filter);
+        return false;
+    }
+
+    if (options->threads < 1) {
+        snprintf(error, VIDEO_EFFECTS_ERROR_SIZE, "At least one thread is needed");
+        return false;
+    }
+
+    return true;
+}
+
+static void init_instance(VideoEffects *effects, const VideoEffectsOptions *options) {
+
+    Config *data = &effects->data;
+
+    data->effect_id = options->filters[0];
+    data->chain_length = options->filter_count - 1;
+    data->scale_factor = options->scale_factor;
+    data->seed = options->seed;
+    data->seed_set = true;
+    data->bands = options->threads;
+
+    if (options->scale_filter != NULL)
+        parse_scale_filter(options->scale_filter, &data->scale_filter);
+
+    // seeded like the region stacks of main()
+    for (int i = 0; i < options->filter_count; i++) {
+        effects->regions[i] = (Regions) {
+            .region_pair = NULL,
+            .size = 0,
+            .seed = options->seed + (unsigned int) i * CHAIN_SEED_STEP,
+            .frame = 0,
+            .draw = 0
+        };
+        reserve_regions(&effects->regions[i], MIN_REGION_CAPACITY);
+    }
+
+    data->region_data = &effects->regions[0];
+    for (int i = 0; i < data->chain_length; i++) {
+        data->chain[i] = options->filters[i + 1];
+        data->chain_regions[i] = &effects->regions[i + 1];
+    }
+
+    effects->planes = av_frame_alloc();
+    NOT_NULL(effects->planes);
+
+    if (options->threads > 1) {
+        pool_init(&effects->pool, options->threads - 1, options->threads);
+        effects->pool_started = true;
+        data->pool = &effects->pool;
+    }
+}
+
+VideoEffects *video_effects_create(const VideoEffectsOptions *options, char *error) {
+
+    // the messages are written to a scratch buffer if the caller has none
+    char unused[VIDEO_EFFECTS_ERROR_SIZE];
+    if (error == NULL)
+        error = unused;
+    error[0] = '\0';
+
+    if (!check_options(options, error))
+        return NULL;
+
+    VideoEffects *effects = calloc(1, sizeof(VideoEffects));
+    if (effects == NULL) {
+        snprintf(error, VIDEO_EFFECTS_ERROR_SIZE, "Failed to allocate memory.");
+        return NULL;
+    }
+
+    jmp_buf recovery;
+    if (setjmp(recovery) != 0) {
+        snprintf(error, VIDEO_EFFECTS_ERROR_SIZE, "%s", get_job_error());
+        video_effects_destroy(effects);
+        return NULL;
+    }
+
+    set_job_recovery(&recovery);
+    init_instance(effects, options);
+    set_job_recovery(NULL);
+
+    return effects;
+}
+
+static int check_frame(VideoEffects *effects, const AVFrame *frame) {
+
+    const bool packed = is_working_format(frame->format);
+    if (!packed && !(is_native_format(frame->format) &&
+                     (get_chain_capabilities(&effects->data) & EFFECT_PLANAR_YUV))) {
+        snprintf(effects->error, VIDEO_EFFECTS_ERROR_SIZE, "The filters do not support the pixel format %d",
+                 frame->format);
+        return AVERROR(EINVAL);
+    }
+
+    const int plane_count = packed ? 1 : frame->format == AV_PIX_FMT_NV12 ? 2 : 3;
+    bool planes = true;
+    for (int i = 0; i < plane_count; i++)
+        planes = planes && frame->data[i] != NULL;
+
+    if (frame->width <= 0 || frame->height <= 0 || !planes) {
+        snprintf(effects->error, VIDEO_EFFECTS_ERROR_SIZE, "The frame has no image");
+        return AVERROR(EINVAL);
+    }
+
+    // frames of the caller's planes have no buffer references
+    if (frame->buf[0] != NULL && !av_frame_is_writable((AVFrame *) frame)) {
+        snprintf(effects->error, VIDEO_EFFECTS_ERROR_SIZE, "The frame is not writable");
+        return AVERROR(EINVAL);
+    }
+
+    return 0;
+}
+
+int video_effects_process_frame(VideoEffects *effects, AVFrame *frame) {
+
+    effects->error[0] = '\0';
+
+    const int ret = check_frame(effects, frame);
+    if (ret < 0)
+        return ret;
+
+    jmp_buf recovery;
+    if (setjmp(recovery) != 0) {
+        snprintf(effects->error, VIDEO_EFFECTS_ERROR_SIZE, "%s", get_job_error());
+        return AVERROR_EXTERNAL;
+    }
+
+    set_job_recovery(&recovery);
+
+    // the largest random regions of a frame size are reserved once, like open_encoder() does
+    if (frame->width != effects->width || frame->height != effects->height) {
+        const int pixel_step = frame->format == AV_PIX_FMT_RGB0 ? 4 : frame->format == AV_PIX_FMT_RGB24 ? 3 : 1;
+        reserve_chain_scratch(&effects->data, frame->width, frame->height, pixel_step);
+        effects->width = frame->width;
+        effects->height = frame->height;
+    }
+
+    process_frame(frame, &effects->data);
+
+    set_job_recovery(NULL);
+    return 0;
+}
+
+int video_effects_process_planes(VideoEffects *effects, uint8_t *const data[4], const int linesize[4],
+                                 const int width, const int height, const enum AVPixelFormat format) {
+
+    AVFrame *frame = effects->planes;
+    for (int i = 0; i < 4; i++) {
+        frame->data[i] = data[i];
+        frame->linesize[i] = linesize[i];
+    }
+    frame->width = width;
+    frame->height = height;
+    frame->format = format;
+
+    return video_effects_process_frame(effects, frame);
+}
+
+const char *video_effects_get_error(const VideoEffects *effects) {
+    return effects->error;
+}
+
+void video_effects_destroy(VideoEffects *effects) {
+
+    if (effects == NULL)
+        return;
+
+    if (effects->pool_started)
+        pool_destroy(&effects->pool);
+
+    for (int i = 0; i < VIDEO_EFFECTS_MAX_FILTERS; i++)
+        cleanup_regions(&effects->regions[i]);
+
+    av_frame_free(&effects->planes);
+    free(effects->data.buffer);
+    free_scale_cache(effects->data.scale_cache);
+    free(effects);
+}
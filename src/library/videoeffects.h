@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdint.h>
+#include <libavutil/frame.h>
+
+// Frame level API of libvideoeffects, the region effects of video_effects without its file I/O.
+//
+// An instance keeps the region stacks, the scratch memory and the band workers of one stream, so frames of a
+// stream go through the same instance in display order. Instances do not share state and may be used on different
+// threads at the same time, a single instance is used by one thread at a time.
+
+// Same as -f with several filters
+#define VIDEO_EFFECTS_MAX_FILTERS 8
+
+#define VIDEO_EFFECTS_ERROR_SIZE 256
+
+typedef struct VideoEffects VideoEffects;
+
+typedef struct VideoEffectsOptions {
+
+    // ids of -f, applied to every frame in this order
+    int filters[VIDEO_EFFECTS_MAX_FILTERS];
+    int filter_count;
+
+    // --scale and --scale-filter ("nearest" or "bilinear", NULL for nearest), used by the scaling filters
+    float scale_factor;
+    const char *scale_filter;
+
+    // --seed, the same seed gives the same regions for the same frame sizes
+    unsigned int seed;
+
+    // threads that render the bands of a frame, the calling thread included. 1 renders on the calling thread.
+    int threads;
+
+} VideoEffectsOptions;
+
+// Filter 1 on a single thread with seed 0, the scale factor has to be set for it
+void video_effects_default_options(VideoEffectsOptions *options);
+
+// NULL if the options are invalid or the instance could not be set up. The reason is written to error, which holds
+// VIDEO_EFFECTS_ERROR_SIZE characters and may be NULL. The library never prints and never ends the process.
+VideoEffects *video_effects_create(const VideoEffectsOptions *options, char *error);
+
+// Applies the effects to the next frame of the stream in place. The frame is RGB24, RGB0 or, if all filters
+// support it, YUV420P, NV12 or YUV444P and has to be writable.
+// Returns 0 or a negative AVERROR, video_effects_get_error() describes the failure.
+int video_effects_process_frame(VideoEffects *effects, AVFrame *frame);
+
+// The same for frames in planes the caller owns, only the planes of the format are read
+int video_effects_process_planes(VideoEffects *effects, uint8_t *const data[4], const int linesize[4], int width,
+                                 int height, enum AVPixelFormat format);
+
+// Message of the last failed call on this instance, empty if there was none
+const char *video_effects_get_error(const VideoEffects *effects);
+
+void video_effects_destroy(VideoEffects *effects);
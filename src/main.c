@@ -1,5 +1,12 @@
 #include "video-effects.h"
 #include "cmdline.h"
+#include "region/kernels.h"
+#include "pool/pool.h"
+#include "region/timeline.h"
+#include "stats/stats.h"
+#include "batch/batch.h"
+#include "index/index.h"
+#include "registry/registry.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -7,34 +14,144 @@
 
 int main(int argc, char **argv) {
 
-    Regions region_data = {
-        .region_pair = NULL,
-        .size = 0
-    };
-
-    Config data = {
-        .region_data = &region_data,
-        .effect_id = NONE,
-        .scale_factor = 0.0f,
-        .buffer = NULL,
-        .input_file = NULL,
-        .output_file = NULL
-    };
+    Regions region_data;
+    Config data;
+    init_config(&data, &region_data);
 
     parse_cmdline(argc, argv, &data);
 
+    // the filters of the plugins are known from here on
+    for (int i = 0; i < data.plugin_count; i++)
+        load_effect_plugin(data.plugins[i]);
+
     if (validate_arguments(&data) == EXIT_FAILURE)
         exit(EXIT_FAILURE);
 
-    srand(time(NULL));
+    char index_path[4096];
+    if (data.build_index) {
+        get_index_path(&data, index_path, sizeof(index_path));
+        build_index(data.input_file, &data, index_path);
+        printf("[INFO] The index of '%s' was saved as '%s'\n", data.input_file, index_path);
+        return EXIT_SUCCESS;
+    }
+
+    // the first run with --index builds it
+    VideoIndex index = { 0 };
+    if (data.use_index) {
+        get_index_path(&data, index_path, sizeof(index_path));
+        if (!load_index(data.input_file, index_path, &index)) {
+            build_index(data.input_file, &data, index_path);
+            if (!load_index(data.input_file, index_path, &index)) {
+                fprintf(stderr, "[ERROR] Could not read the index '%s'\n", index_path);
+                exit(EXIT_FAILURE);
+            }
+        }
+        data.index = &index;
+    }
+
+    if (!data.seed_set)
+        data.seed = (unsigned int) time(NULL);
+    region_data.seed = data.seed;
+
+    // every effect of a -f chain draws its own regions, the first one the same as without the chain
+    Regions chain_regions[MAX_EFFECT_CHAIN - 1];
+    for (int i = 0; i < data.chain_length; i++) {
+        chain_regions[i] = (Regions) {
+            .region_pair = NULL,
+            .size = 0,
+            .seed = data.seed + (unsigned int) (i + 1) * CHAIN_SEED_STEP,
+            .frame = 0,
+            .draw = 0
+        };
+        data.chain_regions[i] = &chain_regions[i];
+    }
+
+    Timeline imported_timeline;
+    if (data.import_timeline != NULL) {
+        import_timeline(&imported_timeline, data.import_timeline);
+        if (imported_timeline.effect_id != data.effect_id) {
+            fprintf(stderr, "[ERROR] The region timeline '%s' was made for the filter '%s'\n", data.import_timeline,
+                    get_filter_name(imported_timeline.effect_id));
+            exit(EXIT_FAILURE);
+        }
+        data.timeline = &imported_timeline;
+    }
+
+    Timeline recorded_timeline;
+    if (data.export_timeline != NULL) {
+        init_timeline(&recorded_timeline, 0, 0, data.effect_id, data.seed);
+        data.recorded_timeline = &recorded_timeline;
+    }
+
+    use_row_kernels(find_row_kernels(data.kernels));
+
+    // the batch workers run their jobs serially, so there is no band pool
+    if (data.batch != NULL) {
+        if (data.batch_jobs == 0)
+            data.batch_jobs = get_core_count();
+
+        stats_enabled = data.stats_json != NULL;
+        const int64_t start = stats_begin_run();
+
+        const int failed = process_batch(data.batch, data.batch_results, &data);
+
+        if (stats_enabled)
+            write_stats_report(data.stats_json, data.batch, data.batch_results, "batch", stats_now() - start);
+
+        unload_effect_plugins();
+        return failed > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    // the calling thread works on one band itself
+    WorkerPool pool;
+    const int band_threads = (data.bands > 0 ? data.bands : get_core_count()) - 1;
+    if (data.bands != 1 && band_threads > 0) {
+        pool_init(&pool, band_threads, data.bands);
+        data.pool = &pool;
+    }
+
+    stats_enabled = data.stats_json != NULL;
+    const int64_t start = stats_begin_run();
 
     process_video(data.input_file, data.output_file, &data);
 
+    char filter_name[256];
+    get_chain_name(&data, filter_name, sizeof(filter_name));
+
+    if (stats_enabled)
+        write_stats_report(data.stats_json, data.input_file, data.output_file, filter_name, stats_now() - start);
+
+    if (data.pool != NULL)
+        pool_destroy(data.pool);
+
+    if (data.timeline != NULL)
+        free_timeline(&imported_timeline);
+
+    if (data.recorded_timeline != NULL) {
+        export_timeline(data.recorded_timeline, data.export_timeline);
+        free_timeline(&recorded_timeline);
+    }
+
     cleanup_regions(data.region_data);
+    for (int i = 0; i < data.chain_length; i++)
+        cleanup_regions(data.chain_regions[i]);
     free(data.buffer);
+    free_scale_cache(data.scale_cache);
+    close_index(&index);
+
+    // stdout may carry the video
+    bool piped = is_pipe_path(data.output_file);
+    for (int i = 0; i < data.target_count; i++)
+        piped = piped || is_pipe_path(data.targets[i].output_file);
+    FILE *info = piped ? stderr : stdout;
+
+    fprintf(info, "[INFO] The filter '%s' was successfully applied to '%s' and saved as '%s'\n",
+            filter_name, data.input_file, data.output_file);
+    for (int i = 0; i < data.target_count; i++)
+        fprintf(info, "[INFO] The filter '%s' was successfully applied to '%s' and saved as '%s'\n",
+               get_filter_name(data.targets[i].effect_id), data.input_file, data.targets[i].output_file);
 
-    printf("[INFO] The filter '%s' was successfully applied to '%s' and saved as '%s'\n",
-           get_filter_name(data.effect_id), data.input_file, data.output_file);
+    unload_effect_plugins();
 
     return EXIT_SUCCESS;
 }
\ No newline at end of file
@@ -0,0 +1,216 @@
+#include "pipeline.h"
+#include "queue.h"
+#include "video-effects.h"
+#include "stats/stats.h"
+#include "realtime/realtime.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+typedef void (*StageFunction)(VideoContext *ctx, FrameSlot *slot);
+
+typedef struct Pipeline {
+    VideoContext *ctx;
+
+    FrameSlot *slots;
+    int depth;
+
+    Queue free_slots;
+    Queue packets;   // demux -> decode
+    Queue decoded;   // decode -> rgb conversion
+    Queue converted; // rgb conversion -> effect
+    Queue processed; // effect -> back conversion
+    Queue encodable; // back conversion -> encode
+    Queue muxable;   // demux and encode -> mux
+} Pipeline;
+
+typedef struct Stage {
+    Pipeline *pipeline;
+    StageFunction function;
+    Queue *in;
+    Queue *out;
+} Stage;
+
+static AVPacket *alloc_packet(void) {
+    AVPacket *packet = av_packet_alloc();
+    NOT_NULL(packet);
+    return packet;
+}
+
+static void *demux_thread(void *arg) {
+
+    Pipeline *pipeline = arg;
+    VideoContext *ctx = pipeline->ctx;
+
+    AVPacket *packet = alloc_packet();
+    while (read_packet(ctx, packet) >= 0) {
+        if (packet->stream_index == ctx->video_stream_index)
+            queue_push(&pipeline->packets, packet);
+        else
+            queue_push(&pipeline->muxable, packet);
+        packet = alloc_packet();
+    }
+    av_packet_free(&packet);
+
+    queue_push(&pipeline->packets, NULL);
+    queue_push(&pipeline->muxable, NULL);
+
+    return NULL;
+}
+
+static void *decode_thread(void *arg) {
+
+    Pipeline *pipeline = arg;
+    VideoContext *ctx = pipeline->ctx;
+
+    FrameSlot *slot = queue_pop(&pipeline->free_slots);
+
+    AVPacket *packet;
+    do {
+        packet = queue_pop(&pipeline->packets);
+
+        // the end marker doubles as flush packet for the frames the decoder still holds back
+        send_packet(ctx, packet);
+        av_packet_free(&packet);
+
+        while (receive_frame(ctx, slot)) {
+            queue_push(&pipeline->decoded, slot);
+            slot = queue_pop(&pipeline->free_slots);
+        }
+    } while (packet != NULL);
+
+    queue_push(&pipeline->free_slots, slot);
+    queue_push(&pipeline->decoded, NULL);
+
+    return NULL;
+}
+
+static void *stage_thread(void *arg) {
+
+    const Stage *stage = arg;
+
+    FrameSlot *slot;
+    while ((slot = queue_pop(stage->in)) != NULL) {
+        stage->function(stage->pipeline->ctx, slot);
+        queue_push(stage->out, slot);
+    }
+    queue_push(stage->out, NULL);
+
+    return NULL;
+}
+
+static void queue_packet(VideoContext *ctx, AVPacket *packet, void *opaque) {
+
+    Pipeline *pipeline = opaque;
+
+    AVPacket *queued = alloc_packet();
+    av_packet_move_ref(queued, packet);
+    queue_push(&pipeline->muxable, queued);
+}
+
+static void *encode_thread(void *arg) {
+
+    Pipeline *pipeline = arg;
+    VideoContext *ctx = pipeline->ctx;
+
+    FrameSlot *slot;
+    while ((slot = queue_pop(&pipeline->encodable)) != NULL) {
+        if (!slot->dropped) {
+            stats_stop(STATS_FRAME_LATENCY, slot->decoded_at);
+            encode_frame(ctx, slot->encodable, queue_packet, pipeline);
+            if (ctx->realtime != NULL)
+                record_frame_done(ctx->realtime, slot->deadline);
+        }
+        av_frame_unref(slot->input_frame);
+        queue_push(&pipeline->free_slots, slot);
+    }
+
+    encode_frame(ctx, NULL, queue_packet, pipeline);
+    queue_push(&pipeline->muxable, NULL);
+
+    return NULL;
+}
+
+static void start_thread(pthread_t *thread, void *(*function)(void *), void *arg) {
+    if (pthread_create(thread, NULL, function, arg) != 0) {
+        fprintf(stderr, "[ERROR] Failed to start pipeline thread.\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+void process_video_pipelined(VideoContext *ctx, const int depth) {
+
+    Pipeline pipeline = {
+        .ctx = ctx,
+        .depth = depth
+    };
+
+    pipeline.slots = malloc(sizeof(FrameSlot) * depth);
+    if (pipeline.slots == NULL) {
+        fprintf(stderr, "[ERROR] Failed to allocate memory.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // every slot queue has room for all slots plus the end-of-stream marker
+    queue_init(&pipeline.free_slots, depth + 1);
+    queue_init(&pipeline.packets, depth + 1);
+    queue_init(&pipeline.decoded, depth + 1);
+    queue_init(&pipeline.converted, depth + 1);
+    queue_init(&pipeline.processed, depth + 1);
+    queue_init(&pipeline.encodable, depth + 1);
+    queue_init(&pipeline.muxable, 2 * depth + 2);
+
+    for (int i = 0; i < depth; i++) {
+        alloc_frame_slot(ctx, &pipeline.slots[i]);
+        queue_push(&pipeline.free_slots, &pipeline.slots[i]);
+    }
+
+    Stage stages[] = {
+        { &pipeline, convert_to_rgb, &pipeline.decoded, &pipeline.converted },
+        { &pipeline, apply_frame_effect, &pipeline.converted, &pipeline.processed },
+        { &pipeline, convert_to_output, &pipeline.processed, &pipeline.encodable }
+    };
+    const int stage_count = sizeof(stages) / sizeof(stages[0]);
+
+    pthread_t demux, decode, encode;
+    pthread_t stage_threads[stage_count];
+
+    start_thread(&demux, demux_thread, &pipeline);
+    start_thread(&decode, decode_thread, &pipeline);
+    for (int i = 0; i < stage_count; i++)
+        start_thread(&stage_threads[i], stage_thread, &stages[i]);
+    start_thread(&encode, encode_thread, &pipeline);
+
+    // the calling thread is the muxer, it stops after the end markers of demux and encode
+    int finished = 0;
+    while (finished < 2) {
+        AVPacket *packet = queue_pop(&pipeline.muxable);
+        if (packet == NULL) {
+            finished++;
+            continue;
+        }
+        write_packet(ctx, packet, NULL);
+        av_packet_free(&packet);
+    }
+
+    pthread_join(demux, NULL);
+    pthread_join(decode, NULL);
+    for (int i = 0; i < stage_count; i++)
+        pthread_join(stage_threads[i], NULL);
+    pthread_join(encode, NULL);
+
+    for (int i = 0; i < depth; i++)
+        free_frame_slot(&pipeline.slots[i]);
+    free(pipeline.slots);
+
+    stats_queue_high_water(STATS_QUEUE_MUX, pipeline.muxable.high_water, pipeline.muxable.capacity);
+
+    queue_destroy(&pipeline.free_slots);
+    queue_destroy(&pipeline.packets);
+    queue_destroy(&pipeline.decoded);
+    queue_destroy(&pipeline.converted);
+    queue_destroy(&pipeline.processed);
+    queue_destroy(&pipeline.encodable);
+    queue_destroy(&pipeline.muxable);
+}
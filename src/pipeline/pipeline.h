@@ -0,0 +1,10 @@
+#pragma once
+
+#include "video-effects.h"
+
+#define DEFAULT_PIPELINE_DEPTH 4
+#define MAX_PIPELINE_DEPTH 64
+
+// Runs demux, decode, rgb conversion, effect, back conversion, encode and mux on separate threads.
+// depth is the number of frames in flight, the output is identical to the serial loop.
+void process_video_pipelined(VideoContext *ctx, int depth);
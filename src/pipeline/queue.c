@@ -0,0 +1,68 @@
+#include "queue.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+void queue_init(Queue *queue, const int capacity) {
+
+    queue->items = malloc(sizeof(void *) * capacity);
+    if (queue->items == NULL) {
+        fprintf(stderr, "[ERROR] Failed to allocate memory.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    queue->capacity = capacity;
+    queue->head = 0;
+    queue->count = 0;
+    queue->high_water = 0;
+
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->not_empty, NULL);
+    pthread_cond_init(&queue->not_full, NULL);
+}
+
+void queue_destroy(Queue *queue) {
+
+    free(queue->items);
+    queue->items = NULL;
+
+    pthread_mutex_destroy(&queue->lock);
+    pthread_cond_destroy(&queue->not_empty);
+    pthread_cond_destroy(&queue->not_full);
+}
+
+bool queue_push(Queue *queue, void *item) {
+
+    pthread_mutex_lock(&queue->lock);
+
+    const bool full = queue->count == queue->capacity;
+    while (queue->count == queue->capacity)
+        pthread_cond_wait(&queue->not_full, &queue->lock);
+
+    queue->items[(queue->head + queue->count) % queue->capacity] = item;
+    queue->count++;
+    if (queue->count > queue->high_water)
+        queue->high_water = queue->count;
+
+    pthread_cond_signal(&queue->not_empty);
+    pthread_mutex_unlock(&queue->lock);
+
+    return full;
+}
+
+void *queue_pop(Queue *queue) {
+
+    pthread_mutex_lock(&queue->lock);
+
+    while (queue->count == 0)
+        pthread_cond_wait(&queue->not_empty, &queue->lock);
+
+    void *item = queue->items[queue->head];
+    queue->head = (queue->head + 1) % queue->capacity;
+    queue->count--;
+
+    pthread_cond_signal(&queue->not_full);
+    pthread_mutex_unlock(&queue->lock);
+
+    return item;
+}
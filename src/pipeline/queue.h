@@ -0,0 +1,27 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdbool.h>
+
+// Bounded blocking FIFO of pointers, NULL is reserved as end-of-stream marker
+typedef struct Queue {
+    void **items;
+    int capacity;
+    int head;
+    int count;
+    // most items the queue held at once
+    int high_water;
+
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+} Queue;
+
+void queue_init(Queue *queue, int capacity);
+
+void queue_destroy(Queue *queue);
+
+// Returns whether the queue was full and the caller had to wait
+bool queue_push(Queue *queue, void *item);
+
+void *queue_pop(Queue *queue);
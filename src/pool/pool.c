@@ -0,0 +1,174 @@
+#include "pool.h"
+#include "video-effects.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+static void run_band(WorkerPool *pool, const BandFunction function, void *arg, const int rows, const int bands,
+                     const int band) {
+
+    function(arg, (int) ((long long) rows * band / bands), (int) ((long long) rows * (band + 1) / bands));
+
+    pthread_mutex_lock(&pool->lock);
+    pool->finished_bands++;
+    if (pool->finished_bands == bands)
+        pthread_cond_broadcast(&pool->work_done);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+// Hands out the remaining bands of the current job, called and returning with the lock held
+static void take_bands(WorkerPool *pool) {
+
+    while (pool->next_band < pool->bands) {
+        const BandFunction function = pool->function;
+        void *arg = pool->arg;
+        const int rows = pool->rows;
+        const int bands = pool->bands;
+        const int band = pool->next_band++;
+
+        pthread_mutex_unlock(&pool->lock);
+        run_band(pool, function, arg, rows, bands, band);
+        pthread_mutex_lock(&pool->lock);
+    }
+}
+
+static void *pool_worker(void *arg) {
+
+    WorkerPool *pool = arg;
+    unsigned long seen = 0;
+
+    pthread_mutex_lock(&pool->lock);
+
+    while (true) {
+        while (!pool->stop && pool->generation == seen)
+            pthread_cond_wait(&pool->work_ready, &pool->lock);
+
+        if (pool->stop)
+            break;
+
+        seen = pool->generation;
+        take_bands(pool);
+    }
+
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+void pool_init(WorkerPool *pool, const int thread_count, const int max_bands) {
+
+    pool->threads = malloc(sizeof(pthread_t) * (thread_count > 0 ? thread_count : 1));
+    if (pool->threads == NULL) {
+        fail_job("Failed to allocate memory.");
+    }
+
+    pool->thread_count = thread_count;
+    pool->function = NULL;
+    pool->arg = NULL;
+    pool->rows = 0;
+    pool->bands = 0;
+    pool->next_band = 0;
+    pool->finished_bands = 0;
+    pool->generation = 0;
+    pool->stop = false;
+    pool->max_bands = max_bands;
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work_ready, NULL);
+    pthread_cond_init(&pool->work_done, NULL);
+
+    for (int i = 0; i < thread_count; i++) {
+        if (pthread_create(&pool->threads[i], NULL, pool_worker, pool) != 0) {
+            fail_job("Failed to start band worker thread");
+        }
+    }
+}
+
+void pool_destroy(WorkerPool *pool) {
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = true;
+    pthread_cond_broadcast(&pool->work_ready);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < pool->thread_count; i++)
+        pthread_join(pool->threads[i], NULL);
+
+    free(pool->threads);
+    pool->threads = NULL;
+
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->work_ready);
+    pthread_cond_destroy(&pool->work_done);
+}
+
+static int get_band_limit(const WorkerPool *pool) {
+
+    if (pool == NULL)
+        return 1;
+
+    const int limit = pool->max_bands > 0 ? pool->max_bands : pool->thread_count + 1;
+
+    return limit < MAX_BANDS ? limit : MAX_BANDS;
+}
+
+int get_band_count(const WorkerPool *pool, const int rows, const size_t row_size) {
+
+    int bands = get_band_limit(pool);
+
+    if (bands > rows / MIN_BAND_ROWS)
+        bands = rows / MIN_BAND_ROWS;
+
+    const size_t size = (size_t) rows * row_size;
+    if ((size_t) bands > size / MIN_BAND_BYTES)
+        bands = (int) (size / MIN_BAND_BYTES);
+
+    return bands > 1 ? bands : 1;
+}
+
+int get_frame_band_count(const WorkerPool *pool, const int height) {
+
+    int bands = get_band_limit(pool);
+
+    if (bands > height / FRAME_BAND_ROWS)
+        bands = height / FRAME_BAND_ROWS;
+
+    return bands > 1 ? bands : 1;
+}
+
+void pool_run_bands(WorkerPool *pool, const BandFunction function, void *arg, const int rows,
+                    const size_t row_size) {
+
+    const int bands = get_band_count(pool, rows, row_size);
+
+    if (bands <= 1) {
+        function(arg, 0, rows);
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+
+    pool->function = function;
+    pool->arg = arg;
+    pool->rows = rows;
+    pool->bands = bands;
+    pool->next_band = 0;
+    pool->finished_bands = 0;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->work_ready);
+
+    take_bands(pool);
+
+    while (pool->finished_bands < bands)
+        pthread_cond_wait(&pool->work_done, &pool->lock);
+
+    pthread_mutex_unlock(&pool->lock);
+}
+
+int get_core_count(void) {
+
+    const long cores = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return cores > 0 ? (int) cores : 1;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define MAX_BANDS 64
+
+// Bands are never thinner than this many rows or smaller than this many bytes, thinner bands cost more to
+// hand out than they save
+#define MIN_BAND_ROWS 16
+#define MIN_BAND_BYTES (64 * 1024)
+
+// Rows of frame height per sws slice thread, 1080p gets up to 8 and 2160p up to 16
+#define FRAME_BAND_ROWS 135
+
+// Splits rows [first_row, last_row) of a job, called concurrently for disjoint ranges
+typedef void (*BandFunction)(void *arg, int first_row, int last_row);
+
+// Persistent threads that work on the bands of one job at a time together with the calling thread
+typedef struct WorkerPool {
+    pthread_t *threads;
+    int thread_count;
+
+    pthread_mutex_t lock;
+    pthread_cond_t work_ready;
+    pthread_cond_t work_done;
+
+    BandFunction function;
+    void *arg;
+    int rows;
+    int bands;
+    int next_band;
+    int finished_bands;
+    unsigned long generation;
+    bool stop;
+
+    // --bands, 0 picks the band count from the rows and the thread count
+    int max_bands;
+} WorkerPool;
+
+// thread_count additional threads, the caller of pool_run_bands() is the last worker
+void pool_init(WorkerPool *pool, int thread_count, int max_bands);
+
+void pool_destroy(WorkerPool *pool);
+
+// Runs function on bands of rows and returns when all of them are done. A NULL pool runs everything inline.
+void pool_run_bands(WorkerPool *pool, BandFunction function, void *arg, int rows, size_t row_size);
+
+// Number of bands pool_run_bands() uses for rows of row_size bytes
+int get_band_count(const WorkerPool *pool, int rows, size_t row_size);
+
+// Number of slice threads for converting whole frames of the given height
+int get_frame_band_count(const WorkerPool *pool, int height);
+
+// Online cores, at least 1
+int get_core_count(void);
@@ -0,0 +1,102 @@
+#include "realtime.h"
+#include "video-effects.h"
+#include "stats/stats.h"
+
+#include <inttypes.h>
+
+// Weight of a faster measurement in the moving averages, 1/8. Slower ones are taken as they are, so a slowdown
+// degrades the next frame already.
+#define COST_SHIFT 3
+// Per frame, the estimates of the paths that are not taken shrink by 1/32
+#define DECAY_SHIFT 5
+
+void init_realtime(RealtimeSchedule *schedule, const AVRational frame_rate, const bool bilinear) {
+
+    if (frame_rate.num <= 0 || frame_rate.den <= 0)
+        fail_job("Real-time mode needs the frame rate of the video stream");
+
+    *schedule = (RealtimeSchedule) {
+        .frame_interval = (int64_t) (1e9 * frame_rate.den / frame_rate.num),
+        .origin = 0,
+        .frames = 0,
+        .effect_cost = 0,
+        .nearest_cost = 0,
+        .bilinear = bilinear
+    };
+}
+
+int64_t schedule_frame(RealtimeSchedule *schedule) {
+
+    if (schedule->origin == 0)
+        schedule->origin = stats_now();
+
+    schedule->frames++;
+    return schedule->origin + schedule->frames * schedule->frame_interval;
+}
+
+// The decoding thread decays a cost while the effect stage records a new one
+static void decay_cost(int64_t *cost) {
+
+    int64_t current = __atomic_load_n(cost, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(cost, &current, current - (current >> DECAY_SHIFT), false, __ATOMIC_RELAXED,
+                                        __ATOMIC_RELAXED));
+}
+
+RealtimeAction choose_realtime_action(RealtimeSchedule *schedule, const int64_t deadline) {
+
+    const int64_t remaining = deadline - stats_now();
+
+    RealtimeAction action;
+    if (remaining < 0)
+        action = REALTIME_DROP;
+    else if (__atomic_load_n(&schedule->effect_cost, __ATOMIC_RELAXED) <= remaining)
+        action = REALTIME_FULL;
+    else if (schedule->bilinear && __atomic_load_n(&schedule->nearest_cost, __ATOMIC_RELAXED) <= remaining)
+        action = REALTIME_NEAREST;
+    else
+        action = REALTIME_SKIP;
+
+    // the estimates of the paths that are not taken decay, so they are tried again once the load goes down
+    if (action != REALTIME_FULL)
+        decay_cost(&schedule->effect_cost);
+    if (action != REALTIME_NEAREST)
+        decay_cost(&schedule->nearest_cost);
+
+    schedule->actions[action]++;
+    return action;
+}
+
+void record_effect_time(RealtimeSchedule *schedule, const RealtimeAction action, const int64_t nanoseconds) {
+
+    int64_t *cost = action == REALTIME_NEAREST ? &schedule->nearest_cost : &schedule->effect_cost;
+
+    int64_t current = __atomic_load_n(cost, __ATOMIC_RELAXED);
+    int64_t updated;
+    do {
+        updated = nanoseconds > current ? nanoseconds : current + ((nanoseconds - current) >> COST_SHIFT);
+    } while (!__atomic_compare_exchange_n(cost, &current, updated, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+void record_frame_done(RealtimeSchedule *schedule, const int64_t deadline) {
+
+    const int64_t now = stats_now();
+
+    // the frame arrived one interval before its deadline
+    stats_record(STATS_REALTIME_LATENCY, now - (deadline - schedule->frame_interval));
+
+    if (now > deadline)
+        __atomic_fetch_add(&schedule->late_frames, 1, __ATOMIC_RELAXED);
+}
+
+void print_realtime_summary(const RealtimeSchedule *schedule, FILE *file) {
+
+    fprintf(file, "[INFO] Real-time: %" PRId64 " frames, %" PRId64 " with nearest scaling, %" PRId64
+                  " without effect, %" PRId64 " dropped, %" PRId64 " encoded after their deadline\n",
+            schedule->frames, schedule->actions[REALTIME_NEAREST], schedule->actions[REALTIME_SKIP],
+            schedule->actions[REALTIME_DROP], schedule->late_frames);
+
+    fprintf(file, "[INFO] Real-time latency: p50 %.3f ms, p99 %.3f ms, max %.3f ms\n",
+            get_stats_percentile(STATS_REALTIME_LATENCY, 0.5) / 1e6,
+            get_stats_percentile(STATS_REALTIME_LATENCY, 0.99) / 1e6,
+            get_stats_percentile(STATS_REALTIME_LATENCY, 1.0) / 1e6);
+}
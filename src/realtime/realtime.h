@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <libavutil/rational.h>
+
+// What the effect stage does with a frame in --realtime mode, from the full effect down to dropping the frame
+typedef enum RealtimeAction {
+    REALTIME_FULL = 0,
+    // bilinear Region Scaling falls back to nearest neighbour
+    REALTIME_NEAREST,
+    // the regions are planned but not rendered, the frame is passed on unchanged
+    REALTIME_SKIP,
+    // the frame was already late when it left the decoder, it is neither converted nor encoded
+    REALTIME_DROP,
+    REALTIME_ACTION_COUNT
+} RealtimeAction;
+
+// Per-frame deadlines of --realtime. Frame n is due one frame interval after it should have arrived, i.e.
+// n + 1 intervals after the first frame left the decoder.
+typedef struct RealtimeSchedule {
+
+    int64_t frame_interval;
+    // stats_now() when the first frame was decoded, 0 before
+    int64_t origin;
+    int64_t frames;
+
+    // moving averages of the effect time in nanoseconds, with the configured scale filter and with nearest. The
+    // decoding thread decays them and the effect stage records them, both only access them atomically.
+    int64_t effect_cost;
+    int64_t nearest_cost;
+    // whether the effects use bilinear scaling, the only case REALTIME_NEAREST is of any use
+    bool bilinear;
+
+    int64_t actions[REALTIME_ACTION_COUNT];
+    // frames that left the encoder after their deadline
+    int64_t late_frames;
+
+} RealtimeSchedule;
+
+// frame_rate of the video stream, fails the job if it is unknown
+void init_realtime(RealtimeSchedule *schedule, AVRational frame_rate, bool bilinear);
+
+// Deadline of the next decoded frame in stats_now() time, called once per frame in decode order
+int64_t schedule_frame(RealtimeSchedule *schedule);
+
+// Picks the cheapest degradation that still meets the deadline according to the measured effect times
+RealtimeAction choose_realtime_action(RealtimeSchedule *schedule, int64_t deadline);
+
+// Effect time of a frame processed with REALTIME_FULL or REALTIME_NEAREST
+void record_effect_time(RealtimeSchedule *schedule, RealtimeAction action, int64_t nanoseconds);
+
+// Records the end-to-end latency of a frame that left the encoder, from when it was due at the input
+void record_frame_done(RealtimeSchedule *schedule, int64_t deadline);
+
+void print_realtime_summary(const RealtimeSchedule *schedule, FILE *file);
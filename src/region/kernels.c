@@ -0,0 +1,288 @@
+#include "kernels.h"
+
+#include <pthread.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define HAVE_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+static void copy_row_scalar(uint8_t *dst, const uint8_t *src, const size_t size) {
+    for (size_t i = 0; i < size; i++)
+        dst[i] = src[i];
+}
+
+static void swap_row_scalar(uint8_t *a, uint8_t *b, const size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        const uint8_t tmp = a[i];
+        a[i] = b[i];
+        b[i] = tmp;
+    }
+}
+
+static void fill_row_scalar(uint8_t *dst, const uint8_t value, const size_t size) {
+    for (size_t i = 0; i < size; i++)
+        dst[i] = value;
+}
+
+static void gather_row_scalar(uint8_t *dst, const uint8_t *src, const int32_t *offset, const int count,
+                              const int step) {
+    for (int i = 0; i < count; i++) {
+        const uint8_t *pixel = src + offset[i];
+        for (int c = 0; c < step; c++)
+            dst[i * step + c] = pixel[c];
+    }
+}
+
+#ifdef HAVE_X86_KERNELS
+
+__attribute__((target("sse2")))
+static void copy_row_sse2(uint8_t *dst, const uint8_t *src, const size_t size) {
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16)
+        _mm_storeu_si128((__m128i *) (dst + i), _mm_loadu_si128((const __m128i *) (src + i)));
+    copy_row_scalar(dst + i, src + i, size - i);
+}
+
+__attribute__((target("sse2")))
+static void swap_row_sse2(uint8_t *a, uint8_t *b, const size_t size) {
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        const __m128i va = _mm_loadu_si128((const __m128i *) (a + i));
+        const __m128i vb = _mm_loadu_si128((const __m128i *) (b + i));
+        _mm_storeu_si128((__m128i *) (a + i), vb);
+        _mm_storeu_si128((__m128i *) (b + i), va);
+    }
+    swap_row_scalar(a + i, b + i, size - i);
+}
+
+__attribute__((target("sse2")))
+static void fill_row_sse2(uint8_t *dst, const uint8_t value, const size_t size) {
+    const __m128i v = _mm_set1_epi8((char) value);
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16)
+        _mm_storeu_si128((__m128i *) (dst + i), v);
+    fill_row_scalar(dst + i, value, size - i);
+}
+
+__attribute__((target("avx2")))
+static void copy_row_avx2(uint8_t *dst, const uint8_t *src, const size_t size) {
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32)
+        _mm256_storeu_si256((__m256i *) (dst + i), _mm256_loadu_si256((const __m256i *) (src + i)));
+    copy_row_sse2(dst + i, src + i, size - i);
+}
+
+__attribute__((target("avx2")))
+static void swap_row_avx2(uint8_t *a, uint8_t *b, const size_t size) {
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        const __m256i va = _mm256_loadu_si256((const __m256i *) (a + i));
+        const __m256i vb = _mm256_loadu_si256((const __m256i *) (b + i));
+        _mm256_storeu_si256((__m256i *) (a + i), vb);
+        _mm256_storeu_si256((__m256i *) (b + i), va);
+    }
+    swap_row_sse2(a + i, b + i, size - i);
+}
+
+__attribute__((target("avx2")))
+static void fill_row_avx2(uint8_t *dst, const uint8_t value, const size_t size) {
+    const __m256i v = _mm256_set1_epi8((char) value);
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32)
+        _mm256_storeu_si256((__m256i *) (dst + i), v);
+    fill_row_sse2(dst + i, value, size - i);
+}
+
+// RGB0: every gathered dword is a whole pixel, so the gather result is stored as is
+__attribute__((target("avx2")))
+static int gather_rgb0_avx2(uint8_t *dst, const uint8_t *src, const int32_t *offset, const int count) {
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256i index = _mm256_loadu_si256((const __m256i *) (offset + i));
+        _mm256_storeu_si256((__m256i *) (dst + i * 4), _mm256_i32gather_epi32((const int *) src, index, 1));
+    }
+    return i;
+}
+
+// RGB24: the fourth byte of every gathered dword belongs to the next pixel. It is dropped within the lanes, the
+// lanes are joined and only the 24 pixel bytes are stored, so nothing past the last pixel is written.
+__attribute__((target("avx2")))
+static int gather_rgb24_avx2(uint8_t *dst, const uint8_t *src, const int32_t *offset, const int count) {
+    const __m256i pack = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+                                          0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    const __m256i join = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256i index = _mm256_loadu_si256((const __m256i *) (offset + i));
+        const __m256i pixels = _mm256_i32gather_epi32((const int *) src, index, 1);
+        const __m256i packed = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(pixels, pack), join);
+
+        uint8_t *out = dst + i * 3;
+        _mm_storeu_si128((__m128i *) out, _mm256_castsi256_si128(packed));
+        _mm_storel_epi64((__m128i *) (out + 16), _mm256_extracti128_si256(packed, 1));
+    }
+    return i;
+}
+
+// Planar YUV: packs the low step bytes of every gathered dword within the lanes and joins the lanes
+__attribute__((target("avx2")))
+static int gather_narrow_avx2(uint8_t *dst, const uint8_t *src, const int32_t *offset, const int count,
+                              const int step) {
+    static const int8_t pack[2][16] = {
+        { 0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+        { 0, 1, 4, 5, 8, 9, 12, 13, -1, -1, -1, -1, -1, -1, -1, -1 }
+    };
+
+    const __m128i pack_lane = _mm_loadu_si128((const __m128i *) pack[step - 1]);
+    const __m256i pack_mask = _mm256_inserti128_si256(_mm256_castsi128_si256(pack_lane), pack_lane, 1);
+    const __m256i join = step == 1 ? _mm256_setr_epi32(0, 4, 1, 1, 1, 1, 1, 1)
+                                   : _mm256_setr_epi32(0, 1, 4, 5, 2, 2, 2, 2);
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256i index = _mm256_loadu_si256((const __m256i *) (offset + i));
+        const __m256i pixels = _mm256_i32gather_epi32((const int *) src, index, 1);
+        const __m256i packed = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(pixels, pack_mask), join);
+
+        uint8_t *out = dst + i * step;
+        if (step == 2)
+            _mm_storeu_si128((__m128i *) out, _mm256_castsi256_si128(packed));
+        else
+            _mm_storel_epi64((__m128i *) out, _mm256_castsi256_si128(packed));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static void gather_row_avx2(uint8_t *dst, const uint8_t *src, const int32_t *offset, const int count,
+                            const int step) {
+
+    // every pixel size has its own vector path, wider pixels are gathered with the scalar loop
+    int done = 0;
+    if (step == 1 || step == 2)
+        done = gather_narrow_avx2(dst, src, offset, count, step);
+    else if (step == 3)
+        done = gather_rgb24_avx2(dst, src, offset, count);
+    else if (step == 4)
+        done = gather_rgb0_avx2(dst, src, offset, count);
+
+    gather_row_scalar(dst + done * step, src, offset + done, count - done, step);
+}
+
+// the tails are handled with byte masks, so no scalar loop is needed
+static inline __mmask64 tail_mask(const size_t size) {
+    return (__mmask64) ((1ULL << size) - 1);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static void copy_row_avx512(uint8_t *dst, const uint8_t *src, const size_t size) {
+    size_t i = 0;
+    for (; i + 64 <= size; i += 64)
+        _mm512_storeu_si512(dst + i, _mm512_loadu_si512(src + i));
+    if (i < size) {
+        const __mmask64 mask = tail_mask(size - i);
+        _mm512_mask_storeu_epi8(dst + i, mask, _mm512_maskz_loadu_epi8(mask, src + i));
+    }
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static void swap_row_avx512(uint8_t *a, uint8_t *b, const size_t size) {
+    size_t i = 0;
+    for (; i + 64 <= size; i += 64) {
+        const __m512i va = _mm512_loadu_si512(a + i);
+        const __m512i vb = _mm512_loadu_si512(b + i);
+        _mm512_storeu_si512(a + i, vb);
+        _mm512_storeu_si512(b + i, va);
+    }
+    if (i < size) {
+        const __mmask64 mask = tail_mask(size - i);
+        const __m512i va = _mm512_maskz_loadu_epi8(mask, a + i);
+        const __m512i vb = _mm512_maskz_loadu_epi8(mask, b + i);
+        _mm512_mask_storeu_epi8(a + i, mask, vb);
+        _mm512_mask_storeu_epi8(b + i, mask, va);
+    }
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static void fill_row_avx512(uint8_t *dst, const uint8_t value, const size_t size) {
+    const __m512i v = _mm512_set1_epi8((char) value);
+    size_t i = 0;
+    for (; i + 64 <= size; i += 64)
+        _mm512_storeu_si512(dst + i, v);
+    if (i < size)
+        _mm512_mask_storeu_epi8(dst + i, tail_mask(size - i), v);
+}
+
+#endif
+
+static const RowKernels kernels[] = {
+    { "scalar", copy_row_scalar, swap_row_scalar, fill_row_scalar, gather_row_scalar },
+#ifdef HAVE_X86_KERNELS
+    // SSE2 has no gather, AVX-512 reuses the AVX2 gather since a 16 wide gather is not faster for short rows
+    { "sse2", copy_row_sse2, swap_row_sse2, fill_row_sse2, gather_row_scalar },
+    { "avx2", copy_row_avx2, swap_row_avx2, fill_row_avx2, gather_row_avx2 },
+    { "avx512", copy_row_avx512, swap_row_avx512, fill_row_avx512, gather_row_avx2 },
+#endif
+};
+
+static const int kernel_count = sizeof(kernels) / sizeof(kernels[0]);
+
+static bool cpu_supports(const RowKernels *set) {
+#ifdef HAVE_X86_KERNELS
+    __builtin_cpu_init();
+    if (strcmp(set->name, "sse2") == 0)
+        return __builtin_cpu_supports("sse2");
+    if (strcmp(set->name, "avx2") == 0)
+        return __builtin_cpu_supports("avx2");
+    if (strcmp(set->name, "avx512") == 0)
+        return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+#endif
+    return true;
+}
+
+const RowKernels *find_row_kernels(const char *name) {
+
+    if (strcmp(name, "auto") == 0) {
+        // the list is ordered from narrowest to widest
+        for (int i = kernel_count - 1; i > 0; i--) {
+            if (cpu_supports(&kernels[i]))
+                return &kernels[i];
+        }
+        return &kernels[0];
+    }
+
+    for (int i = 0; i < kernel_count; i++) {
+        if (strcmp(name, kernels[i].name) == 0)
+            return cpu_supports(&kernels[i]) ? &kernels[i] : NULL;
+    }
+
+    return NULL;
+}
+
+static const RowKernels *active_kernels = NULL;
+static pthread_once_t default_kernels_once = PTHREAD_ONCE_INIT;
+
+static void select_default_kernels(void) {
+    if (active_kernels == NULL)
+        active_kernels = find_row_kernels("auto");
+}
+
+void use_row_kernels(const RowKernels *kernels) {
+    active_kernels = kernels;
+}
+
+const RowKernels *get_row_kernels(void) {
+    pthread_once(&default_kernels_once, select_default_kernels);
+    return active_kernels;
+}
+
+const char *row_kernel_names(void) {
+#ifdef HAVE_X86_KERNELS
+    return "auto, scalar, sse2, avx2, avx512";
+#else
+    return "auto, scalar";
+#endif
+}
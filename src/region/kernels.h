@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// gather_row() reads up to this many bytes from every source offset, buffers passed to it need that much padding
+#define ROW_GATHER_PADDING 4
+
+// Row kernels used by the region functions, one set per instruction set
+typedef struct RowKernels {
+    const char *name;
+
+    // dst and src must not overlap
+    void (*copy_row)(uint8_t *dst, const uint8_t *src, size_t size);
+    // exchanges the contents of two non-overlapping rows
+    void (*swap_row)(uint8_t *a, uint8_t *b, size_t size);
+    void (*fill_row)(uint8_t *dst, uint8_t value, size_t size);
+    // copies count pixels of step bytes from src + offset[i] to dst + i * step
+    void (*gather_row)(uint8_t *dst, const uint8_t *src, const int32_t *offset, int count, int step);
+} RowKernels;
+
+// "auto" picks the widest set the CPU supports. Returns NULL for unknown names and for sets the CPU cannot run.
+const RowKernels *find_row_kernels(const char *name);
+
+void use_row_kernels(const RowKernels *kernels);
+
+// The kernels selected with use_row_kernels(), defaults to "auto"
+const RowKernels *get_row_kernels(void);
+
+// Comma separated list of all kernel names, for help and error messages
+const char *row_kernel_names(void);
@@ -1,28 +1,42 @@
 #include "region.h"
 #include "cmdline.h"
 #include "video-effects.h"
+#include "kernels.h"
+#include "scale.h"
+#include "stats/stats.h"
 
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <libavutil/common.h>
 
-void push(Regions *region_data, const bool isPair, const unsigned short width, const unsigned short height,
-          const unsigned short start_x1, const unsigned short start_y1, const unsigned short end_x1,
-          const unsigned short end_y1, const unsigned short start_x2, const unsigned short start_y2,
-          const unsigned short end_x2, const unsigned short end_y2) {
-    RegionPair *buffer;
-    if (is_empty(region_data)) {
-        buffer = malloc(sizeof(RegionPair));
-    } else {
-        buffer = realloc(region_data->region_pair, sizeof(RegionPair) * (region_data->size + 1));
-    }
+void reserve_regions(Regions *region_data, const int size) {
+
+    if (size <= region_data->capacity)
+        return;
 
+    int capacity = region_data->capacity > 0 ? region_data->capacity : MIN_REGION_CAPACITY;
+    while (capacity < size)
+        capacity *= 2;
+
+    stats_add_allocation(sizeof(RegionPair) * capacity);
+
+    RegionPair *buffer = realloc(region_data->region_pair, sizeof(RegionPair) * capacity);
     if (buffer == NULL) {
-        fprintf(stderr, "[ERROR] Failed to allocate memory.\n");
-        exit(EXIT_FAILURE);
+        fail_job("Failed to allocate memory.");
     }
 
     region_data->region_pair = buffer;
+    region_data->capacity = capacity;
+}
+
+void push(Regions *region_data, const bool isPair, const unsigned short width, const unsigned short height,
+          const unsigned short start_x1, const unsigned short start_y1, const unsigned short end_x1,
+          const unsigned short end_y1, const unsigned short start_x2, const unsigned short start_y2,
+          const unsigned short end_x2, const unsigned short end_y2) {
+
+    reserve_regions(region_data, region_data->size + 1);
 
     RegionPair *new_pair = &region_data->region_pair[region_data->size];
 
@@ -47,35 +61,24 @@ void push(Regions *region_data, const bool isPair, const unsigned short width, c
         new_pair->one.start.y = start_y1;
         new_pair->one.end.x = end_x1;
         new_pair->one.end.y = end_y1;
+
+        new_pair->two = (Region) { 0 };
     }
 
     region_data->size++;
 }
 
+// the capacity is kept for the next push
 void pop(Regions *region_data) {
     if (is_empty(region_data)) {
-        fprintf(stderr, "[ERROR] No regions to remove.\n");
-        exit(EXIT_FAILURE);
+        fail_job("No regions to remove.");
     }
     region_data->size--;
-
-    if (region_data->size > 0) {
-        RegionPair *buffer = realloc(region_data->region_pair, sizeof(RegionPair) * (region_data->size));
-        if (buffer == NULL) {
-            fprintf(stderr, "[ERROR] Failed to allocate memory.\n");
-            exit(EXIT_FAILURE);
-        }
-        region_data->region_pair = buffer;
-    } else {
-        free(region_data->region_pair);
-        region_data->region_pair = NULL;
-    }
 }
 
 RegionPair* top(const Regions *region_data) {
     if (is_empty(region_data)) {
-        fprintf(stderr, "[ERROR] No regions available.\n");
-        exit(EXIT_FAILURE);
+        fail_job("No regions available.");
     }
 
     return &region_data->region_pair[region_data->size - 1];
@@ -90,161 +93,534 @@ void cleanup_regions(Regions *region_data) {
         free(region_data->region_pair);
         region_data->region_pair = NULL;
         region_data->size = 0;
+        region_data->capacity = 0;
+
+        free(region_data->scaled_pair);
+        region_data->scaled_pair = NULL;
+        region_data->scaled_capacity = 0;
     }
 }
 
-static void allocate_buffer(Config *data, const size_t buffer_size) {
+void copy_regions(Regions *destination, const Regions *source) {
 
-    if (data->buffer == NULL) {
-        data->buffer = malloc(buffer_size);
-    } else {
-        uint8_t *new_buffer = realloc(data->buffer, buffer_size);
-        if (new_buffer == NULL) {
-            fprintf(stderr, "[ERROR] Memory allocation failed\n");
-            exit(EXIT_FAILURE);
+    reserve_regions(destination, source->size);
+    if (!is_empty(source))
+        memcpy(destination->region_pair, source->region_pair, sizeof(RegionPair) * source->size);
+
+    destination->size = source->size;
+    destination->seed = source->seed;
+    destination->frame = source->frame;
+    destination->draw = source->draw;
+}
+
+// the extent is scaled on its own, so regions of the same size stay the same size wherever they start
+static Region scale_region(const Region *region, const int source_width, const int source_height, const int width,
+                           const int height) {
+
+    const int start_x = region->start.x * width / source_width;
+    const int start_y = region->start.y * height / source_height;
+
+    return (Region) {
+        .start = { start_x, start_y },
+        .end = { start_x + (region->end.x - region->start.x) * width / source_width,
+                 start_y + (region->end.y - region->start.y) * height / source_height },
+        .width = region->width * width / source_width,
+        .height = region->height * height / source_height
+    };
+}
+
+void scale_regions(Regions *region_data, const int source_width, const int source_height, const int width,
+                   const int height, Regions *view) {
+
+    if (region_data->size > region_data->scaled_capacity) {
+        RegionPair *buffer = realloc(region_data->scaled_pair, sizeof(RegionPair) * region_data->capacity);
+        if (buffer == NULL) {
+            fail_job("Failed to allocate memory.");
         }
-        data->buffer = new_buffer;
+        stats_add_allocation(sizeof(RegionPair) * region_data->capacity);
+
+        region_data->scaled_pair = buffer;
+        region_data->scaled_capacity = region_data->capacity;
+    }
+
+    for (int i = 0; i < region_data->size; i++) {
+        const RegionPair *pair = &region_data->region_pair[i];
+        region_data->scaled_pair[i] = (RegionPair) {
+            .one = scale_region(&pair->one, source_width, source_height, width, height),
+            .two = scale_region(&pair->two, source_width, source_height, width, height)
+        };
     }
 
+    *view = *region_data;
+    view->region_pair = region_data->scaled_pair;
+    view->capacity = region_data->scaled_capacity;
+    view->scaled_pair = NULL;
+    view->scaled_capacity = 0;
 }
 
-static void copy_region_pixels(uint8_t *buffer, const uint8_t *pixel, const int linesize, const Pixel *region_start,
-                                   const Pixel *region_end) {
+// A failed job may never return to the render stage, so the Config that frees the scratch memory holds it at once
+static Config *get_scratch_owner(Config *data) {
+    return data->scratch_owner != NULL ? data->scratch_owner : data;
+}
 
-    if (buffer == NULL) {
-        fprintf(stderr, "[ERROR] Buffer is NULL\n");
-        exit(EXIT_FAILURE);
-    }
+void reserve_buffer(Config *data, const size_t buffer_size) {
+
+    Config *owner = get_scratch_owner(data);
+
+    if (owner->buffer == NULL || owner->buffer_size < buffer_size) {
+        stats_add_allocation(buffer_size);
 
-    int i = 0;
-    for (unsigned short y = region_start->y; y < region_end->y; y++) {
-        for (unsigned short x = region_start->x; x < region_end->x; x++) {
-            const int offset = (y * linesize) + (x * 3);
-            buffer[i++] = pixel[offset];
-            buffer[i++] = pixel[offset + 1];
-            buffer[i++] = pixel[offset + 2];
+        if (owner->buffer == NULL) {
+            owner->buffer = malloc(buffer_size);
+            NOT_NULL(owner->buffer);
+        } else {
+            uint8_t *new_buffer = realloc(owner->buffer, buffer_size);
+            if (new_buffer == NULL) {
+                fail_job("Memory allocation failed");
+            }
+            owner->buffer = new_buffer;
         }
+
+        owner->buffer_size = buffer_size;
     }
 
+    data->buffer = owner->buffer;
+    data->buffer_size = owner->buffer_size;
 }
 
-void swap_pixels(Config *data, uint8_t *pixel, const int linesize, const Pixel *region1_start, const Pixel *region1_end,
-                 const Pixel *region2_start, const Pixel *region2_end) {
+static ScaleCache *get_scale_cache(Config *data);
 
-    const unsigned short region1_width = region1_end->x - region1_start->x;
-    const unsigned short region1_height = region1_end->y - region1_start->y;
+void reserve_frame_scratch(Config *data, const int width, const int height, const int pixel_step,
+                           const int scratch_per_region, const bool scaled) {
+
+    const int region_width = width * MAX_REGION_PERCENT / 100;
+    const int region_height = height * MAX_REGION_PERCENT / 100;
+
+    if (scratch_per_region > 0)
+        reserve_buffer(data, (size_t) region_width * region_height * pixel_step * scratch_per_region +
+                             ROW_GATHER_PADDING);
 
-    const size_t buffer_size = region1_width * region1_height * 3;
+    if (scaled) {
+        ScaleCache *cache = get_scale_cache(data);
+        cache->table_length = FFMAX(cache->table_length, FFMAX(region_width, region_height));
+    }
+}
+
+static uint8_t *block_row(uint8_t *plane, const int linesize, const int step, const int x, const int y) {
+    return plane + (ptrdiff_t) y * linesize + (ptrdiff_t) x * step;
+}
+
+// One block operation, the *_rows() functions below work on a range of its rows and may run concurrently
+// on disjoint ranges
+typedef struct BlockJob {
+    uint8_t *plane;
+    uint8_t *buffer;
+    int linesize;
+    int step;
+
+    int x;
+    int y;
+    int width;
+    int height;
+
+    // swap partner or move destination
+    int other_x;
+    int other_y;
+
+    // moved part of the block
+    int copy_width;
+    int copy_height;
+    uint8_t black;
+} BlockJob;
+
+static void copy_rows(void *arg, const int first_row, const int last_row) {
+
+    const BlockJob *job = arg;
+    const RowKernels *kernels = get_row_kernels();
+    const size_t row_size = (size_t) job->width * job->step;
+
+    for (int row = first_row; row < last_row; row++)
+        kernels->copy_row(job->buffer + row * row_size,
+                          block_row(job->plane, job->linesize, job->step, job->x, job->y + row), row_size);
+}
 
-    allocate_buffer(data, buffer_size);
+static void copy_block(WorkerPool *pool, uint8_t *buffer, const uint8_t *plane, const int linesize, const int step,
+                       const int x, const int y, const int width, const int height) {
 
-    copy_region_pixels(data->buffer, pixel, linesize, region1_start, region1_end);
+    BlockJob job = {
+        .plane = (uint8_t *) plane, .buffer = buffer, .linesize = linesize, .step = step,
+        .x = x, .y = y, .width = width, .height = height
+    };
 
-    // Swap the pixels between the two regions
-    for (unsigned short y = region1_start->y; y < region1_end->y; y++) {
-        const unsigned short rel_pos_y = y - region1_start->y;
-        for (unsigned short x = region1_start->x; x < region1_end->x; x++) {
-            const unsigned short rel_pos_x = x - region1_start->x;
+    pool_run_bands(pool, copy_rows, &job, height, (size_t) width * step);
+}
+
+static void swap_rows(void *arg, const int first_row, const int last_row) {
+
+    const BlockJob *job = arg;
+    const RowKernels *kernels = get_row_kernels();
+    const size_t row_size = (size_t) job->width * job->step;
+
+    for (int row = first_row; row < last_row; row++)
+        kernels->swap_row(block_row(job->plane, job->linesize, job->step, job->x, job->y + row),
+                          block_row(job->plane, job->linesize, job->step, job->other_x, job->other_y + row),
+                          row_size);
+}
+
+// The blocks must not overlap, rows are exchanged in place without a scratch copy
+static void swap_block(WorkerPool *pool, uint8_t *plane, const int linesize, const int step, const int x1,
+                       const int y1, const int x2, const int y2, const int width, const int height) {
+
+    BlockJob job = {
+        .plane = plane, .linesize = linesize, .step = step,
+        .x = x1, .y = y1, .width = width, .height = height, .other_x = x2, .other_y = y2
+    };
+
+    pool_run_bands(pool, swap_rows, &job, height, (size_t) width * step);
+}
+
+static void fill_block_row(uint8_t *plane, const int linesize, const int step, const int start_x, const int end_x,
+                           const int y, const uint8_t black) {
+    if (start_x < end_x)
+        get_row_kernels()->fill_row(block_row(plane, linesize, step, start_x, y), black,
+                                    (size_t) (end_x - start_x) * step);
+}
 
-            const int offset_region1 = (y * linesize) + (x * 3);
-            const int offset_region2 = ((region2_start->y + rel_pos_y) * linesize) + (
-                                           (region2_start->x + rel_pos_x) * 3);
+static void move_row(const BlockJob *job, const int row) {
 
-            pixel[offset_region1] = pixel[offset_region2];
-            pixel[offset_region1 + 1] = pixel[offset_region2 + 1];
-            pixel[offset_region1 + 2] = pixel[offset_region2 + 2];
+    uint8_t *destination = block_row(job->plane, job->linesize, job->step, job->other_x, job->other_y + row);
+    const uint8_t *source = block_row(job->plane, job->linesize, job->step, job->x, job->y + row);
+    const size_t row_size = (size_t) job->copy_width * job->step;
+
+    if (job->other_y == job->y)
+        memmove(destination, source, row_size);
+    else
+        get_row_kernels()->copy_row(destination, source, row_size);
+}
+
+// only used when no row of the destination is read by another row
+static void move_rows(void *arg, const int first_row, const int last_row) {
+    for (int row = first_row; row < last_row; row++)
+        move_row(arg, row);
+}
+
+// black out the part of the block the destination does not cover
+static void blackout_rows(void *arg, const int first_row, const int last_row) {
+
+    const BlockJob *job = arg;
+    const int x = job->x;
+    const int width = job->width;
+
+    for (int row = job->y + first_row; row < job->y + last_row; row++) {
+        if (row < job->other_y || row >= job->other_y + job->copy_height) {
+            fill_block_row(job->plane, job->linesize, job->step, x, x + width, row, job->black);
+            continue;
         }
+
+        const int covered_start = FFMAX(x, job->other_x);
+        const int covered_end = FFMIN(x + width, job->other_x + job->copy_width);
+
+        if (covered_start >= covered_end) {
+            fill_block_row(job->plane, job->linesize, job->step, x, x + width, row, job->black);
+        } else {
+            fill_block_row(job->plane, job->linesize, job->step, x, covered_start, row, job->black);
+            fill_block_row(job->plane, job->linesize, job->step, covered_end, x + width, row, job->black);
+        }
+    }
+}
+
+// Copies the top left copy_width x copy_height pixels of the block to the destination and fills the rest of the
+// block with black. Rows are copied in an order that never overwrites a row that still has to be read, so block
+// and destination may overlap and no scratch copy is needed. The rows are only split into bands when that order
+// does not matter, i.e. for horizontal moves and when block and destination are disjoint.
+static void move_block(WorkerPool *pool, uint8_t *plane, const int linesize, const int step, const int x,
+                       const int y, const int width, const int height, const int destination_x,
+                       const int destination_y, const int copy_width, const int copy_height, const uint8_t black) {
+
+    BlockJob job = {
+        .plane = plane, .linesize = linesize, .step = step,
+        .x = x, .y = y, .width = width, .height = height, .other_x = destination_x, .other_y = destination_y,
+        .copy_width = copy_width, .copy_height = copy_height, .black = black
+    };
+
+    const int move_y = destination_y - y;
+    const bool disjoint = destination_x >= x + width || destination_x + copy_width <= x ||
+                          destination_y >= y + height || destination_y + copy_height <= y;
+
+    if (move_y == 0 || disjoint) {
+        pool_run_bands(pool, move_rows, &job, copy_height, (size_t) copy_width * step);
+    } else {
+        for (int i = 0; i < copy_height; i++)
+            move_row(&job, move_y > 0 ? copy_height - 1 - i : i);
     }
 
-    int i = 0;
+    pool_run_bands(pool, blackout_rows, &job, height, (size_t) width * step);
+}
+
+void copy_region_pixels(WorkerPool *pool, uint8_t *buffer, const uint8_t *pixel, const int linesize,
+                        const int pixel_step, const Pixel *region_start, const Pixel *region_end) {
+
+    if (buffer == NULL) {
+        fail_job("Buffer is NULL");
+    }
+
+    copy_block(pool, buffer, pixel, linesize, pixel_step, region_start->x, region_start->y,
+               region_end->x - region_start->x, region_end->y - region_start->y);
+
+}
+
+void swap_pixels(Config *data, uint8_t *pixel, const int linesize, const int pixel_step, const Pixel *region1_start,
+                 const Pixel *region1_end, const Pixel *region2_start, const Pixel *region2_end) {
+
+    const int64_t start = stats_start();
+
+    const unsigned short region1_width = region1_end->x - region1_start->x;
+    const unsigned short region1_height = region1_end->y - region1_start->y;
+
+    // randomize() never creates overlapping pairs, so the regions are swapped row by row in place
+    swap_block(data->pool, pixel, linesize, pixel_step, region1_start->x, region1_start->y,
+               region2_start->x, region2_start->y, region1_width, region1_height);
 
-    // Write the pixel data from the buffer back to the second region
-    for (unsigned short y = region2_start->y; y < region2_end->y; y++) {
-        for (unsigned short x = region2_start->x; x < region2_end->x; x++) {
-            const int offset = (y * linesize) + (x * 3);
+    stats_stop(STATS_REGION_SWAP, start);
 
-            pixel[offset] = data->buffer[i++];
-            pixel[offset + 1] = data->buffer[i++];
-            pixel[offset + 2] = data->buffer[i++];
+}
+
+static ScaleCache *get_scale_cache(Config *data) {
+
+    Config *owner = get_scratch_owner(data);
+
+    if (owner->scale_cache == NULL) {
+        owner->scale_cache = calloc(1, sizeof(ScaleCache));
+        if (owner->scale_cache == NULL) {
+            fail_job("Memory allocation failed");
         }
     }
 
+    data->scale_cache = owner->scale_cache;
+    return data->scale_cache;
 }
 
 // Nearest Neighbor Interpolation, algorithm from https://kwojcicki.github.io/blog/NEAREST-NEIGHBOUR
-void scale_pixels(Config *data, uint8_t *pixel, int linesize, const float scale_factor, const Pixel *region_start,
-                  const Pixel *region_end) {
+// The source positions come from tables cached per region size, see scale.c
+void scale_pixels(Config *data, uint8_t *pixel, int linesize, const int pixel_step, const float scale_factor,
+                  const Pixel *region_start, const Pixel *region_end) {
 
-    const float scale_ratio = 1.0f / scale_factor;
+    const int64_t start = stats_start();
 
     const int region_width = region_end->x - region_start->x;
     const int region_height = region_end->y - region_start->y;
 
-    const size_t buffer_size = region_width * region_height * 3;
+    const size_t buffer_size = (size_t) region_width * region_height * pixel_step + ROW_GATHER_PADDING;
 
-    allocate_buffer(data, buffer_size);
+    reserve_buffer(data, buffer_size);
 
-    copy_region_pixels(data->buffer, pixel, linesize, region_start, region_end);
+    copy_region_pixels(data->pool, data->buffer, pixel, linesize, pixel_step, region_start, region_end);
 
-    for (unsigned short y = region_start->y; y < region_end->y; y++) {
-        for (unsigned short x = region_start->x; x < region_end->x; x++) {
-            // Calculate the position of the pixel in the original region
-            // (x - region_start->x) = the relative position of the pixel in the region
-            // scale_ratio = inverse of the scale factor
-            const int source_x = (int) roundf((x - region_start->x) * scale_ratio);
-            const int source_y = (int) roundf((y - region_start->y) * scale_ratio);
+    scale_block(get_scale_cache(data), data->pool, data->scale_filter, scale_factor, data->buffer, pixel, linesize,
+                pixel_step, region_start->x, region_start->y, region_width, region_height);
 
-            if (source_x < region_width && source_y < region_height) {
-                const int buff_offset = (source_y * region_width + source_x) * 3;
-                const int dest_offset = (y * linesize) + (x * 3);
+    stats_stop(STATS_REGION_SCALE, start);
 
-                pixel[dest_offset] = data->buffer[buff_offset];
-                pixel[dest_offset + 1] = data->buffer[buff_offset + 1];
-                pixel[dest_offset + 2] = data->buffer[buff_offset + 2];
+}
 
-            }
+void move_pixels(Config *data, uint8_t *pixel, int linesize, const int pixel_step, const Pixel *region_start,
+                 const Pixel *region_end, const Pixel *destination_start) {
+
+    const int64_t start = stats_start();
+
+    const int region_width = region_end->x - region_start->x;
+    const int region_height = region_end->y - region_start->y;
+
+    move_block(data->pool, pixel, linesize, pixel_step, region_start->x, region_start->y, region_width, region_height,
+               destination_start->x, destination_start->y, region_width, region_height, 0);
+
+    stats_stop(STATS_REGION_MOVE, start);
+
+}
+
+// Maps a region in luma coordinates onto a (possibly subsampled) plane, partially covered chroma samples are
+// included so the plane region always covers the luma region
+static void map_plane_region(const PlanarImage *image, const ImagePlane *plane, const Pixel *region_start,
+                             const Pixel *region_end, PlaneRegion *mapped) {
+
+    const int plane_width = (image->width + (1 << plane->shift_x) - 1) >> plane->shift_x;
+    const int plane_height = (image->height + (1 << plane->shift_y) - 1) >> plane->shift_y;
+
+    mapped->x = region_start->x >> plane->shift_x;
+    mapped->y = region_start->y >> plane->shift_y;
+    mapped->width = FFMIN((region_end->x + (1 << plane->shift_x) - 1) >> plane->shift_x, plane_width) - mapped->x;
+    mapped->height = FFMIN((region_end->y + (1 << plane->shift_y) - 1) >> plane->shift_y, plane_height) - mapped->y;
+    mapped->plane_width = plane_width;
+    mapped->plane_height = plane_height;
+}
+
+static uint8_t *plane_pixel(const ImagePlane *plane, const int x, const int y) {
+    return plane->data + (ptrdiff_t) y * plane->linesize + x * plane->pixel_step;
+}
+
+static void copy_plane_region(WorkerPool *pool, uint8_t *buffer, const ImagePlane *plane,
+                              const PlaneRegion *region) {
+    copy_block(pool, buffer, plane->data, plane->linesize, plane->pixel_step, region->x, region->y, region->width,
+               region->height);
+}
+
+void swap_pixels_planar(Config *data, const PlanarImage *image, const Pixel *region1_start,
+                        const Pixel *region1_end, const Pixel *region2_start, const Pixel *region2_end) {
+
+    const int64_t start = stats_start();
+
+    for (int i = 0; i < image->plane_count; i++) {
+        const ImagePlane *plane = &image->plane[i];
+
+        PlaneRegion region1, region2;
+        map_plane_region(image, plane, region1_start, region1_end, &region1);
+        map_plane_region(image, plane, region2_start, region2_end, &region2);
+
+        // rounding at the edges can make the mapped regions differ by one sample
+        const int width = FFMIN(region1.width, region2.width);
+        const int height = FFMIN(region1.height, region2.height);
+
+        if (width <= 0 || height <= 0)
+            continue;
+
+        const bool overlapping = region1.x < region2.x + width && region2.x < region1.x + width &&
+                                 region1.y < region2.y + height && region2.y < region1.y + height;
+
+        if (!overlapping) {
+            swap_block(data->pool, plane->data, plane->linesize, plane->pixel_step, region1.x, region1.y,
+                       region2.x, region2.y, width, height);
+            continue;
         }
+
+        // rounding chroma outward can make regions that only touch in luma share samples, swap through the buffer
+        const size_t row_size = (size_t) width * plane->pixel_step;
+
+        reserve_buffer(data, row_size * height);
+
+        copy_block(data->pool, data->buffer, plane->data, plane->linesize, plane->pixel_step, region1.x, region1.y,
+                   width, height);
+
+        for (int y = 0; y < height; y++)
+            memmove(plane_pixel(plane, region1.x, region1.y + y), plane_pixel(plane, region2.x, region2.y + y),
+                    row_size);
+
+        for (int y = 0; y < height; y++)
+            memcpy(plane_pixel(plane, region2.x, region2.y + y), data->buffer + y * row_size, row_size);
     }
 
+    stats_stop(STATS_REGION_SWAP, start);
+
 }
 
-void move_pixels(Config *data, uint8_t *pixel, int linesize, const int width, const int height, const Pixel *region_start, const Pixel *region_end) {
+void scale_pixels_planar(Config *data, const PlanarImage *image, const float scale_factor,
+                         const Pixel *region_start, const Pixel *region_end) {
 
-    const int region_width = region_end->x - region_start->x;
-    const int region_height = region_end->y - region_start->y;
+    const int64_t start = stats_start();
+
+    for (int i = 0; i < image->plane_count; i++) {
+        const ImagePlane *plane = &image->plane[i];
+        const int step = plane->pixel_step;
 
-    int move_x, move_y;
-    get_random_move_val(&move_x, &move_y);
+        PlaneRegion region;
+        map_plane_region(image, plane, region_start, region_end, &region);
 
-    const int new_start_x = region_start->x + move_x;
-    const int new_start_y = region_start->y + move_y;
-    const int new_end_x = region_end->x + move_x;
-    const int new_end_y = region_end->y + move_y;
+        if (region.width <= 0 || region.height <= 0)
+            continue;
 
-    if (new_start_x < 0 || new_start_y < 0 || new_end_x > width || new_end_y > height)
+        reserve_buffer(data, (size_t) region.width * region.height * step + ROW_GATHER_PADDING);
+
+        copy_plane_region(data->pool, data->buffer, plane, &region);
+
+        // same as scale_pixels() but on the plane resolution
+        scale_block(get_scale_cache(data), data->pool, data->scale_filter, scale_factor, data->buffer, plane->data,
+                    plane->linesize, step, region.x, region.y, region.width, region.height);
+    }
+
+    stats_stop(STATS_REGION_SCALE, start);
+
+}
+
+void move_pixels_planar(Config *data, const PlanarImage *image, const Pixel *region_start,
+                        const Pixel *region_end, const Pixel *destination_start) {
+
+    const int64_t start = stats_start();
+
+    for (int i = 0; i < image->plane_count; i++) {
+        const ImagePlane *plane = &image->plane[i];
+
+        PlaneRegion region;
+        map_plane_region(image, plane, region_start, region_end, &region);
+
+        const int new_x = destination_start->x >> plane->shift_x;
+        const int new_y = destination_start->y >> plane->shift_y;
+        const int width = FFMIN(region.width, region.plane_width - new_x);
+        const int height = FFMIN(region.height, region.plane_height - new_y);
+
+        if (width <= 0 || height <= 0)
+            continue;
+
+        move_block(data->pool, plane->data, plane->linesize, plane->pixel_step, region.x, region.y,
+                   region.width, region.height, new_x, new_y, width, height, plane->black);
+    }
+
+    stats_stop(STATS_REGION_MOVE, start);
+
+}
+
+static void add_dirty_region(DirtyRegions *dirty, const Region *region, const int align_x, const int align_y,
+                             const int width, const int height) {
+
+    int start_x = region->start.x & ~(align_x - 1);
+    int start_y = region->start.y & ~(align_y - 1);
+    int end_x = FFMIN((region->end.x + align_x - 1) & ~(align_x - 1), width);
+    int end_y = FFMIN((region->end.y + align_y - 1) & ~(align_y - 1), height);
+
+    if (start_x >= end_x || start_y >= end_y)
         return;
 
-    const size_t buffer_size = region_width * region_height * 3;
+    // merge with every intersecting region, the grown region may now intersect others
+    for (int i = 0; i < dirty->size; i++) {
+        const Region *current = &dirty->region[i];
+        const bool full = dirty->size == MAX_DIRTY_REGIONS && i == dirty->size - 1;
 
-    allocate_buffer(data, buffer_size);
+        if (!full && (end_x <= current->start.x || current->end.x <= start_x || end_y <= current->start.y ||
+                      current->end.y <= start_y))
+            continue;
 
-    copy_region_pixels(data->buffer, pixel, linesize, region_start, region_end);
+        start_x = FFMIN(start_x, current->start.x);
+        start_y = FFMIN(start_y, current->start.y);
+        end_x = FFMAX(end_x, current->end.x);
+        end_y = FFMAX(end_y, current->end.y);
 
-    for (unsigned short y = region_start->y; y < region_end->y; y++) {
-        for (unsigned short x = region_start->x; x < region_end->x; x++) {
-            const int offset = (y * linesize) + (x * 3);
-            set_rgb_value(pixel, offset, 0, true, 0, true, 0, true);
-        }
+        dirty->region[i] = dirty->region[--dirty->size];
+        i = -1;
     }
 
-    int i = 0;
-    for (int y = new_start_y; y < new_end_y; y++) {
-        for (int x = new_start_x; x < new_end_x; x++) {
-            const int offset = (y * linesize) + (x * 3);
-            pixel[offset] = data->buffer[i++];
-            pixel[offset + 1] = data->buffer[i++];
-            pixel[offset + 2] = data->buffer[i++];
-        }
+    Region *merged = &dirty->region[dirty->size++];
+    merged->start.x = start_x;
+    merged->start.y = start_y;
+    merged->end.x = end_x;
+    merged->end.y = end_y;
+    merged->width = end_x - start_x;
+    merged->height = end_y - start_y;
+}
+
+void collect_dirty_regions(const Regions *region_data, const int align_x, const int align_y, const int width,
+                           const int height, DirtyRegions *dirty) {
+
+    dirty->size = 0;
+    add_dirty_regions(region_data, align_x, align_y, width, height, dirty);
+}
+
+void add_dirty_regions(const Regions *region_data, const int align_x, const int align_y, const int width,
+                       const int height, DirtyRegions *dirty) {
+
+    for (int i = 0; i < region_data->size; i++) {
+        const RegionPair *current = &region_data->region_pair[i];
+
+        add_dirty_region(dirty, &current->one, align_x, align_y, width, height);
+        if (current->two.width > 0 && current->two.height > 0)
+            add_dirty_region(dirty, &current->two, align_x, align_y, width, height);
     }
 
 }
@@ -259,17 +635,37 @@ static bool overlap(const unsigned short start_x1, const unsigned short start_y1
     return true;
 }
 
-static void get_random_move_val(int *move_x, int *move_y) {
+// splitmix64 finalizer
+static uint64_t mix_bits(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+int random_value(const unsigned int seed, const int frame, const unsigned int draw) {
+    const uint64_t key = mix_bits(((uint64_t) seed << 32 | (uint32_t) frame) + 0x9e3779b97f4a7c15ULL);
+    return (int) (mix_bits(key + (uint64_t) (draw + 1) * 0x9e3779b97f4a7c15ULL) >> 33);
+}
+
+// The n-th decision of a frame only depends on the seed, the frame index and n, not on earlier frames
+static int next_random(Regions *region_data) {
+    return random_value(region_data->seed, region_data->frame, region_data->draw++);
+}
+
+void get_random_move_val(Regions *region_data, int *move_x, int *move_y) {
     // between -100 and +100 pixels
-    *move_x = (rand() % 201) - 100;
-    *move_y = (rand() % 201) - 100;
+    *move_x = (next_random(region_data) % 201) - 100;
+    *move_y = (next_random(region_data) % 201) - 100;
 }
 
-static void get_random_dimensions(const int width, const int height, unsigned short *region_width,
-                                         unsigned short *region_height) {
-    // between 10% and 30% of the image
-    *region_width = (width * (10 + (rand() % 20))) / 100;
-    *region_height = (height * (10 + (rand() % 20))) / 100;
+static void get_random_dimensions(Regions *region_data, const int width, const int height,
+                                  unsigned short *region_width, unsigned short *region_height) {
+    // between 10% and 30% of the image, see MAX_REGION_PERCENT
+    *region_width = (width * (10 + (next_random(region_data) % 20))) / 100;
+    *region_height = (height * (10 + (next_random(region_data) % 20))) / 100;
 }
 
 static void select_random_operation(Regions *region_data, bool isPair, unsigned short region_width,
@@ -277,7 +673,7 @@ static void select_random_operation(Regions *region_data, bool isPair, unsigned
                                     unsigned short start_y1, unsigned short end_x1, unsigned short end_y1,
                                     unsigned short start_x2, unsigned short start_y2, unsigned short end_x2,
                                     unsigned short end_y2) {
-    const int i = rand() % 3;
+    const int i = next_random(region_data) % 3;
     switch (i) {
         case 0:
             if (!isPair) {
@@ -300,10 +696,10 @@ static void select_random_operation(Regions *region_data, bool isPair, unsigned
 void randomize_single_region(Regions *region_data, const int width, const int height) {
 
     unsigned short region_width, region_height;
-    get_random_dimensions(width, height, &region_width, &region_height);
+    get_random_dimensions(region_data, width, height, &region_width, &region_height);
 
-    const unsigned short start_x1 = rand() % width;
-    const unsigned short start_y1 = rand() % height;
+    const unsigned short start_x1 = next_random(region_data) % width;
+    const unsigned short start_y1 = next_random(region_data) % height;
     const unsigned short end_x1 = fmin(start_x1 + region_width, width);
     const unsigned short end_y1 = fmin(start_y1 + region_height, height);
 
@@ -312,21 +708,49 @@ void randomize_single_region(Regions *region_data, const int width, const int he
 
 }
 
+void randomize_moves(Regions *region_data, const int width, const int height) {
+
+    for (int i = 0; i < region_data->size; i++) {
+        RegionPair *current = &region_data->region_pair[i];
+
+        int move_x, move_y;
+        get_random_move_val(region_data, &move_x, &move_y);
+
+        const int new_start_x = current->one.start.x + move_x;
+        const int new_start_y = current->one.start.y + move_y;
+        const int new_end_x = current->one.end.x + move_x;
+        const int new_end_y = current->one.end.y + move_y;
+
+        if (new_start_x < 0 || new_start_y < 0 || new_end_x > width || new_end_y > height) {
+            current->two = (Region) { 0 };
+            continue;
+        }
+
+        current->two.start.x = new_start_x;
+        current->two.start.y = new_start_y;
+        current->two.end.x = new_end_x;
+        current->two.end.y = new_end_y;
+        current->two.width = new_end_x - new_start_x;
+        current->two.height = new_end_y - new_start_y;
+    }
+
+}
+
 void randomize(Regions *region_data, const int width, const int height) {
 
     unsigned short region_width, region_height;
-    get_random_dimensions(width, height, &region_width, &region_height);
+    get_random_dimensions(region_data, width, height, &region_width, &region_height);
 
     unsigned short start_x1, start_y1, end_x1, end_y1, start_x2, start_y2, end_x2, end_y2;
 
     do {
-        start_x1 = rand() % (width - region_width);
-        start_y1 = rand() % (height - region_height);
+        start_x1 = next_random(region_data) % (width - region_width);
+        start_y1 = next_random(region_data) % (height - region_height);
         end_x1 = start_x1 + region_width;
         end_y1 = start_y1 + region_height;
 
-        start_x2 = rand() % (width - region_width);
-        start_y2 = rand() % (height - region_height);
+        start_x2 = next_random(region_data) % (width - region_width);
+        start_y2 = next_random(region_data) % (height - region_height);
         end_x2 = start_x2 + region_width;
         end_y2 = start_y2 + region_height;
     } while (overlap(start_x1, start_y1, end_x1, end_y1, start_x2, start_y2, end_x2, end_y2));
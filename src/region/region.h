@@ -5,6 +5,7 @@
 #include <stdint.h>
 
 typedef struct Config Config;
+typedef struct WorkerPool WorkerPool;
 
 typedef struct Pixel {
     unsigned short x;
@@ -23,12 +24,61 @@ typedef struct RegionPair {
     Region two;
 } RegionPair;
 
+// One plane of a frame in its native layout, regions are given in luma coordinates and mapped onto
+// subsampled planes with shift_x/shift_y
+typedef struct ImagePlane {
+    uint8_t *data;
+    int linesize;
+    int pixel_step;
+    int shift_x;
+    int shift_y;
+    uint8_t black;
+} ImagePlane;
+
+typedef struct PlanarImage {
+    ImagePlane plane[3];
+    int plane_count;
+    int width;
+    int height;
+} PlanarImage;
+
+typedef struct PlaneRegion {
+    int x;
+    int y;
+    int width;
+    int height;
+    int plane_width;
+    int plane_height;
+} PlaneRegion;
+
+// frame and draw select the next random value together with the seed, see random_value()
 typedef struct Regions {
     RegionPair *region_pair;
     int size;
+    // pairs region_pair has room for, it only grows
+    int capacity;
+    unsigned int seed;
+    int frame;
+    unsigned int draw;
+    // the stack mapped onto smaller frames by scale_regions(), owned like region_pair
+    RegionPair *scaled_pair;
+    int scaled_capacity;
 } Regions;
 
+#define MAX_DIRTY_REGIONS 32
+
+// Areas of a frame the effects read or write, overlapping areas are merged into their bounding box
+typedef struct DirtyRegions {
+    Region region[MAX_DIRTY_REGIONS];
+    int size;
+} DirtyRegions;
+
+// First capacity of a region stack, it doubles from there
+#define MIN_REGION_CAPACITY 16
+
 // Region management functions
+void reserve_regions(Regions *region_data, int size);
+
 void push(Regions *region_data, const bool isPair, unsigned short width, unsigned short height,
     unsigned short start_x1, unsigned short start_y1, unsigned short end_x1, unsigned short end_y1,
     unsigned short start_x2, unsigned short start_y2, unsigned short end_x2, unsigned short end_y2);
@@ -41,27 +91,67 @@ bool is_empty(const Regions *region_data);
 
 void cleanup_regions(Regions *region_data);
 
-static void allocate_buffer(Config *data, const size_t buffer_size);
-static void copy_region_pixels(uint8_t *buffer, const uint8_t *pixel, const int linesize, const Pixel *region_start,
-                                   const Pixel *region_end);
+// Deep copy including the generator state, destination must be initialized
+void copy_regions(Regions *destination, const Regions *source);
+
+// Maps the stack planned for a source_width x source_height frame onto a width x height frame, see --preview-scale.
+// view points at memory of region_data that is reused by the next call. Swap partners and move destinations keep
+// the size of their region.
+void scale_regions(Regions *region_data, int source_width, int source_height, int width, int height, Regions *view);
+
+// Grows the scratch buffer data->buffer to at least buffer_size bytes, it never shrinks
+void reserve_buffer(Config *data, size_t buffer_size);
+
+// Random regions cover less than this share of the frame width and height
+#define MAX_REGION_PERCENT 30
+
+// Sizes the scratch buffer and the scale tables of a worker for the largest random region of its frames up front,
+// so that processing the frames does not allocate
+void reserve_frame_scratch(Config *data, int width, int height, int pixel_step, int scratch_per_region, bool scaled);
 
-// Region manipulation functions
-void swap_pixels(Config* data, uint8_t *pixel, int linesize, const Pixel *region1_start, const Pixel *region1_end,
-    const Pixel *region2_start, const Pixel *region2_end);
+// Copies a region of a packed frame into buffer, row after row without padding
+void copy_region_pixels(WorkerPool *pool, uint8_t *buffer, const uint8_t *pixel, const int linesize,
+                        const int pixel_step, const Pixel *region_start, const Pixel *region_end);
 
-void scale_pixels(Config *data, uint8_t *pixel, int linesize, const float scale_factor, const Pixel *region_start,
-                  const Pixel *region_end);
+// Region manipulation functions on packed RGB frames, pixel_step is 3 for RGB24 and 4 for RGB0
+void swap_pixels(Config* data, uint8_t *pixel, int linesize, int pixel_step, const Pixel *region1_start,
+    const Pixel *region1_end, const Pixel *region2_start, const Pixel *region2_end);
 
-void move_pixels(Config *data, uint8_t *pixel, int linesize, const int width, const int height,
-                 const Pixel *region_start, const Pixel *region_end);
+void scale_pixels(Config *data, uint8_t *pixel, int linesize, int pixel_step, const float scale_factor,
+                  const Pixel *region_start, const Pixel *region_end);
+
+void move_pixels(Config *data, uint8_t *pixel, int linesize, int pixel_step, const Pixel *region_start,
+                 const Pixel *region_end, const Pixel *destination_start);
+
+// Region manipulation functions working directly on planar YUV frames
+void swap_pixels_planar(Config *data, const PlanarImage *image, const Pixel *region1_start,
+                        const Pixel *region1_end, const Pixel *region2_start, const Pixel *region2_end);
+
+void scale_pixels_planar(Config *data, const PlanarImage *image, const float scale_factor,
+                         const Pixel *region_start, const Pixel *region_end);
+
+void move_pixels_planar(Config *data, const PlanarImage *image, const Pixel *region_start,
+                        const Pixel *region_end, const Pixel *destination_start);
+
+// Union of all regions on the stack, including swap partners and move destinations. The result is aligned to
+// multiples of align_x/align_y (powers of two) and clipped to the frame.
+void collect_dirty_regions(const Regions *region_data, int align_x, int align_y, int width, int height,
+                           DirtyRegions *dirty);
+
+// Like collect_dirty_regions(), but merges the regions into the ones already collected, e.g. of another stack
+void add_dirty_regions(const Regions *region_data, int align_x, int align_y, int width, int height,
+                       DirtyRegions *dirty);
 
 static bool overlap(unsigned short start_x1, unsigned short start_y1, unsigned short end_x1, unsigned short end_y1,
     unsigned short start_x2, unsigned short start_y2, unsigned short end_x2, unsigned short end_y2);
 
-static void get_random_move_val(int *move_x, int *move_y);
+// Stateless generator, the value only depends on its arguments. Returns 31 bits like rand().
+int random_value(unsigned int seed, int frame, unsigned int draw);
 
-static void get_random_dimensions(const int width, const int height, unsigned short *region_width,
-                                         unsigned short *region_height);
+void get_random_move_val(Regions *region_data, int *move_x, int *move_y);
+
+static void get_random_dimensions(Regions *region_data, const int width, const int height,
+                                  unsigned short *region_width, unsigned short *region_height);
 
 static void select_random_operation(Regions *region_data, bool isPair, unsigned short region_width,
                                     unsigned short region_height, unsigned short start_x1,
@@ -71,4 +161,7 @@ static void select_random_operation(Regions *region_data, bool isPair, unsigned
 
 void randomize(Regions *region_data, int width, int height);
 
+// Draws a move for every region on the stack and stores its destination in the second region of the pair
+void randomize_moves(Regions *region_data, const int width, const int height);
+
 void randomize_single_region(Regions *region_data, const int width, const int height);
\ No newline at end of file
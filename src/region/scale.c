@@ -0,0 +1,199 @@
+#include "scale.h"
+#include "kernels.h"
+#include "video-effects.h"
+#include "stats/stats.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <libavutil/common.h>
+
+bool parse_scale_filter(const char *name, ScaleFilter *filter) {
+
+    if (strcmp(name, "nearest") == 0) {
+        *filter = SCALE_NEAREST;
+        return true;
+    }
+    if (strcmp(name, "bilinear") == 0) {
+        *filter = SCALE_BILINEAR;
+        return true;
+    }
+
+    return false;
+}
+
+const char *get_scale_filter_name(const ScaleFilter filter) {
+    return filter == SCALE_BILINEAR ? "bilinear" : "nearest";
+}
+
+static void *allocate_table(const size_t size) {
+
+    stats_add_allocation(size);
+
+    void *table = malloc(size);
+    if (table == NULL) {
+        fail_job("Memory allocation failed");
+    }
+
+    return table;
+}
+
+static void free_scale_axis(ScaleAxis *axis) {
+    free(axis->offset);
+    free(axis->next_offset);
+    free(axis->weight);
+    memset(axis, 0, sizeof(ScaleAxis));
+}
+
+// An evicted axis keeps its tables for the next size if they are long enough
+static void reserve_scale_axis(ScaleAxis *axis, const int length) {
+
+    if (axis->capacity >= length)
+        return;
+
+    free_scale_axis(axis);
+    axis->offset = allocate_table(sizeof(int32_t) * length);
+    axis->next_offset = allocate_table(sizeof(int32_t) * length);
+    axis->weight = allocate_table(sizeof(uint16_t) * length);
+    axis->capacity = length;
+}
+
+void free_scale_cache(ScaleCache *cache) {
+
+    if (cache == NULL)
+        return;
+
+    for (int i = 0; i < SCALE_CACHE_SIZE; i++)
+        free_scale_axis(&cache->axis[i]);
+
+    free(cache);
+}
+
+static void build_scale_axis(ScaleAxis *axis, const int length, const int step, const float scale_factor,
+                             const ScaleFilter filter) {
+
+    const float scale_ratio = 1.0f / scale_factor;
+
+    axis->length = length;
+    axis->step = step;
+    axis->scale_factor = scale_factor;
+    axis->filter = filter;
+    axis->valid = 0;
+
+    if (filter == SCALE_NEAREST) {
+        // same rounding as the per pixel roundf() the scaling used before, so the output does not change
+        for (int i = 0; i < length; i++) {
+            const int source = (int) roundf(i * scale_ratio);
+            if (source >= length)
+                break;
+            axis->offset[i] = source * step;
+            axis->valid = i + 1;
+        }
+        return;
+    }
+
+    for (int i = 0; i < length; i++) {
+        const float position = i * scale_ratio;
+        const int source = (int) floorf(position);
+        if (source >= length)
+            break;
+        axis->offset[i] = source * step;
+        axis->next_offset[i] = FFMIN(source + 1, length - 1) * step;
+        axis->weight[i] = (uint16_t) lrintf((position - source) * 256.0f);
+        axis->valid = i + 1;
+    }
+}
+
+// keep is never evicted, so the axis looked up first stays valid while the second one is built
+static const ScaleAxis *get_scale_axis(ScaleCache *cache, const int length, const int step,
+                                       const float scale_factor, const ScaleFilter filter, const ScaleAxis *keep) {
+
+    for (int i = 0; i < SCALE_CACHE_SIZE; i++) {
+        const ScaleAxis *axis = &cache->axis[i];
+        if (axis->offset != NULL && axis->length == length && axis->step == step &&
+            axis->scale_factor == scale_factor && axis->filter == filter)
+            return axis;
+    }
+
+    if (&cache->axis[cache->next] == keep)
+        cache->next = (cache->next + 1) % SCALE_CACHE_SIZE;
+
+    ScaleAxis *axis = &cache->axis[cache->next];
+    cache->next = (cache->next + 1) % SCALE_CACHE_SIZE;
+
+    reserve_scale_axis(axis, FFMAX(length, cache->table_length));
+    build_scale_axis(axis, length, step, scale_factor, filter);
+
+    return axis;
+}
+
+typedef struct ScaleJob {
+    const ScaleAxis *x_axis;
+    const ScaleAxis *y_axis;
+    ScaleFilter filter;
+    const uint8_t *buffer;
+    uint8_t *block;
+    int linesize;
+    int step;
+} ScaleJob;
+
+// 8.8 fixed point, horizontal first, then vertical with rounding
+static void scale_row_bilinear(const ScaleJob *job, const int row) {
+
+    const ScaleAxis *x_axis = job->x_axis;
+    const ScaleAxis *y_axis = job->y_axis;
+    const int step = job->step;
+
+    const uint8_t *top = job->buffer + y_axis->offset[row];
+    const uint8_t *bottom = job->buffer + y_axis->next_offset[row];
+    const int weight_y = y_axis->weight[row];
+    uint8_t *out = job->block + (ptrdiff_t) row * job->linesize;
+
+    for (int column = 0; column < x_axis->valid; column++) {
+        const int left = x_axis->offset[column];
+        const int right = x_axis->next_offset[column];
+        const int weight_x = x_axis->weight[column];
+
+        for (int c = 0; c < step; c++) {
+            const int upper = top[left + c] * (256 - weight_x) + top[right + c] * weight_x;
+            const int lower = bottom[left + c] * (256 - weight_x) + bottom[right + c] * weight_x;
+            out[column * step + c] = (uint8_t) ((upper * (256 - weight_y) + lower * weight_y + 32768) >> 16);
+        }
+    }
+}
+
+// every destination row only reads the copied region, so the rows can be split into bands freely
+static void scale_rows(void *arg, const int first_row, const int last_row) {
+
+    const ScaleJob *job = arg;
+    const RowKernels *kernels = get_row_kernels();
+
+    for (int row = first_row; row < last_row; row++) {
+        if (job->filter == SCALE_BILINEAR)
+            scale_row_bilinear(job, row);
+        else
+            kernels->gather_row(job->block + (ptrdiff_t) row * job->linesize, job->buffer + job->y_axis->offset[row],
+                                job->x_axis->offset, job->x_axis->valid, job->step);
+    }
+}
+
+void scale_block(ScaleCache *cache, WorkerPool *pool, const ScaleFilter filter, const float scale_factor,
+                 const uint8_t *buffer, uint8_t *plane, const int linesize, const int pixel_step, const int x,
+                 const int y, const int width, const int height) {
+
+    const ScaleAxis *x_axis = get_scale_axis(cache, width, pixel_step, scale_factor, filter, NULL);
+    const ScaleAxis *y_axis = get_scale_axis(cache, height, width * pixel_step, scale_factor, filter, x_axis);
+
+    ScaleJob job = {
+        .x_axis = x_axis,
+        .y_axis = y_axis,
+        .filter = filter,
+        .buffer = buffer,
+        .block = plane + (ptrdiff_t) y * linesize + (ptrdiff_t) x * pixel_step,
+        .linesize = linesize,
+        .step = pixel_step
+    };
+
+    pool_run_bands(pool, scale_rows, &job, y_axis->valid, (size_t) width * pixel_step);
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "pool/pool.h"
+
+typedef enum ScaleFilter {
+    SCALE_NEAREST = 0,
+    SCALE_BILINEAR = 1
+} ScaleFilter;
+
+// Source positions along one axis of a scaled region. Offsets are in bytes (pixel_step for x, the buffer row size
+// for y) so they can be added to the copied region directly. Destination positions from valid on have no source
+// inside the region and are left untouched, like before.
+typedef struct ScaleAxis {
+    int length;
+    int step;
+    float scale_factor;
+    ScaleFilter filter;
+
+    int valid;
+    // entries the tables below have room for, at least length
+    int capacity;
+    int32_t *offset;
+
+    // bilinear only, offset of the following sample and its weight in 1/256
+    int32_t *next_offset;
+    uint16_t *weight;
+} ScaleAxis;
+
+#define SCALE_CACHE_SIZE 16
+
+// Regions stay on the stack for many frames, so the axes of the most recently scaled sizes are kept around
+typedef struct ScaleCache {
+    ScaleAxis axis[SCALE_CACHE_SIZE];
+    int next;
+    // tables are allocated with at least this many entries, so rebuilding an axis for another size does not allocate
+    int table_length;
+} ScaleCache;
+
+// Returns false for unknown names
+bool parse_scale_filter(const char *name, ScaleFilter *filter);
+const char *get_scale_filter_name(ScaleFilter filter);
+
+void free_scale_cache(ScaleCache *cache);
+
+// Scales the copied region in buffer (width * pixel_step bytes per row, ROW_GATHER_PADDING bytes of padding)
+// into the width x height block at x/y of the plane, split into bands of rows on the pool
+void scale_block(ScaleCache *cache, WorkerPool *pool, ScaleFilter filter, float scale_factor, const uint8_t *buffer,
+                 uint8_t *plane, int linesize, int pixel_step, int x, int y, int width, int height);
@@ -0,0 +1,265 @@
+#include "timeline.h"
+#include "video-effects.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TIMELINE_MAGIC "VETL"
+#define TIMELINE_VERSION 1
+
+static void *grow_array(void *array, int *capacity, const int needed, const size_t element_size) {
+
+    if (needed <= *capacity)
+        return array;
+
+    int new_capacity = *capacity > 0 ? *capacity : 64;
+    while (new_capacity < needed)
+        new_capacity *= 2;
+
+    void *buffer = realloc(array, element_size * new_capacity);
+    if (buffer == NULL) {
+        fail_job("Failed to allocate memory.");
+    }
+
+    *capacity = new_capacity;
+    return buffer;
+}
+
+void init_timeline(Timeline *timeline, const int width, const int height, const int effect_id,
+                   const unsigned int seed) {
+    memset(timeline, 0, sizeof(Timeline));
+    timeline->width = width;
+    timeline->height = height;
+    timeline->effect_id = effect_id;
+    timeline->seed = seed;
+}
+
+void free_timeline(Timeline *timeline) {
+    free(timeline->node);
+    free(timeline->frame);
+    free(timeline->move);
+    memset(timeline, 0, sizeof(Timeline));
+}
+
+static int add_node(Timeline *timeline, const RegionPair *pair, const int parent, const bool moves) {
+
+    timeline->node = grow_array(timeline->node, &timeline->node_capacity, timeline->node_count + 1,
+                                sizeof(TimelineNode));
+
+    TimelineNode *node = &timeline->node[timeline->node_count];
+    node->pair = *pair;
+    node->parent = parent;
+
+    // the destinations are stored per frame
+    if (moves)
+        node->pair.two = (Region) { 0 };
+
+    return timeline->node_count++;
+}
+
+void record_timeline_frame(Timeline *timeline, const Regions *region_data, const bool moves) {
+
+    const TimelineFrame *previous = timeline->frame_count > 0 ? &timeline->frame[timeline->frame_count - 1] : NULL;
+    const int previous_size = previous != NULL ? previous->size : 0;
+    const int previous_top = previous != NULL ? previous->top : -1;
+
+    // randomize() pushes or pops at most one pair per frame, anything else starts a new chain
+    int top;
+    if (region_data->size == previous_size) {
+        top = previous_top;
+    } else if (region_data->size == previous_size + 1) {
+        top = add_node(timeline, &region_data->region_pair[region_data->size - 1], previous_top, moves);
+    } else if (region_data->size == previous_size - 1) {
+        top = timeline->node[previous_top].parent;
+    } else {
+        top = -1;
+        for (int i = 0; i < region_data->size; i++)
+            top = add_node(timeline, &region_data->region_pair[i], top, moves);
+    }
+
+    timeline->frame = grow_array(timeline->frame, &timeline->frame_capacity, timeline->frame_count + 1,
+                                 sizeof(TimelineFrame));
+
+    TimelineFrame *frame = &timeline->frame[timeline->frame_count++];
+    frame->top = top;
+    frame->size = region_data->size;
+    frame->moves = -1;
+
+    if (!moves)
+        return;
+
+    timeline->move = grow_array(timeline->move, &timeline->move_capacity, timeline->move_count + region_data->size,
+                                sizeof(Region));
+
+    frame->moves = timeline->move_count;
+    for (int i = 0; i < region_data->size; i++)
+        timeline->move[timeline->move_count++] = region_data->region_pair[i].two;
+}
+
+void load_timeline_frame(const Timeline *timeline, const int frame, Regions *region_data) {
+
+    if (frame < 0 || frame >= timeline->frame_count) {
+        fail_job("The region timeline has no frame %d, it covers %d frames", frame, timeline->frame_count);
+    }
+
+    const TimelineFrame *current = &timeline->frame[frame];
+
+    // the stack keeps its memory from frame to frame
+    reserve_regions(region_data, current->size);
+    region_data->size = current->size;
+
+    int node = current->top;
+    for (int i = current->size - 1; i >= 0; i--) {
+        if (node < 0) {
+            fail_job("The region timeline is inconsistent at frame %d", frame);
+        }
+        region_data->region_pair[i] = timeline->node[node].pair;
+        node = timeline->node[node].parent;
+    }
+
+    if (current->moves >= 0) {
+        for (int i = 0; i < current->size; i++)
+            region_data->region_pair[i].two = timeline->move[current->moves + i];
+    }
+}
+
+static void write_value(FILE *file, const uint32_t value, const int bytes) {
+    for (int i = 0; i < bytes; i++)
+        fputc((int) ((value >> (8 * i)) & 0xff), file);
+}
+
+static void write_region(FILE *file, const Region *region) {
+    write_value(file, region->start.x, 2);
+    write_value(file, region->start.y, 2);
+    write_value(file, region->end.x, 2);
+    write_value(file, region->end.y, 2);
+    write_value(file, region->width, 2);
+    write_value(file, region->height, 2);
+}
+
+void export_timeline(const Timeline *timeline, const char *file_path) {
+
+    FILE *file = fopen(file_path, "wb");
+    if (file == NULL) {
+        fail_job("Could not open '%s' for writing", file_path);
+    }
+
+    fwrite(TIMELINE_MAGIC, 1, 4, file);
+    write_value(file, TIMELINE_VERSION, 4);
+    write_value(file, timeline->width, 4);
+    write_value(file, timeline->height, 4);
+    write_value(file, timeline->effect_id, 4);
+    write_value(file, timeline->seed, 4);
+    write_value(file, timeline->node_count, 4);
+    write_value(file, timeline->frame_count, 4);
+    write_value(file, timeline->move_count, 4);
+
+    for (int i = 0; i < timeline->node_count; i++) {
+        write_region(file, &timeline->node[i].pair.one);
+        write_region(file, &timeline->node[i].pair.two);
+        write_value(file, (uint32_t) timeline->node[i].parent, 4);
+    }
+
+    for (int i = 0; i < timeline->frame_count; i++) {
+        write_value(file, (uint32_t) timeline->frame[i].top, 4);
+        write_value(file, (uint32_t) timeline->frame[i].size, 4);
+        write_value(file, (uint32_t) timeline->frame[i].moves, 4);
+    }
+
+    for (int i = 0; i < timeline->move_count; i++)
+        write_region(file, &timeline->move[i]);
+
+    if (ferror(file) || fclose(file) != 0) {
+        fail_job("Could not write the region timeline to '%s'", file_path);
+    }
+}
+
+static uint32_t read_value(FILE *file, const int bytes, const char *file_path) {
+
+    uint32_t value = 0;
+    for (int i = 0; i < bytes; i++) {
+        const int c = fgetc(file);
+        if (c == EOF) {
+            fail_job("The region timeline '%s' is truncated", file_path);
+        }
+        value |= (uint32_t) c << (8 * i);
+    }
+
+    return value;
+}
+
+static void invalid_timeline(const char *file_path) {
+    fail_job("'%s' is not a valid region timeline", file_path);
+}
+
+// the regions are used as frame coordinates later, so they have to lie inside the frame
+static void read_region(FILE *file, const Timeline *timeline, Region *region, const char *file_path) {
+    region->start.x = read_value(file, 2, file_path);
+    region->start.y = read_value(file, 2, file_path);
+    region->end.x = read_value(file, 2, file_path);
+    region->end.y = read_value(file, 2, file_path);
+    region->width = read_value(file, 2, file_path);
+    region->height = read_value(file, 2, file_path);
+
+    if (region->start.x > region->end.x || region->start.y > region->end.y || region->end.x > timeline->width ||
+        region->end.y > timeline->height)
+        invalid_timeline(file_path);
+}
+
+void import_timeline(Timeline *timeline, const char *file_path) {
+
+    FILE *file = fopen(file_path, "rb");
+    if (file == NULL) {
+        fail_job("Could not open '%s'", file_path);
+    }
+
+    char magic[4];
+    if (fread(magic, 1, 4, file) != 4 || memcmp(magic, TIMELINE_MAGIC, 4) != 0 ||
+        read_value(file, 4, file_path) != TIMELINE_VERSION)
+        invalid_timeline(file_path);
+
+    const int width = (int) read_value(file, 4, file_path);
+    const int height = (int) read_value(file, 4, file_path);
+    const int effect_id = (int) read_value(file, 4, file_path);
+    const unsigned int seed = read_value(file, 4, file_path);
+    init_timeline(timeline, width, height, effect_id, seed);
+
+    const int node_count = (int) read_value(file, 4, file_path);
+    const int frame_count = (int) read_value(file, 4, file_path);
+    const int move_count = (int) read_value(file, 4, file_path);
+    if (node_count < 0 || frame_count < 0 || move_count < 0)
+        invalid_timeline(file_path);
+
+    timeline->node = grow_array(NULL, &timeline->node_capacity, node_count, sizeof(TimelineNode));
+    timeline->frame = grow_array(NULL, &timeline->frame_capacity, frame_count, sizeof(TimelineFrame));
+    timeline->move = grow_array(NULL, &timeline->move_capacity, move_count, sizeof(Region));
+
+    for (int i = 0; i < node_count; i++) {
+        TimelineNode *node = &timeline->node[i];
+        read_region(file, timeline, &node->pair.one, file_path);
+        read_region(file, timeline, &node->pair.two, file_path);
+        node->parent = (int) read_value(file, 4, file_path);
+        // parents always come before their children
+        if (node->parent < -1 || node->parent >= i)
+            invalid_timeline(file_path);
+    }
+    timeline->node_count = node_count;
+
+    for (int i = 0; i < frame_count; i++) {
+        TimelineFrame *frame = &timeline->frame[i];
+        frame->top = (int) read_value(file, 4, file_path);
+        frame->size = (int) read_value(file, 4, file_path);
+        frame->moves = (int) read_value(file, 4, file_path);
+        if (frame->top < -1 || frame->top >= node_count || frame->size < 0 || frame->moves < -1 ||
+            (frame->moves >= 0 && frame->moves + frame->size > move_count))
+            invalid_timeline(file_path);
+    }
+    timeline->frame_count = frame_count;
+
+    for (int i = 0; i < move_count; i++)
+        read_region(file, timeline, &timeline->move[i], file_path);
+    timeline->move_count = move_count;
+
+    fclose(file);
+}
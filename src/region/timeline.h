@@ -0,0 +1,55 @@
+#pragma once
+
+#include "region.h"
+
+#include <stdint.h>
+
+// Region stacks of all frames of a run. The stacks share their common part: every pushed pair is a node that
+// points to the node below it, and a frame only stores its top node. Any frame can be loaded without replaying
+// the frames before it.
+typedef struct TimelineNode {
+    RegionPair pair;
+    int parent;
+} TimelineNode;
+
+typedef struct TimelineFrame {
+    int top;
+    int size;
+
+    // index of the first move destination in Timeline::move, -1 if the effect does not move regions
+    int moves;
+} TimelineFrame;
+
+typedef struct Timeline {
+    int width;
+    int height;
+    int effect_id;
+    unsigned int seed;
+
+    TimelineNode *node;
+    int node_count;
+    int node_capacity;
+
+    TimelineFrame *frame;
+    int frame_count;
+    int frame_capacity;
+
+    // Region Move destinations, one per stack entry and frame, bottom of the stack first
+    Region *move;
+    int move_count;
+    int move_capacity;
+} Timeline;
+
+void init_timeline(Timeline *timeline, int width, int height, int effect_id, unsigned int seed);
+
+void free_timeline(Timeline *timeline);
+
+// Appends the stack of the next frame, moves says whether the destinations in RegionPair::two change per frame
+void record_timeline_frame(Timeline *timeline, const Regions *region_data, bool moves);
+
+// Replaces the stack with the one of the given frame
+void load_timeline_frame(const Timeline *timeline, int frame, Regions *region_data);
+
+// Compact binary format, all values little endian
+void export_timeline(const Timeline *timeline, const char *file_path);
+void import_timeline(Timeline *timeline, const char *file_path);
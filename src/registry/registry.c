@@ -0,0 +1,140 @@
+#include "registry.h"
+#include "effect.h"
+#include "video-effects.h"
+#include "region/kernels.h"
+
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <libavutil/common.h>
+
+typedef struct RegisteredEffect {
+    const EffectDescriptor *descriptor;
+    // dlopen() handle, NULL for the built-in effects
+    void *handle;
+} RegisteredEffect;
+
+static RegisteredEffect effects[MAX_EFFECTS] = {
+    [EFFECT_ONE] = { &region_scaling_effect, NULL },
+    [EFFECT_TWO] = { &region_swap_effect, NULL },
+    [EFFECT_THREE] = { &region_move_effect, NULL }
+};
+
+const EffectDescriptor *find_effect(const int id) {
+
+    if (id <= NONE || id >= MAX_EFFECTS)
+        return NULL;
+
+    return effects[id].descriptor;
+}
+
+static void reject_plugin(const char *path, const char *reason, void *handle) {
+    if (handle != NULL)
+        dlclose(handle);
+    fail_job("Could not load the plugin '%s': %s", path, reason);
+}
+
+void load_effect_plugin(const char *path) {
+
+    void *handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    if (handle == NULL)
+        reject_plugin(path, dlerror(), NULL);
+
+    EffectPluginEntry entry;
+    *(void **) &entry = dlsym(handle, EFFECT_PLUGIN_ENTRY);
+    if (entry == NULL)
+        reject_plugin(path, "it does not export " EFFECT_PLUGIN_ENTRY "()", handle);
+
+    const EffectDescriptor *effect = entry();
+    if (effect == NULL || effect->api_version != EFFECT_API_VERSION)
+        reject_plugin(path, "it was built for another version of the effect interface", handle);
+
+    if (effect->id <= EFFECT_THREE || effect->id >= MAX_EFFECTS || effects[effect->id].descriptor != NULL)
+        reject_plugin(path, "its filter id is not free", handle);
+
+    if (effect->name == NULL || effect->plan == NULL || effect->apply == NULL ||
+        !(effect->capabilities & EFFECT_PACKED_RGB) ||
+        ((effect->capabilities & EFFECT_PLANAR_YUV) && effect->apply_planar == NULL) || effect->scratch_per_region < 0)
+        reject_plugin(path, "its effect description is incomplete", handle);
+
+    effects[effect->id] = (RegisteredEffect) { effect, handle };
+}
+
+void unload_effect_plugins(void) {
+
+    for (int id = 0; id < MAX_EFFECTS; id++) {
+        if (effects[id].handle == NULL)
+            continue;
+        dlclose(effects[id].handle);
+        effects[id] = (RegisteredEffect) { NULL, NULL };
+    }
+}
+
+unsigned int get_chain_capabilities(const Config *data) {
+
+    const EffectDescriptor *effect = find_effect(data->effect_id);
+    unsigned int capabilities = effect != NULL ? effect->capabilities : 0;
+
+    for (int i = 0; i < data->chain_length; i++) {
+        effect = find_effect(data->chain[i]);
+        capabilities &= effect != NULL ? effect->capabilities : 0;
+    }
+
+    return capabilities;
+}
+
+unsigned int get_any_chain_capabilities(const Config *data) {
+
+    unsigned int capabilities = 0;
+    for (int i = 0; i <= data->chain_length; i++) {
+        const EffectDescriptor *effect = find_effect(i == 0 ? data->effect_id : data->chain[i - 1]);
+        capabilities |= effect != NULL ? effect->capabilities : 0;
+    }
+
+    return capabilities;
+}
+
+StatsTimer get_effect_timer(const int id) {
+    switch (id) {
+        case EFFECT_ONE:
+            return STATS_EFFECT_REGION_SCALING;
+        case EFFECT_TWO:
+            return STATS_EFFECT_REGION_SWAP;
+        case EFFECT_THREE:
+            return STATS_EFFECT_REGION_MOVE;
+        default:
+            return STATS_EFFECT_PLUGIN;
+    }
+}
+
+void reserve_effect_scratch(Config *data, const EffectDescriptor *effect, const int pixel_step) {
+
+    if (effect->scratch_per_region == 0)
+        return;
+
+    size_t largest = 0;
+    for (int i = 0; i < data->region_data->size; i++) {
+        const RegionPair *current = &data->region_data->region_pair[i];
+        largest = FFMAX(largest, (size_t) current->one.width * current->one.height);
+        largest = FFMAX(largest, (size_t) current->two.width * current->two.height);
+    }
+
+    if (largest > 0)
+        reserve_buffer(data, largest * pixel_step * effect->scratch_per_region + ROW_GATHER_PADDING);
+}
+
+void reserve_chain_scratch(Config *data, const int width, const int height, const int pixel_step) {
+
+    int scratch_per_region = 0;
+    bool scaled = false;
+
+    for (int i = 0; i <= data->chain_length; i++) {
+        const EffectDescriptor *effect = find_effect(i == 0 ? data->effect_id : data->chain[i - 1]);
+        if (effect == NULL)
+            continue;
+        scratch_per_region = FFMAX(scratch_per_region, effect->scratch_per_region);
+        scaled = scaled || (effect->capabilities & EFFECT_SCALED);
+    }
+
+    reserve_frame_scratch(data, width, height, pixel_step, scratch_per_region, scaled);
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "cmdline.h"
+#include "region/region.h"
+#include "stats/stats.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Version of EffectDescriptor, a plugin built against another one is rejected
+#define EFFECT_API_VERSION 1
+
+// Ids 1 to 3 are the built-in effects, plugins pick a free id up to MAX_EFFECTS - 1
+#define MAX_EFFECTS 32
+
+// A plugin is a shared object that exports this function, see --plugin
+#define EFFECT_PLUGIN_ENTRY "video_effects_plugin"
+
+// What an effect can do, the processing path of a run is picked from the capabilities all its effects share
+typedef enum EffectCapability {
+
+    // renders packed RGB24/RGB0 frames with apply(), every effect has to
+    EFFECT_PACKED_RGB = 1 << 0,
+    // renders YUV420P, NV12 and YUV444P planes with apply_planar(), so frames of those formats are not converted
+    EFFECT_PLANAR_YUV = 1 << 1,
+    // only reads and writes the regions on its stack, so only those are converted to RGB and back
+    EFFECT_IN_PLACE = 1 << 2,
+    // its region operations can be split into horizontal bands on the worker pool
+    EFFECT_BAND_SAFE = 1 << 3,
+    // the output only depends on the input, the seed and the frame index, needed for segments, smart rendering
+    // and the region timelines
+    EFFECT_DETERMINISTIC = 1 << 4,
+    // uses --scale
+    EFFECT_SCALED = 1 << 5,
+    // the second region of a pair is a move destination, not a region of its own
+    EFFECT_MOVES = 1 << 6
+
+} EffectCapability;
+
+typedef struct EffectDescriptor {
+
+    int api_version;
+    int id;
+    const char *name;
+
+    // EffectCapability flags
+    unsigned int capabilities;
+
+    // scratch copies of its largest region an effect needs at once, reserved in data->buffer before apply()
+    int scratch_per_region;
+
+    // plan() draws the region decisions of a frame into data->region_data, apply() renders them
+    void (*plan)(int width, int height, Config *data);
+    void (*apply)(uint8_t *pixel, int linesize, int pixel_step, int width, int height, Config *data);
+    void (*apply_planar)(const PlanarImage *image, Config *data);
+
+} EffectDescriptor;
+
+typedef const EffectDescriptor *(*EffectPluginEntry)(void);
+
+// NULL for ids without an effect
+const EffectDescriptor *find_effect(int id);
+
+// Loads a plugin and registers its effect, exits on any error
+void load_effect_plugin(const char *path);
+void unload_effect_plugins(void);
+
+// Capabilities every effect of the -f chain of data has, and those at least one of them has
+unsigned int get_chain_capabilities(const Config *data);
+unsigned int get_any_chain_capabilities(const Config *data);
+
+// Timer of the effect in the run report, plugins share one
+StatsTimer get_effect_timer(int id);
+
+// Grows data->buffer to the scratch memory the effect needs for the regions on its stack
+void reserve_effect_scratch(Config *data, const EffectDescriptor *effect, int pixel_step);
+
+// Reserves the scratch memory of the largest random region for all effects of the -f chain before the first frame
+void reserve_chain_scratch(Config *data, int width, int height, int pixel_step);
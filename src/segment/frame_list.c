@@ -0,0 +1,114 @@
+#include "frame_list.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+void add_frame_pts(FrameList *list, const int64_t pts) {
+
+    if (list->size == list->capacity) {
+        list->capacity = list->capacity > 0 ? list->capacity * 2 : 1024;
+        int64_t *buffer = realloc(list->pts, sizeof(int64_t) * list->capacity);
+        if (buffer == NULL)
+            fail_job("Failed to allocate memory.");
+        list->pts = buffer;
+    }
+
+    list->pts[list->size++] = pts;
+}
+
+static int compare_pts(const void *a, const void *b) {
+    const int64_t pts_a = *(const int64_t *) a;
+    const int64_t pts_b = *(const int64_t *) b;
+    return (pts_a > pts_b) - (pts_a < pts_b);
+}
+
+void sort_frame_list(FrameList *list) {
+    if (list->size > 0)
+        qsort(list->pts, list->size, sizeof(int64_t), compare_pts);
+}
+
+void free_frame_list(FrameList *list) {
+    free(list->pts);
+    *list = (FrameList) { 0 };
+}
+
+int rank_frame_pts(const FrameList *list, const int64_t pts) {
+
+    int low = 0;
+    int high = list->size;
+    while (low < high) {
+        const int middle = low + (high - low) / 2;
+        if (list->pts[middle] < pts)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    return low;
+}
+
+int find_frame_pts(const FrameList *list, const int64_t pts) {
+    const int index = rank_frame_pts(list, pts);
+    return index < list->size && list->pts[index] == pts ? index : -1;
+}
+
+void drop_undecodable_frames(const char *input_file_path, Config *data, FrameList *list) {
+
+    VideoContext ctx = { .data = data };
+    open_input(&ctx, input_file_path);
+
+    AVPacket *packet = av_packet_alloc();
+    AVFrame *frame = av_frame_alloc();
+    NOT_NULL(packet);
+    NOT_NULL(frame);
+
+    FrameList sent = { 0 };
+    FrameList decoded = { 0 };
+
+    int keyframes_read = 0;
+    bool draining = false;
+    while (!draining) {
+        if (av_read_frame(ctx.input_format_context, packet) < 0) {
+            send_packet(&ctx, NULL);
+            draining = true;
+        }
+        else if (packet->stream_index != ctx.video_stream_index) {
+            av_packet_unref(packet);
+            continue;
+        }
+        else if ((packet->flags & AV_PKT_FLAG_KEY) && ++keyframes_read == 2) {
+            av_packet_unref(packet);
+            send_packet(&ctx, NULL);
+            draining = true;
+        }
+        else {
+            add_frame_pts(&sent, packet->pts);
+            send_packet(&ctx, packet);
+            av_packet_unref(packet);
+        }
+
+        while (avcodec_receive_frame(ctx.decoder_context, frame) >= 0) {
+            add_frame_pts(&decoded, frame->best_effort_timestamp);
+            av_frame_unref(frame);
+        }
+    }
+
+    sort_frame_list(&decoded);
+
+    for (int i = 0; i < sent.size; i++) {
+        if (find_frame_pts(&decoded, sent.pts[i]) >= 0)
+            continue;
+
+        const int index = find_frame_pts(list, sent.pts[i]);
+        if (index < 0)
+            continue;
+        memmove(&list->pts[index], &list->pts[index + 1], sizeof(int64_t) * (list->size - index - 1));
+        list->size--;
+    }
+
+    free_frame_list(&sent);
+    free_frame_list(&decoded);
+    av_frame_free(&frame);
+    av_packet_free(&packet);
+    close_video_context(&ctx);
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "video-effects.h"
+
+// The frames of the video stream by pts, sorted. The position of a frame in the list is its frame index on the
+// region timeline, so segments and smart rendering find the frames a serial run processes.
+typedef struct FrameList {
+    int64_t *pts;
+    int size;
+    int capacity;
+} FrameList;
+
+void add_frame_pts(FrameList *list, int64_t pts);
+void sort_frame_list(FrameList *list);
+void free_frame_list(FrameList *list);
+
+// Number of frames before pts
+int rank_frame_pts(const FrameList *list, int64_t pts);
+// Frame index of pts, -1 if it is not in the list
+int find_frame_pts(const FrameList *list, int64_t pts);
+
+// The decoder drops the frames at the start of the input it has no reference for, e.g. the leading B-frames of an
+// open GOP. Decodes the packets up to the second keyframe like a serial run does and removes whatever does not
+// come out of the decoder from the sorted list.
+void drop_undecodable_frames(const char *input_file_path, Config *data, FrameList *list);
@@ -0,0 +1,602 @@
+#include "segment.h"
+#include "frame_list.h"
+#include "video-effects.h"
+#include "region/region.h"
+#include "region/timeline.h"
+#include "stats/stats.h"
+#include "index/index.h"
+#include "io/output_file.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <setjmp.h>
+
+#define SEGMENT_ERROR_SIZE 256
+
+typedef struct Keyframe {
+    int64_t pts;
+    int64_t dts;
+    // frame index of the keyframe on the timeline
+    int frame_index;
+} Keyframe;
+
+typedef struct Keyframes {
+    Keyframe *keyframe;
+    int size;
+    int capacity;
+
+    // pts of every frame a serial run decodes, sorted, the position is the frame index of the timeline
+    FrameList frames;
+
+    int width;
+    int height;
+} Keyframes;
+
+typedef struct Segment {
+    int number;
+
+    // the segment decodes from the keyframe before its start and drops the frames of that GOP again, segment 0
+    // decodes from the start of the file
+    Keyframe preroll;
+    bool has_preroll;
+
+    // timeline index of the first frame and number of frames, the frames are found by their pts
+    int first_frame;
+    int frame_count;
+    int frames_done;
+    const FrameList *frames;
+
+    // the codec headers go into the extradata, which has to be the same for every segment
+    bool global_header;
+
+    Regions regions;
+    char *temp_file_path;
+
+    const char *input_file_path;
+    const Config *data;
+    const Timeline *timeline;
+
+    // state of the worker, outside of its stack frame so it is still valid after a failed check jumped back
+    Config worker_data;
+    VideoContext ctx;
+    FrameSlot slot;
+    AVPacket *packet;
+
+    // a failed worker only stops, the failure is reported once all workers have stopped
+    bool failed;
+    char error[SEGMENT_ERROR_SIZE];
+} Segment;
+
+static void *checked_malloc(const size_t size) {
+    void *ptr = malloc(size);
+    if (ptr == NULL)
+        fail_job("Failed to allocate memory.");
+    return ptr;
+}
+
+static void missing_timestamps(const char *input_file_path) {
+    fail_job("Segmented processing needs timestamps on all video packets of '%s'", input_file_path);
+}
+
+static void add_keyframe(const char *input_file_path, Keyframes *keyframes, const int64_t pts, const int64_t dts) {
+
+    if (pts == AV_NOPTS_VALUE)
+        missing_timestamps(input_file_path);
+
+    if (keyframes->size == keyframes->capacity) {
+        keyframes->capacity = keyframes->capacity > 0 ? keyframes->capacity * 2 : 64;
+        Keyframe *buffer = realloc(keyframes->keyframe, sizeof(Keyframe) * keyframes->capacity);
+        if (buffer == NULL)
+            fail_job("Failed to allocate memory.");
+        keyframes->keyframe = buffer;
+    }
+
+    keyframes->keyframe[keyframes->size++] = (Keyframe) { .pts = pts, .dts = dts, .frame_index = -1 };
+}
+
+static void add_frame(const char *input_file_path, Keyframes *keyframes, const int64_t pts) {
+    if (pts == AV_NOPTS_VALUE)
+        missing_timestamps(input_file_path);
+    add_frame_pts(&keyframes->frames, pts);
+}
+
+// The index lists the pts of all video packets in decode order and the keyframes among them
+static void read_index_keyframes(const char *input_file_path, const VideoIndex *index, Keyframes *keyframes) {
+
+    const IndexHeader *header = index->header;
+
+    for (int i = 0; i < header->keyframe_count; i++)
+        add_keyframe(input_file_path, keyframes, index->keyframe[i].pts, index->keyframe[i].dts);
+    for (int i = 0; i < header->frame_count; i++)
+        add_frame(input_file_path, keyframes, index->frame_pts[i]);
+
+    keyframes->width = header->width;
+    keyframes->height = header->height;
+}
+
+// Demux-only pass over the input that records the pts of every video packet and the keyframes among them, or the
+// same from the index. Then the frames get their timeline index from their rank in presentation order.
+static void scan_keyframes(const char *input_file_path, Config *data, Keyframes *keyframes) {
+
+    if (data->index != NULL) {
+        read_index_keyframes(input_file_path, data->index, keyframes);
+    }
+    else {
+        VideoContext ctx = { .data = data };
+        open_input(&ctx, input_file_path);
+
+        AVPacket *packet = av_packet_alloc();
+        NOT_NULL(packet);
+
+        while (av_read_frame(ctx.input_format_context, packet) >= 0) {
+            if (packet->stream_index == ctx.video_stream_index) {
+                if (packet->flags & AV_PKT_FLAG_KEY)
+                    add_keyframe(input_file_path, keyframes, packet->pts, packet->dts);
+                add_frame(input_file_path, keyframes, packet->pts);
+            }
+            av_packet_unref(packet);
+        }
+
+        keyframes->width = ctx.decoder_context->width;
+        keyframes->height = ctx.decoder_context->height;
+
+        av_packet_free(&packet);
+        close_video_context(&ctx);
+    }
+
+    if (keyframes->size == 0)
+        return;
+
+    sort_frame_list(&keyframes->frames);
+    drop_undecodable_frames(input_file_path, data, &keyframes->frames);
+
+    for (int i = 0; i < keyframes->size; i++)
+        keyframes->keyframe[i].frame_index = rank_frame_pts(&keyframes->frames, keyframes->keyframe[i].pts);
+}
+
+// Picks the keyframes closest to equally sized parts, returns the number of segments. The first segment starts
+// with the file, so it keeps the frames in front of the first keyframe like a serial run.
+static int split_segments(const Keyframes *keyframes, const int requested, Segment *segments) {
+
+    const int frames = keyframes->frames.size;
+
+    segments[0].has_preroll = false;
+    segments[0].first_frame = 0;
+
+    int count = 1;
+    int next = 1;
+    for (int i = 1; i < requested && next < keyframes->size; i++) {
+        const int target = (int) ((int64_t) frames * i / requested);
+
+        while (next < keyframes->size && keyframes->keyframe[next].frame_index < target)
+            next++;
+        if (next == keyframes->size)
+            break;
+
+        segments[count].has_preroll = true;
+        segments[count].preroll = keyframes->keyframe[next - 1];
+        segments[count].first_frame = keyframes->keyframe[next].frame_index;
+        count++;
+        next++;
+    }
+
+    for (int i = 0; i < count; i++) {
+        const int end = i + 1 < count ? segments[i + 1].first_frame : frames;
+        segments[i].frame_count = end - segments[i].first_frame;
+    }
+
+    return count;
+}
+
+// Plans the regions of all frames ahead, the workers then load the frames they process from the timeline
+static void plan_timeline(const Keyframes *keyframes, Config *data, Timeline *timeline) {
+
+    Regions state = { .region_pair = NULL, .size = 0 };
+    copy_regions(&state, data->region_data);
+
+    Config replay = *data;
+    replay.region_data = &state;
+    replay.recorded_timeline = timeline;
+
+    for (int frame = 0; frame < keyframes->frames.size; frame++)
+        plan_frame(&replay, keyframes->width, keyframes->height);
+
+    cleanup_regions(&state);
+}
+
+static void open_segment_output(VideoContext *ctx, const char *temp_file_path) {
+
+    AVFormatContext *output_format_context = NULL;
+    AV_NOT_NEGATIVE(avformat_alloc_output_context2(&output_format_context, NULL, "nut", temp_file_path));
+
+    AVStream *out_video_stream = avformat_new_stream(output_format_context, NULL);
+    NOT_NULL(out_video_stream);
+
+    AV_NOT_NEGATIVE(avcodec_parameters_from_context(out_video_stream->codecpar, ctx->encoder_context));
+    out_video_stream->time_base = ctx->encoder_context->time_base;
+
+    AV_NOT_NEGATIVE(avio_open(&output_format_context->pb, temp_file_path, AVIO_FLAG_WRITE));
+    AV_NOT_NEGATIVE(avformat_write_header(output_format_context, NULL));
+
+    ctx->output_format_context = output_format_context;
+    ctx->out_video_stream = out_video_stream;
+    ctx->header_written = true;
+}
+
+// Only the frames of the segment are processed, the pre-roll and the frames decoded after its end are dropped
+static void process_segment_frames(VideoContext *ctx, FrameSlot *slot, Segment *segment) {
+
+    while (receive_frame(ctx, slot)) {
+        const int index = find_frame_pts(segment->frames, slot->input_frame->best_effort_timestamp);
+        if (index < segment->first_frame || index >= segment->first_frame + segment->frame_count)
+            continue;
+
+        // the stack of the frame is loaded from the timeline
+        ctx->data->region_data->frame = index;
+
+        convert_to_rgb(ctx, slot);
+        apply_frame_effect(ctx, slot);
+        convert_to_output(ctx, slot);
+        stats_stop(STATS_FRAME_LATENCY, slot->decoded_at);
+        encode_frame(ctx, slot->encodable, write_packet, NULL);
+        segment->frames_done++;
+    }
+}
+
+static void run_segment(Segment *segment) {
+
+    Config *data = &segment->worker_data;
+    *data = *segment->data;
+    data->region_data = &segment->regions;
+    data->region_data->frame = segment->first_frame;
+    data->timeline = segment->timeline;
+    data->recorded_timeline = NULL;
+    data->buffer = NULL;
+    data->buffer_size = 0;
+    data->scale_cache = NULL;
+
+    // the segments already run in parallel, the pool only serves one thread at a time
+    data->pool = NULL;
+
+    VideoContext *ctx = &segment->ctx;
+    *ctx = (VideoContext) { .data = data, .global_header = segment->global_header };
+    open_input(ctx, segment->input_file_path);
+    open_encoder(ctx);
+    open_segment_output(ctx, segment->temp_file_path);
+
+    // lands on the pre-roll keyframe or an earlier one, decoding starts at the first keyframe after the seek
+    bool started = !segment->has_preroll;
+    if (segment->has_preroll) {
+        const int64_t timestamp = segment->preroll.pts != AV_NOPTS_VALUE ? segment->preroll.pts
+                                                                         : segment->preroll.dts;
+        AV_NOT_NEGATIVE(av_seek_frame(ctx->input_format_context, ctx->video_stream_index, timestamp,
+                                      AVSEEK_FLAG_BACKWARD));
+    }
+
+    alloc_frame_slot(ctx, &segment->slot);
+
+    segment->packet = av_packet_alloc();
+    NOT_NULL(segment->packet);
+    AVPacket *packet = segment->packet;
+
+    // frames are decoded past the next keyframe until the last one in presentation order came out
+    while (segment->frames_done < segment->frame_count && read_packet(ctx, packet) >= 0) {
+        if (packet->stream_index == ctx->video_stream_index) {
+            if (!started)
+                started = packet->flags & AV_PKT_FLAG_KEY;
+            if (started) {
+                send_packet(ctx, packet);
+                process_segment_frames(ctx, &segment->slot, segment);
+            }
+        }
+        av_packet_unref(packet);
+    }
+
+    send_packet(ctx, NULL);
+    process_segment_frames(ctx, &segment->slot, segment);
+    encode_frame(ctx, NULL, write_packet, NULL);
+
+    if (segment->frames_done != segment->frame_count)
+        fail_job("Decoded %d of its %d frames", segment->frames_done, segment->frame_count);
+
+    close_video_streams(ctx, true);
+}
+
+static void *segment_worker(void *arg) {
+
+    Segment *segment = arg;
+
+    jmp_buf recovery;
+    if (setjmp(recovery) != 0) {
+        segment->failed = true;
+        snprintf(segment->error, SEGMENT_ERROR_SIZE, "Segment %d of '%s' failed: %s", segment->number,
+                 segment->input_file_path, get_job_error());
+        close_video_streams(&segment->ctx, false);
+    }
+    else {
+        set_job_recovery(&recovery);
+        run_segment(segment);
+        set_job_recovery(NULL);
+    }
+
+    av_packet_free(&segment->packet);
+    if (segment->slot.input_frame != NULL)
+        free_frame_slot(&segment->slot);
+    close_video_context(&segment->ctx);
+    free(segment->worker_data.buffer);
+    free_scale_cache(segment->worker_data.scale_cache);
+
+    return NULL;
+}
+
+typedef struct SegmentReader {
+    const Segment *segments;
+    int count;
+    int current;
+    AVFormatContext *format_context;
+} SegmentReader;
+
+static AVFormatContext *open_segment_input(const Segment *segment) {
+    AVFormatContext *format_context = NULL;
+    AV_NOT_NEGATIVE(avformat_open_input(&format_context, segment->temp_file_path, NULL, NULL));
+    AV_NOT_NEGATIVE(avformat_find_stream_info(format_context, NULL));
+    return format_context;
+}
+
+// Reads the encoded packets of all segments in order, returns false after the last one
+static bool read_segment_packet(SegmentReader *reader, AVPacket *packet) {
+
+    while (reader->current < reader->count) {
+        if (reader->format_context == NULL)
+            reader->format_context = open_segment_input(&reader->segments[reader->current]);
+
+        if (av_read_frame(reader->format_context, packet) >= 0)
+            return true;
+
+        avformat_close_input(&reader->format_context);
+        reader->current++;
+    }
+
+    return false;
+}
+
+static bool read_stream_copy_packet(AVFormatContext *input_format_context, const int video_stream_index,
+                                    AVPacket *packet) {
+    while (av_read_frame(input_format_context, packet) >= 0) {
+        if (packet->stream_index != video_stream_index)
+            return true;
+        av_packet_unref(packet);
+    }
+    return false;
+}
+
+// Every segment has an encoder of its own, their packets can only be joined if the codec headers are the same
+static bool check_segment_headers(const Segment *segments, const int count, char *error, const size_t size) {
+
+    AVFormatContext *first_context = open_segment_input(&segments[0]);
+    const AVCodecParameters *first = first_context->streams[0]->codecpar;
+
+    bool same = true;
+    for (int i = 1; i < count && same; i++) {
+        AVFormatContext *format_context = open_segment_input(&segments[i]);
+        const AVCodecParameters *codecpar = format_context->streams[0]->codecpar;
+        same = codecpar->extradata_size == first->extradata_size &&
+               (first->extradata_size == 0 ||
+                memcmp(codecpar->extradata, first->extradata, first->extradata_size) == 0);
+        avformat_close_input(&format_context);
+
+        if (!same)
+            snprintf(error, size, "Segment %d was encoded with other codec headers than segment 0, the segments "
+                                  "can not be joined", i);
+    }
+
+    avformat_close_input(&first_context);
+    return same;
+}
+
+// Merges the encoded segments with a single stream-copy pass over the other input streams
+static void stitch_segments(const char *input_file_path, const char *output_file_path, const Segment *segments,
+                            const int count, const Config *data) {
+
+    AVFormatContext *input_format_context = NULL;
+    AVFormatContext *output_format_context = NULL;
+
+    AV_NOT_NEGATIVE(avformat_open_input(&input_format_context, input_file_path, NULL, NULL));
+    AV_NOT_NEGATIVE(avformat_find_stream_info(input_format_context, NULL));
+
+    const int video_stream_index = av_find_best_stream(input_format_context, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
+    AV_NOT_NEGATIVE(video_stream_index);
+
+    SegmentReader reader = {
+        .segments = segments,
+        .count = count,
+        .current = 0,
+        .format_context = open_segment_input(&segments[0])
+    };
+    const AVStream *segment_stream = reader.format_context->streams[0];
+
+    AV_NOT_NEGATIVE(avformat_alloc_output_context2(&output_format_context, NULL, data->output_format,
+                                                   output_file_path));
+
+    for (int i = 0; i < input_format_context->nb_streams; ++i) {
+        AVStream *out_stream = avformat_new_stream(output_format_context, NULL);
+        NOT_NULL(out_stream);
+        if (i == video_stream_index) {
+            AV_NOT_NEGATIVE(avcodec_parameters_copy(out_stream->codecpar, segment_stream->codecpar));
+            out_stream->time_base = segment_stream->time_base;
+        } else {
+            AV_NOT_NEGATIVE(avcodec_parameters_copy(out_stream->codecpar,
+                                                    input_format_context->streams[i]->codecpar));
+        }
+        out_stream->codecpar->codec_tag = 0;
+    }
+
+    AVIOContext *output_io = NULL;
+    if (is_local_output(output_file_path)) {
+        output_io = open_output_file(output_file_path, data->io_buffer_size, data->sync_bytes);
+        output_format_context->pb = output_io;
+        output_format_context->flags |= AVFMT_FLAG_CUSTOM_IO;
+    } else {
+        AV_NOT_NEGATIVE(avio_open2(&output_format_context->pb, output_file_path, AVIO_FLAG_WRITE, NULL, NULL));
+    }
+    AV_NOT_NEGATIVE(avformat_write_header(output_format_context, NULL));
+
+    AVPacket *video_packet = av_packet_alloc();
+    AVPacket *copy_packet = av_packet_alloc();
+    NOT_NULL(video_packet);
+    NOT_NULL(copy_packet);
+
+    bool has_video = read_segment_packet(&reader, video_packet);
+    bool has_copy = read_stream_copy_packet(input_format_context, video_stream_index, copy_packet);
+
+    while (has_video || has_copy) {
+        const AVRational video_time_base = has_video ? reader.format_context->streams[0]->time_base
+                                                     : (AVRational) { 1, 1 };
+        bool write_video = has_video;
+        if (has_video && has_copy) {
+            const AVRational copy_time_base = input_format_context->streams[copy_packet->stream_index]->time_base;
+            write_video = av_compare_ts(video_packet->dts, video_time_base, copy_packet->dts, copy_time_base) <= 0;
+        }
+
+        if (write_video) {
+            video_packet->stream_index = video_stream_index;
+            av_packet_rescale_ts(video_packet, video_time_base,
+                                 output_format_context->streams[video_stream_index]->time_base);
+            const int64_t start = stats_start();
+            AV_NOT_NEGATIVE(av_interleaved_write_frame(output_format_context, video_packet));
+            stats_stop(STATS_MUX, start);
+            has_video = read_segment_packet(&reader, video_packet);
+        } else {
+            const int index = copy_packet->stream_index;
+            av_packet_rescale_ts(copy_packet, input_format_context->streams[index]->time_base,
+                                 output_format_context->streams[index]->time_base);
+            const int64_t start = stats_start();
+            AV_NOT_NEGATIVE(av_interleaved_write_frame(output_format_context, copy_packet));
+            stats_stop(STATS_MUX, start);
+            has_copy = read_stream_copy_packet(input_format_context, video_stream_index, copy_packet);
+        }
+    }
+
+    AV_NOT_NEGATIVE(av_write_trailer(output_format_context));
+
+    av_packet_free(&video_packet);
+    av_packet_free(&copy_packet);
+
+    if (output_io != NULL)
+        output_format_context->pb = NULL;
+    else
+        AV_NOT_NEGATIVE(avio_closep(&output_format_context->pb));
+    avformat_free_context(output_format_context);
+    AV_NOT_NEGATIVE(close_output_file(&output_io));
+    avformat_close_input(&input_format_context);
+}
+
+// The first failure of the workers, false if there is none
+static bool get_segment_error(const Segment *segments, const int count, char *error, const size_t size) {
+
+    for (int i = 0; i < count; i++) {
+        if (segments[i].failed) {
+            snprintf(error, size, "%s", segments[i].error);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void process_video_segmented(const char *input_file_path, const char *output_file_path, Config *data) {
+
+    Keyframes keyframes = { 0 };
+    scan_keyframes(input_file_path, data, &keyframes);
+
+    if (keyframes.size == 0) {
+        free_frame_list(&keyframes.frames);
+        free(keyframes.keyframe);
+        fail_job("No video keyframes found in '%s'", input_file_path);
+    }
+
+    Segment *segments = checked_malloc(sizeof(Segment) * data->segments);
+    const int count = split_segments(&keyframes, data->segments, segments);
+
+    // the output gets the extradata of segment 0, so every segment encoder has to put its headers there, unless
+    // the output format keeps them in the stream
+    const bool global_header = guess_output_format(data, output_file_path)->flags & AVFMT_GLOBALHEADER;
+
+    // an imported timeline is used as it is unless it has to be recorded for --export-timeline as well
+    Timeline planned;
+    const Timeline *timeline = data->timeline;
+    if (timeline == NULL || data->recorded_timeline != NULL) {
+        Timeline *target = data->recorded_timeline;
+        if (target == NULL) {
+            init_timeline(&planned, 0, 0, data->effect_id, data->seed);
+            target = &planned;
+        }
+        plan_timeline(&keyframes, data, target);
+        timeline = target;
+    }
+
+    const size_t path_size = strlen(output_file_path) + 32;
+    for (int i = 0; i < count; i++) {
+        segments[i].temp_file_path = checked_malloc(path_size);
+        snprintf(segments[i].temp_file_path, path_size, "%s.segment%d.nut", output_file_path, i);
+        segments[i].input_file_path = input_file_path;
+        segments[i].data = data;
+        segments[i].timeline = timeline;
+        segments[i].number = i;
+        segments[i].frames = &keyframes.frames;
+        segments[i].frames_done = 0;
+        segments[i].global_header = global_header;
+        segments[i].regions = (Regions) { .region_pair = NULL, .size = 0, .seed = data->seed };
+        segments[i].ctx = (VideoContext) { 0 };
+        segments[i].slot = (FrameSlot) { 0 };
+        segments[i].packet = NULL;
+        segments[i].failed = false;
+    }
+
+    char error[SEGMENT_ERROR_SIZE];
+    bool failed = false;
+
+    pthread_t *workers = checked_malloc(sizeof(pthread_t) * count);
+    int started = 0;
+    while (started < count && !failed) {
+        failed = pthread_create(&workers[started], NULL, segment_worker, &segments[started]) != 0;
+        if (failed)
+            snprintf(error, sizeof(error), "Failed to start segment worker.");
+        else
+            started++;
+    }
+
+    // the temporary files are only removed once no worker writes to them anymore
+    for (int i = 0; i < started; i++)
+        pthread_join(workers[i], NULL);
+
+    if (!failed)
+        failed = get_segment_error(segments, count, error, sizeof(error)) ||
+                 !check_segment_headers(segments, count, error, sizeof(error));
+
+    if (!failed) {
+        stitch_segments(input_file_path, output_file_path, segments, count, data);
+
+        // the caller continues with the region state after the last frame, like after a serial run
+        copy_regions(data->region_data, &segments[count - 1].regions);
+    }
+
+    if (timeline == &planned)
+        free_timeline(&planned);
+
+    for (int i = 0; i < count; i++) {
+        remove(segments[i].temp_file_path);
+        free(segments[i].temp_file_path);
+        cleanup_regions(&segments[i].regions);
+    }
+
+    free(workers);
+    free(segments);
+    free_frame_list(&keyframes.frames);
+    free(keyframes.keyframe);
+
+    if (failed)
+        fail_job("%s", error);
+}
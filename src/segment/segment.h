@@ -0,0 +1,11 @@
+#pragma once
+
+#include "video-effects.h"
+
+#define MAX_SEGMENTS 256
+
+// Splits the input at keyframes into data->segments parts, runs decode, effect and encode of every part on its
+// own thread and concatenates the encoded parts into the output. A part covers the frames from its keyframe to the
+// next one in presentation order and decodes the GOP before it as pre-roll. The region state of every frame is
+// looked up in a timeline planned from the seed, so the frames match a serial run with the same seed.
+void process_video_segmented(const char *input_file_path, const char *output_file_path, Config *data);
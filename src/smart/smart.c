@@ -0,0 +1,443 @@
+#include "smart.h"
+#include "region/region.h"
+#include "region/timeline.h"
+#include "stats/stats.h"
+#include "index/index.h"
+#include "segment/frame_list.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// A video packet and its GOP, sorted by pts
+typedef struct SmartPacket {
+    int64_t pts;
+    int gop;
+} SmartPacket;
+
+typedef struct SmartPlan {
+    SmartPacket *packet;
+    int packet_count;
+    int packet_capacity;
+
+    // the frames a serial run decodes, their position is the frame index of the timeline
+    FrameList frames;
+
+    // per GOP, whether it is decoded and re-encoded
+    bool *touched;
+    int gop_count;
+
+    int width;
+    int height;
+} SmartPlan;
+
+typedef struct SmartRender {
+    const SmartPlan *plan;
+
+    // the decoder is fed from a keyframe on, the encoder has been used by an earlier run of GOPs
+    bool decoding;
+    bool encoder_used;
+
+    int reencoded_gops;
+    int64_t last_dts;
+    // pts - dts of the last keyframe read from the source, in the time base of the output stream
+    int64_t dts_delay;
+} SmartRender;
+
+static void add_packet(SmartPlan *plan, const int64_t pts, const int gop) {
+
+    if (plan->packet_count == plan->packet_capacity) {
+        plan->packet_capacity = plan->packet_capacity > 0 ? plan->packet_capacity * 2 : 1024;
+        SmartPacket *buffer = realloc(plan->packet, sizeof(SmartPacket) * plan->packet_capacity);
+        if (buffer == NULL)
+            fail_job("Failed to allocate memory.");
+        plan->packet = buffer;
+    }
+
+    plan->packet[plan->packet_count++] = (SmartPacket) { .pts = pts, .gop = gop };
+}
+
+static int compare_packets(const void *a, const void *b) {
+    const int64_t pts_a = ((const SmartPacket *) a)->pts;
+    const int64_t pts_b = ((const SmartPacket *) b)->pts;
+    return (pts_a > pts_b) - (pts_a < pts_b);
+}
+
+static void missing_timestamps(const char *input_file_path) {
+    fail_job("Smart rendering needs timestamps on all video packets of '%s'", input_file_path);
+}
+
+// Counts the GOPs in decode order. The packets in front of the first keyframe belong to GOP 0 together with it,
+// a serial run decodes them as well. Returns whether the packet starts a GOP.
+static bool next_gop(int *gop, bool *keyframe_seen, const bool keyframe) {
+
+    bool start = false;
+    if (*gop < 0) {
+        *gop = 0;
+        start = true;
+    }
+    else if (keyframe && *keyframe_seen) {
+        (*gop)++;
+        start = true;
+    }
+
+    *keyframe_seen |= keyframe;
+    return start;
+}
+
+static void add_scanned_packet(const char *input_file_path, SmartPlan *plan, const int64_t pts, const int gop) {
+    if (pts == AV_NOPTS_VALUE)
+        missing_timestamps(input_file_path);
+    add_packet(plan, pts, gop);
+    add_frame_pts(&plan->frames, pts);
+}
+
+// The index lists the pts of all video packets in decode order and where the keyframes are among them
+static void read_index_frames(const char *input_file_path, const VideoIndex *index, SmartPlan *plan) {
+
+    const IndexHeader *header = index->header;
+
+    int gop = -1;
+    int keyframe = 0;
+    bool keyframe_seen = false;
+    for (int i = 0; i < header->frame_count; i++) {
+        const bool is_keyframe = keyframe < header->keyframe_count && index->keyframe[keyframe].frame_index == i;
+        if (is_keyframe)
+            keyframe++;
+
+        next_gop(&gop, &keyframe_seen, is_keyframe);
+        add_scanned_packet(input_file_path, plan, index->frame_pts[i], gop);
+    }
+
+    plan->gop_count = keyframe_seen ? gop + 1 : 0;
+    plan->width = header->width;
+    plan->height = header->height;
+}
+
+// Demux-only pass that assigns every video packet to its GOP, or the same from the index. The frames are the pts
+// of the packets without those the decoder drops at the start.
+static void scan_frames(const char *input_file_path, Config *data, SmartPlan *plan) {
+
+    if (data->index != NULL) {
+        read_index_frames(input_file_path, data->index, plan);
+    }
+    else {
+        VideoContext ctx = { .data = data };
+        open_input(&ctx, input_file_path);
+
+        AVPacket *packet = av_packet_alloc();
+        NOT_NULL(packet);
+
+        int gop = -1;
+        bool keyframe_seen = false;
+        while (av_read_frame(ctx.input_format_context, packet) >= 0) {
+            if (packet->stream_index == ctx.video_stream_index) {
+                next_gop(&gop, &keyframe_seen, packet->flags & AV_PKT_FLAG_KEY);
+                add_scanned_packet(input_file_path, plan, packet->pts, gop);
+            }
+            av_packet_unref(packet);
+        }
+
+        plan->gop_count = keyframe_seen ? gop + 1 : 0;
+        plan->width = ctx.decoder_context->width;
+        plan->height = ctx.decoder_context->height;
+
+        av_packet_free(&packet);
+        close_video_context(&ctx);
+    }
+
+    if (plan->gop_count == 0)
+        return;
+
+    qsort(plan->packet, plan->packet_count, sizeof(SmartPacket), compare_packets);
+    sort_frame_list(&plan->frames);
+    drop_undecodable_frames(input_file_path, data, &plan->frames);
+}
+
+// GOP of a decoded frame, -1 if it does not belong to any scanned packet
+static int find_gop(const SmartPlan *plan, const int64_t pts) {
+
+    const SmartPacket key = { .pts = pts };
+    const SmartPacket *packet = bsearch(&key, plan->packet, plan->packet_count, sizeof(SmartPacket),
+                                        compare_packets);
+
+    return packet != NULL ? packet->gop : -1;
+}
+
+// Plans the regions of all frames ahead, like the segments do
+static void plan_frames(const SmartPlan *plan, Config *data, Timeline *timeline) {
+
+    Regions state = { .region_pair = NULL, .size = 0 };
+    copy_regions(&state, data->region_data);
+
+    Config replay = *data;
+    replay.region_data = &state;
+    replay.recorded_timeline = timeline;
+
+    for (int frame = 0; frame < plan->frames.size; frame++)
+        plan_frame(&replay, plan->width, plan->height);
+
+    cleanup_regions(&state);
+}
+
+// A GOP is re-encoded if any of its frames has regions on its stack and lies within --start/--end
+static void mark_touched_gops(SmartPlan *plan, const Config *data, const AVStream *stream,
+                              const Timeline *timeline) {
+
+    plan->touched = calloc(plan->gop_count, sizeof(bool));
+    if (plan->touched == NULL)
+        fail_job("Failed to allocate memory.");
+
+    for (int i = 0; i < plan->frames.size; i++) {
+        const int64_t pts = plan->frames.pts[i];
+
+        // frames beyond an imported timeline are processed, plan_frame() reports them
+        const bool regions = i >= timeline->frame_count || timeline->frame[i].size > 0;
+        if (regions && is_effect_time(data, stream, pts))
+            plan->touched[find_gop(plan, pts)] = true;
+    }
+}
+
+// Copied GOPs keep their B-frames and the re-encoded ones have none, so the dts at the borders is kept increasing
+// without ever passing the pts of the packet
+static void write_smart_packet(VideoContext *ctx, AVPacket *packet, SmartRender *render) {
+
+    if (packet->dts != AV_NOPTS_VALUE) {
+        if (render->last_dts != AV_NOPTS_VALUE && packet->dts <= render->last_dts)
+            packet->dts = render->last_dts + 1;
+        if (packet->pts != AV_NOPTS_VALUE && packet->dts > packet->pts)
+            packet->dts = packet->pts;
+        render->last_dts = packet->dts;
+    }
+
+    write_packet(ctx, packet, NULL);
+}
+
+// The re-encoded packets are delayed like the ones of the source, so the copied B-frames after a re-encoded GOP
+// still find a dts between the last re-encoded one and their own pts
+static void write_encoded_packet(VideoContext *ctx, AVPacket *packet, void *opaque) {
+
+    SmartRender *render = opaque;
+
+    if (packet->pts != AV_NOPTS_VALUE && packet->dts != AV_NOPTS_VALUE)
+        packet->dts = FFMIN(packet->dts, packet->pts - render->dts_delay);
+
+    write_smart_packet(ctx, packet, render);
+}
+
+static void copy_video_packet(VideoContext *ctx, AVPacket *packet, SmartRender *render) {
+    packet->stream_index = ctx->out_video_stream->index;
+    av_packet_rescale_ts(packet, ctx->video_stream->time_base, ctx->out_video_stream->time_base);
+    packet->pos = -1;
+    write_smart_packet(ctx, packet, render);
+}
+
+// Frames of copied GOPs that the decoder produces on the way are dropped
+static void encode_decoded_frames(VideoContext *ctx, FrameSlot *slot, SmartRender *render) {
+
+    while (receive_frame(ctx, slot)) {
+        const int64_t pts = slot->input_frame->best_effort_timestamp;
+        const int index = find_frame_pts(&render->plan->frames, pts);
+        const int gop = find_gop(render->plan, pts);
+        if (index < 0 || gop < 0 || !render->plan->touched[gop])
+            continue;
+
+        // the stack of the frame is loaded from the timeline
+        ctx->data->region_data->frame = index;
+
+        convert_to_rgb(ctx, slot);
+        apply_frame_effect(ctx, slot);
+        convert_to_output(ctx, slot);
+        stats_stop(STATS_FRAME_LATENCY, slot->decoded_at);
+        encode_frame(ctx, slot->encodable, write_encoded_packet, render);
+    }
+}
+
+// Every run of re-encoded GOPs gets a fresh encoder, so it starts with a keyframe and its own codec headers
+static void start_run(VideoContext *ctx, SmartRender *render) {
+
+    if (render->encoder_used) {
+        avcodec_free_context(&ctx->encoder_context);
+        open_encoder(ctx);
+    }
+
+    render->encoder_used = true;
+    render->decoding = true;
+}
+
+static void finish_run(VideoContext *ctx, FrameSlot *slot, SmartRender *render) {
+
+    send_packet(ctx, NULL);
+    encode_decoded_frames(ctx, slot, render);
+    encode_frame(ctx, NULL, write_encoded_packet, render);
+
+    avcodec_flush_buffers(ctx->decoder_context);
+    render->decoding = false;
+}
+
+static void render_gops(VideoContext *ctx, FrameSlot *slot, SmartRender *render) {
+
+    const SmartPlan *plan = render->plan;
+
+    AVPacket packet;
+    int gop = -1;
+    bool keyframe_seen = false;
+    while (read_packet(ctx, &packet) >= 0) {
+        if (packet.stream_index != ctx->video_stream_index) {
+            write_packet(ctx, &packet, NULL);
+            continue;
+        }
+
+        const bool keyframe = packet.flags & AV_PKT_FLAG_KEY;
+        const bool gop_start = next_gop(&gop, &keyframe_seen, keyframe);
+        if (keyframe && packet.pts != AV_NOPTS_VALUE && packet.dts != AV_NOPTS_VALUE)
+            render->dts_delay = av_rescale_q(packet.pts - packet.dts, ctx->video_stream->time_base,
+                                             ctx->out_video_stream->time_base);
+
+        if (gop >= plan->gop_count) {
+            av_packet_unref(&packet);
+            continue;
+        }
+
+        const bool touched = plan->touched[gop];
+        // decoded as reference for the leading frames of the next GOP, but copied
+        const bool preroll = !touched && gop + 1 < plan->gop_count && plan->touched[gop + 1];
+
+        if (gop_start) {
+            if (!touched && render->decoding)
+                finish_run(ctx, slot, render);
+            if ((touched || preroll) && !render->decoding)
+                start_run(ctx, render);
+            if (touched)
+                render->reencoded_gops++;
+        }
+
+        if (render->decoding) {
+            send_packet(ctx, &packet);
+            encode_decoded_frames(ctx, slot, render);
+        }
+
+        if (!touched)
+            copy_video_packet(ctx, &packet, render);
+
+        av_packet_unref(&packet);
+    }
+
+    if (render->decoding)
+        finish_run(ctx, slot, render);
+}
+
+// H.264 and HEVC extradata in Annex B form starts with a start code, those streams repeat the headers in-band
+static bool has_in_band_headers(const AVCodecParameters *codecpar) {
+
+    const uint8_t *extradata = codecpar->extradata;
+    const int size = codecpar->extradata_size;
+
+    if (size == 0)
+        return true;
+
+    return (size >= 3 && extradata[0] == 0 && extradata[1] == 0 && extradata[2] == 1) ||
+           (size >= 4 && extradata[0] == 0 && extradata[1] == 0 && extradata[2] == 0 && extradata[3] == 1);
+}
+
+// The copied GOPs are decoded with the codec headers of the source. If the source repeats them in the stream and
+// the output format keeps them there, every re-encoded GOP brings its own. Otherwise there is only the extradata
+// of the source for the whole output, and the encoder has to produce exactly that, which is checked before
+// anything is written.
+static void open_smart_encoder(VideoContext *ctx, const char *input_file_path, const char *output_file_path) {
+
+    const AVOutputFormat *output_format = guess_output_format(ctx->data, output_file_path);
+
+    const AVCodecParameters *source = ctx->video_stream->codecpar;
+    ctx->global_header = !has_in_band_headers(source) || (output_format->flags & AVFMT_GLOBALHEADER);
+
+    open_encoder(ctx);
+
+    if (!ctx->global_header)
+        return;
+
+    const AVCodecContext *encoder_context = ctx->encoder_context;
+    const bool same = encoder_context->extradata_size == source->extradata_size &&
+                      (source->extradata_size == 0 ||
+                       memcmp(encoder_context->extradata, source->extradata, source->extradata_size) == 0);
+    if (!same) {
+        const char *hint = has_in_band_headers(source)
+                           ? "Write a format that keeps them in the stream, e.g. " DEFAULT_PIPE_FORMAT ", or process "
+                             "the video without --smart-render"
+                           : "Process the video without --smart-render";
+        fail_job("The %s encoder writes other codec headers than '%s' has, the copied GOPs could not be decoded. %s",
+                 encoder_context->codec->name, input_file_path, hint);
+    }
+}
+
+void process_video_smart(const char *input_file_path, const char *output_file_path, Config *data) {
+
+    SmartPlan plan = { 0 };
+    scan_frames(input_file_path, data, &plan);
+
+    if (plan.gop_count == 0) {
+        free_frame_list(&plan.frames);
+        free(plan.packet);
+        fail_job("No video keyframes found in '%s'", input_file_path);
+    }
+
+    // an imported timeline is used as it is unless it has to be recorded for --export-timeline as well
+    Timeline planned;
+    const Timeline *timeline = data->timeline;
+    if (timeline == NULL || data->recorded_timeline != NULL) {
+        Timeline *target = data->recorded_timeline;
+        if (target == NULL) {
+            init_timeline(&planned, 0, 0, data->effect_id, data->seed);
+            target = &planned;
+        }
+        plan_frames(&plan, data, target);
+        timeline = target;
+    }
+
+    Regions regions = { .region_pair = NULL, .size = 0, .seed = data->seed };
+
+    Config render_data = *data;
+    render_data.region_data = &regions;
+    render_data.timeline = timeline;
+    render_data.recorded_timeline = NULL;
+    render_data.buffer = NULL;
+    render_data.buffer_size = 0;
+    render_data.scale_cache = NULL;
+
+    VideoContext ctx = { .data = &render_data };
+    open_input(&ctx, input_file_path);
+    open_smart_encoder(&ctx, input_file_path, output_file_path);
+    open_output(&ctx, output_file_path);
+
+    mark_touched_gops(&plan, data, ctx.video_stream, timeline);
+
+    SmartRender render = {
+        .plan = &plan,
+        .decoding = false,
+        .encoder_used = false,
+        .reencoded_gops = 0,
+        .last_dts = AV_NOPTS_VALUE,
+        .dts_delay = 0
+    };
+
+    FrameSlot slot;
+    alloc_frame_slot(&ctx, &slot);
+
+    render_gops(&ctx, &slot, &render);
+
+    free_frame_slot(&slot);
+    close_video_context(&ctx);
+
+    FILE *info = is_pipe_path(output_file_path) ? stderr : stdout;
+    fprintf(info, "[INFO] Smart rendering re-encoded %d of %d GOPs\n", render.reencoded_gops, plan.gop_count);
+
+    if (timeline == &planned)
+        free_timeline(&planned);
+
+    cleanup_regions(&regions);
+    free(render_data.buffer);
+    free_scale_cache(render_data.scale_cache);
+    free(plan.touched);
+    free_frame_list(&plan.frames);
+    free(plan.packet);
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include "video-effects.h"
+
+// Smart rendering: a demux-only pass finds the GOPs that contain a frame the effect modifies, i.e. a frame within
+// --start/--end with regions on its planned stack. The frames are the ones the decoder outputs, without the leading
+// B-frames of an open GOP at the start. Only those GOPs are decoded, processed and re-encoded, with the
+// parameters of the source and without B-frames, every other GOP is stream-copied packet by packet. The GOP before
+// a re-encoded one is decoded as well, so frames referencing it across the GOP border are complete. Sources
+// without codec headers in the stream, or outputs that keep them out of it, are only accepted if the encoder
+// writes the extradata of the source.
+// The frames match a run with the same seed and without --smart-render.
+void process_video_smart(const char *input_file_path, const char *output_file_path, Config *data);
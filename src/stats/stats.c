@@ -0,0 +1,281 @@
+#include "stats.h"
+#include "video-effects.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+
+// Latencies are kept in log-linear buckets: 8 sub-buckets per power of two, i.e. within 12.5%
+#define SUB_BUCKET_BITS 3
+#define SUB_BUCKETS (1 << SUB_BUCKET_BITS)
+#define BUCKET_COUNT (64 * SUB_BUCKETS)
+
+typedef struct TimerStats {
+    uint64_t count;
+    uint64_t total;
+    uint64_t max;
+    uint64_t bucket[BUCKET_COUNT];
+} TimerStats;
+
+bool stats_enabled = false;
+
+typedef struct QueueStats {
+    int high_water;
+    int capacity;
+} QueueStats;
+
+static TimerStats timers[STATS_TIMER_COUNT];
+static QueueStats queues[STATS_QUEUE_COUNT];
+static uint64_t allocated_bytes;
+static uint64_t allocation_count;
+// allocations after the first frame reached the encoder, i.e. in the steady state of the run
+static uint64_t steady_allocations;
+static int64_t run_started;
+static int64_t first_output_at;
+
+static const char *timer_names[STATS_TIMER_COUNT] = {
+    [STATS_DEMUX] = "demux",
+    [STATS_DECODE_SEND] = "decode_send_packet",
+    [STATS_DECODE_RECEIVE] = "decode_receive_frame",
+    [STATS_SWS_TO_RGB] = "sws_scale_to_rgb",
+    [STATS_PLAN] = "plan_frame",
+    [STATS_EFFECT] = "effect",
+    [STATS_EFFECT_REGION_SCALING] = "effect_region_scaling",
+    [STATS_EFFECT_REGION_SWAP] = "effect_region_swap",
+    [STATS_EFFECT_REGION_MOVE] = "effect_region_move",
+    [STATS_EFFECT_PLUGIN] = "effect_plugin",
+    [STATS_REGION_SCALE] = "region_scale",
+    [STATS_REGION_SWAP] = "region_swap",
+    [STATS_REGION_MOVE] = "region_move",
+    [STATS_SWS_TO_OUTPUT] = "sws_scale_to_output",
+    [STATS_ENCODE] = "encode",
+    [STATS_MUX] = "mux",
+    [STATS_WRITER_QUEUE_FULL] = "writer_queue_full",
+    [STATS_OUTPUT_WRITE] = "output_write",
+    [STATS_OUTPUT_SYNC] = "output_sync",
+    [STATS_FRAME_LATENCY] = "frame_latency",
+    [STATS_REALTIME_LATENCY] = "realtime_latency"
+};
+
+static const char *queue_names[STATS_QUEUE_COUNT] = {
+    [STATS_QUEUE_MUX] = "pipeline_mux",
+    [STATS_QUEUE_WRITER] = "writer"
+};
+
+int64_t stats_now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static int bucket_index(const uint64_t value) {
+
+    if (value < SUB_BUCKETS)
+        return (int) value;
+
+    const int exponent = 63 - __builtin_clzll(value);
+    const int sub_bucket = (int) ((value >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1));
+
+    return (exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + sub_bucket;
+}
+
+// Upper end of a bucket, percentiles are reported with that resolution
+static uint64_t bucket_limit(const int index) {
+
+    if (index < SUB_BUCKETS)
+        return index;
+
+    const int exponent = index / SUB_BUCKETS + SUB_BUCKET_BITS - 1;
+    const uint64_t sub_bucket = index % SUB_BUCKETS;
+
+    return ((SUB_BUCKETS + sub_bucket + 1) << (exponent - SUB_BUCKET_BITS)) - 1;
+}
+
+// Called from several threads (pipeline stages, segments), the counters are updated atomically
+void stats_record(const StatsTimer timer, const int64_t nanoseconds) {
+
+    TimerStats *stats = &timers[timer];
+    const uint64_t value = nanoseconds > 0 ? (uint64_t) nanoseconds : 0;
+
+    __atomic_fetch_add(&stats->count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stats->total, value, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stats->bucket[bucket_index(value)], 1, __ATOMIC_RELAXED);
+
+    uint64_t max = __atomic_load_n(&stats->max, __ATOMIC_RELAXED);
+    while (value > max && !__atomic_compare_exchange_n(&stats->max, &max, value, true, __ATOMIC_RELAXED,
+                                                       __ATOMIC_RELAXED)) {
+    }
+}
+
+void stats_add_allocation(const size_t bytes) {
+
+    if (!stats_enabled)
+        return;
+
+    __atomic_fetch_add(&allocated_bytes, bytes, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&allocation_count, 1, __ATOMIC_RELAXED);
+    if (__atomic_load_n(&timers[STATS_FRAME_LATENCY].count, __ATOMIC_RELAXED) > 0)
+        __atomic_fetch_add(&steady_allocations, 1, __ATOMIC_RELAXED);
+}
+
+void stats_queue_high_water(const StatsQueue queue, const int high_water, const int capacity) {
+
+    if (!stats_enabled)
+        return;
+
+    QueueStats *stats = &queues[queue];
+    int max = __atomic_load_n(&stats->high_water, __ATOMIC_RELAXED);
+    while (high_water > max && !__atomic_compare_exchange_n(&stats->high_water, &max, high_water, true,
+                                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+    __atomic_store_n(&stats->capacity, capacity, __ATOMIC_RELAXED);
+}
+
+uint64_t get_steady_allocations(void) {
+    return steady_allocations;
+}
+
+uint64_t get_stats_count(const StatsTimer timer) {
+    return timers[timer].count;
+}
+
+uint64_t get_stats_total(const StatsTimer timer) {
+    return timers[timer].total;
+}
+
+const char *get_stats_timer_name(const StatsTimer timer) {
+    return timer_names[timer];
+}
+
+int64_t stats_begin_run(void) {
+    run_started = stats_start();
+    first_output_at = 0;
+    return run_started;
+}
+
+void stats_output_written(void) {
+
+    if (!stats_enabled || __atomic_load_n(&first_output_at, __ATOMIC_RELAXED) != 0)
+        return;
+
+    int64_t expected = 0;
+    __atomic_compare_exchange_n(&first_output_at, &expected, stats_now(), false, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+}
+
+void stats_reset(void) {
+    memset(timers, 0, sizeof(timers));
+    memset(queues, 0, sizeof(queues));
+    allocated_bytes = 0;
+    allocation_count = 0;
+    steady_allocations = 0;
+    first_output_at = 0;
+}
+
+static uint64_t percentile(const TimerStats *stats, const double fraction) {
+
+    const uint64_t rank = (uint64_t) (fraction * (double) stats->count + 0.5);
+    uint64_t seen = 0;
+
+    for (int i = 0; i < BUCKET_COUNT; i++) {
+        seen += stats->bucket[i];
+        if (seen >= rank && seen > 0)
+            return bucket_limit(i) < stats->max ? bucket_limit(i) : stats->max;
+    }
+
+    return stats->max;
+}
+
+uint64_t get_stats_percentile(const StatsTimer timer, const double fraction) {
+    return percentile(&timers[timer], fraction);
+}
+
+static long long peak_rss_bytes(void) {
+
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return -1;
+
+#ifdef __APPLE__
+    return usage.ru_maxrss;
+#else
+    return (long long) usage.ru_maxrss * 1024;
+#endif
+}
+
+static void write_json_string(FILE *file, const char *value) {
+
+    fputc('"', file);
+    for (const char *c = value; c != NULL && *c != '\0'; c++) {
+        if (*c == '"' || *c == '\\')
+            fprintf(file, "\\%c", *c);
+        else if ((unsigned char) *c < 0x20)
+            fprintf(file, "\\u%04x", (unsigned char) *c);
+        else
+            fputc(*c, file);
+    }
+    fputc('"', file);
+}
+
+static void write_timer(FILE *file, const TimerStats *stats) {
+    fprintf(file, "{\"count\": %llu, \"total_ms\": %.3f, \"mean_us\": %.3f, \"p50_us\": %.3f, \"p99_us\": %.3f, "
+                  "\"max_us\": %.3f}",
+            (unsigned long long) stats->count,
+            stats->total / 1e6,
+            stats->count > 0 ? stats->total / 1e3 / stats->count : 0.0,
+            percentile(stats, 0.5) / 1e3,
+            percentile(stats, 0.99) / 1e3,
+            stats->max / 1e3);
+}
+
+void write_stats_report(const char *file_path, const char *input_file, const char *output_file,
+                        const char *filter_name, const int64_t wall_time) {
+
+    FILE *file = fopen(file_path, "w");
+    if (file == NULL) {
+        fail_job("Could not open '%s' for writing", file_path);
+    }
+
+    const uint64_t frames = timers[STATS_FRAME_LATENCY].count;
+    const double seconds = wall_time / 1e9;
+
+    fprintf(file, "{\n  \"version\": 1,\n  \"input\": ");
+    write_json_string(file, input_file);
+    fprintf(file, ",\n  \"output\": ");
+    write_json_string(file, output_file);
+    fprintf(file, ",\n  \"filter\": ");
+    write_json_string(file, filter_name);
+    fprintf(file, ",\n  \"wall_time_ms\": %.3f,\n", wall_time / 1e6);
+    fprintf(file, "  \"frames\": %llu,\n", (unsigned long long) frames);
+    fprintf(file, "  \"fps\": %.3f,\n", seconds > 0 ? frames / seconds : 0.0);
+    fprintf(file, "  \"peak_rss_bytes\": %lld,\n", peak_rss_bytes());
+    fprintf(file, "  \"allocated_bytes\": %llu,\n", (unsigned long long) allocated_bytes);
+    fprintf(file, "  \"allocations\": %llu,\n", (unsigned long long) allocation_count);
+    fprintf(file, "  \"steady_state_allocations\": %llu,\n", (unsigned long long) steady_allocations);
+    // only known for outputs written to a pipe
+    if (run_started != 0 && first_output_at != 0)
+        fprintf(file, "  \"time_to_first_byte_ms\": %.3f,\n", (first_output_at - run_started) / 1e6);
+    else
+        fprintf(file, "  \"time_to_first_byte_ms\": null,\n");
+    fprintf(file, "  \"queues\": {\n");
+
+    for (int i = 0; i < STATS_QUEUE_COUNT; i++) {
+        fprintf(file, "    \"%s\": {\"high_water\": %d, \"capacity\": %d}%s\n", queue_names[i],
+                queues[i].high_water, queues[i].capacity, i + 1 < STATS_QUEUE_COUNT ? "," : "");
+    }
+
+    fprintf(file, "  },\n  \"timers\": {\n");
+
+    for (int i = 0; i < STATS_TIMER_COUNT; i++) {
+        fprintf(file, "    \"%s\": ", timer_names[i]);
+        write_timer(file, &timers[i]);
+        fprintf(file, i + 1 < STATS_TIMER_COUNT ? ",\n" : "\n");
+    }
+
+    fprintf(file, "  }\n}\n");
+
+    if (ferror(file) || fclose(file) != 0) {
+        fail_job("Could not write the stats report to '%s'", file_path);
+    }
+}
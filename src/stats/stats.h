@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum StatsTimer {
+    STATS_DEMUX = 0,
+    STATS_DECODE_SEND,
+    STATS_DECODE_RECEIVE,
+    STATS_SWS_TO_RGB,
+    STATS_PLAN,
+    STATS_EFFECT,
+    STATS_EFFECT_REGION_SCALING,
+    STATS_EFFECT_REGION_SWAP,
+    STATS_EFFECT_REGION_MOVE,
+    // all effects loaded with --plugin
+    STATS_EFFECT_PLUGIN,
+    STATS_REGION_SCALE,
+    STATS_REGION_SWAP,
+    STATS_REGION_MOVE,
+    STATS_SWS_TO_OUTPUT,
+    STATS_ENCODE,
+    STATS_MUX,
+    // producers waiting for room in the queue of the output writer, see io/writer.h
+    STATS_WRITER_QUEUE_FULL,
+    // write() and fdatasync() of the output files
+    STATS_OUTPUT_WRITE,
+    STATS_OUTPUT_SYNC,
+    // from the decoded frame to the encoder
+    STATS_FRAME_LATENCY,
+    // --realtime, from when a frame was due at the input until it left the encoder
+    STATS_REALTIME_LATENCY,
+    STATS_TIMER_COUNT
+} StatsTimer;
+
+// Bounded queues whose fill level is reported
+typedef enum StatsQueue {
+    // encoded and stream-copied packets of the pipeline waiting for the muxer
+    STATS_QUEUE_MUX = 0,
+    // muxed packets waiting for the output writer
+    STATS_QUEUE_WRITER,
+    STATS_QUEUE_COUNT
+} StatsQueue;
+
+// Set once before processing starts, every timer below is a single branch when it is false
+extern bool stats_enabled;
+
+int64_t stats_now(void);
+void stats_record(StatsTimer timer, int64_t nanoseconds);
+// Counts a heap allocation of frames, region stacks or scratch memory, see get_steady_allocations()
+void stats_add_allocation(size_t bytes);
+
+// Returns 0 when the stats are disabled, stats_stop() ignores those starts
+static inline int64_t stats_start(void) {
+    return stats_enabled ? stats_now() : 0;
+}
+
+static inline void stats_stop(const StatsTimer timer, const int64_t start) {
+    if (start != 0)
+        stats_record(timer, stats_now() - start);
+}
+
+// Called when a queue is destroyed, the report keeps the highest fill level of all queues of the kind
+void stats_queue_high_water(StatsQueue queue, int high_water, int capacity);
+
+// Totals of the timers and their names as used in the report, e.g. for the benchmarks
+uint64_t get_stats_count(StatsTimer timer);
+uint64_t get_stats_total(StatsTimer timer);
+const char *get_stats_timer_name(StatsTimer timer);
+// Upper end of the latency bucket the fraction of the measurements lies in, in nanoseconds
+uint64_t get_stats_percentile(StatsTimer timer, double fraction);
+// Allocations counted after the first frame was processed, 0 once all buffers are sized
+uint64_t get_steady_allocations(void);
+
+// Marks the start of the run that time_to_first_byte is measured from, returns stats_start()
+int64_t stats_begin_run(void);
+// Called for every write to a piped output, only the first one is kept
+void stats_output_written(void);
+
+// Clears all timers and the allocation counter, not while frames are being processed
+void stats_reset(void);
+
+// Writes the run report for --stats-json, wall_time is in nanoseconds
+void write_stats_report(const char *file_path, const char *input_file, const char *output_file,
+                        const char *filter_name, int64_t wall_time);
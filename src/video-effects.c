@@ -2,48 +2,141 @@
 #include "cmdline.h"
 #include "effect.h"
 
+#include "pipeline/pipeline.h"
+#include "segment/segment.h"
+#include "fanout/fanout.h"
+#include "smart/smart.h"
+#include "region/timeline.h"
+#include "stats/stats.h"
+#include "io/mmap_input.h"
+#include "io/output_file.h"
+#include "io/writer.h"
+#include "realtime/realtime.h"
+#include "index/index.h"
+
+#include <errno.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include <libavformat/avformat.h>
 #include <libavcodec/avcodec.h>
 #include <libavutil/avutil.h>
 #include <libswscale/swscale.h>
 #include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+#include <libavutil/opt.h>
+
+// Batch jobs are reported here and in the results file, everything else ends the process
+void report_job_failure(const char *message, const bool recoverable) {
+
+    fprintf(stderr, "[ERROR] %s\n", message);
+
+    if (!recoverable)
+        exit(EXIT_FAILURE);
+}
+
+bool is_pipe_path(const char *path) {
+    return strcmp(path, PIPE_PATH) == 0;
+}
+
+static int read_stdin(void *opaque, uint8_t *buffer, const int size) {
+
+    ssize_t bytes;
+    do {
+        bytes = read(STDIN_FILENO, buffer, size);
+    } while (bytes < 0 && errno == EINTR);
 
-static const unsigned int max_error_message_size = 64;
+    if (bytes < 0)
+        return AVERROR(errno);
 
-void check_av_error_positive(int err, const char *file_name, const char *function_name, int line) {
-    if (err < 0) {
-        char err_message[max_error_message_size];
-        fprintf(stderr, 
-                "AVError returned %d: %s in file %s %s line %d\n", 
-                err, 
-                av_make_error_string(err_message, max_error_message_size, err),
-                file_name,
-                function_name,
-                line);
-        exit(-1);
-	}
+    return bytes == 0 ? AVERROR_EOF : (int) bytes;
 }
 
-void check_not_null(const void* ptr, const char *file_name, const char *function_name, int line) {
-    if (ptr == NULL) {
-        fprintf(stderr, 
-                "Nullpointer in file %s in function %s line %d\n",
-                file_name,
-                function_name,
-                line);
-        exit(-1);
+// the write callback lost its non-const buffer with libavformat 61
+#if LIBAVFORMAT_VERSION_MAJOR < 61
+static int write_stdout(void *opaque, uint8_t *buffer, const int size) {
+#else
+static int write_stdout(void *opaque, const uint8_t *buffer, const int size) {
+#endif
+
+    stats_output_written();
+
+    int written = 0;
+    while (written < size) {
+        const ssize_t bytes = write(STDOUT_FILENO, buffer + written, size - written);
+        if (bytes < 0 && errno == EINTR)
+            continue;
+        if (bytes < 0)
+            return AVERROR(errno);
+        written += (int) bytes;
     }
+
+    return written;
 }
 
-void process_video(const char *input_file_path, const char *output_file_path, Config *data) {
-    
+// Neither stdin nor stdout can seek, the demuxer and muxer only see a stream of bytes
+static AVIOContext *open_pipe_io(const bool write, const int buffer_size) {
+
+    uint8_t *buffer = av_malloc(buffer_size);
+    NOT_NULL(buffer);
+
+    AVIOContext *io = avio_alloc_context(buffer, buffer_size, write, NULL, write ? NULL : read_stdin,
+                                         write ? write_stdout : NULL, NULL);
+    if (io == NULL)
+        av_free(buffer);
+    NOT_NULL(io);
+
+    io->seekable = 0;
+    return io;
+}
+
+static void close_pipe_io(AVIOContext **io) {
+
+    if (*io == NULL)
+        return;
+
+    if ((*io)->write_flag)
+        avio_flush(*io);
+
+    av_freep(&(*io)->buffer);
+    avio_context_free(io);
+}
+
+void open_input(VideoContext *ctx, const char *input_file_path) {
+
     av_log_set_level(AV_LOG_ERROR);
     AVFormatContext *input_format_context = NULL;
-    AVFormatContext *output_format_context = NULL;
-     
-    AV_NOT_NEGATIVE(avformat_open_input(&input_format_context, input_file_path, NULL, NULL));
-    AV_NOT_NEGATIVE(avformat_find_stream_info(input_format_context, NULL));
+
+    if (is_pipe_path(input_file_path)) {
+        input_format_context = avformat_alloc_context();
+        NOT_NULL(input_format_context);
+        ctx->input_io = open_pipe_io(false, ctx->data->io_buffer_size);
+        input_format_context->pb = ctx->input_io;
+        input_format_context->flags |= AVFMT_FLAG_CUSTOM_IO;
+    }
+    else if (!ctx->data->no_mmap && (ctx->input_io = open_mapped_input(input_file_path)) != NULL) {
+        ctx->input_mapped = true;
+        input_format_context = avformat_alloc_context();
+        NOT_NULL(input_format_context);
+        input_format_context->pb = ctx->input_io;
+        input_format_context->flags |= AVFMT_FLAG_CUSTOM_IO;
+    }
+
+    // frees the format context on failure, but not the custom I/O context
+    AV_NOT_NEGATIVE(avformat_open_input(&input_format_context, is_pipe_path(input_file_path) ? "pipe:" : input_file_path,
+                                        NULL, NULL));
+    // stored right away, so close_video_streams() also releases a partially opened input
+    ctx->input_format_context = input_format_context;
+
+    // live inputs: packets are not held back while the streams are probed
+    if (ctx->data->realtime)
+        input_format_context->flags |= AVFMT_FLAG_NOBUFFER;
+
+    // the index has the parameters the probing would find, unless the file has other streams than it was built for
+    const VideoIndex *index = ctx->data->index;
+    if (index == NULL || !apply_index(index, input_format_context))
+        AV_NOT_NEGATIVE(avformat_find_stream_info(input_format_context, NULL));
     
     const int video_stream_index = av_find_best_stream(input_format_context, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
     AV_NOT_NEGATIVE(video_stream_index);
@@ -55,11 +148,237 @@ void process_video(const char *input_file_path, const char *output_file_path, Co
 
     AVCodecContext *decoder_context = avcodec_alloc_context3(video_decoder);
     NOT_NULL(decoder_context);
+    ctx->decoder_context = decoder_context;
     AV_NOT_NEGATIVE(avcodec_parameters_to_context(decoder_context, video_stream->codecpar));
     AV_NOT_NEGATIVE(avcodec_open2(decoder_context, video_decoder, NULL));
 
+    ctx->video_stream = video_stream;
+    ctx->video_stream_index = video_stream_index;
+}
+
+// Whole frame conversion. With threads > 1 libswscale converts horizontal slices of the frame on its own threads,
+// which gives the same output as one thread. Separate contexts per band would not, the chroma interpolation at the
+// band edges would change.
+static struct SwsContext *create_frame_sws_context(const int source_width, const int source_height,
+                                                   const enum AVPixelFormat source_format,
+                                                   const int destination_width, const int destination_height,
+                                                   const enum AVPixelFormat destination_format, const int threads) {
 
-    AV_NOT_NEGATIVE(avformat_alloc_output_context2(&output_format_context, NULL, NULL, output_file_path));
+    struct SwsContext *context = sws_alloc_context();
+    NOT_NULL(context);
+
+    AV_NOT_NEGATIVE(av_opt_set_int(context, "srcw", source_width, 0));
+    AV_NOT_NEGATIVE(av_opt_set_int(context, "srch", source_height, 0));
+    AV_NOT_NEGATIVE(av_opt_set_int(context, "src_format", source_format, 0));
+    AV_NOT_NEGATIVE(av_opt_set_int(context, "dstw", destination_width, 0));
+    AV_NOT_NEGATIVE(av_opt_set_int(context, "dsth", destination_height, 0));
+    AV_NOT_NEGATIVE(av_opt_set_int(context, "dst_format", destination_format, 0));
+    AV_NOT_NEGATIVE(av_opt_set_int(context, "sws_flags", SWS_BICUBIC, 0));
+
+    // the option exists since libswscale 6.1, older versions simply convert on the calling thread
+    if (threads > 1)
+        av_opt_set_int(context, "threads", threads, 0);
+
+    AV_NOT_NEGATIVE(sws_init_context(context, NULL, NULL));
+
+    return context;
+}
+
+static bool same_conversion(const FrameConversion *a, const FrameConversion *b) {
+    return a->width == b->width && a->height == b->height && a->scaled_width == b->scaled_width &&
+           a->scaled_height == b->scaled_height && a->decoded_format == b->decoded_format &&
+           a->working_format == b->working_format && a->output_format == b->output_format &&
+           a->threads == b->threads;
+}
+
+// The re-encoded GOPs of smart rendering sit between stream-copied ones and have to look like them to the decoder
+static void match_source_parameters(AVCodecContext *encoder_context, const AVCodecParameters *source) {
+
+    encoder_context->bit_rate = source->bit_rate;
+    encoder_context->profile = source->profile;
+    encoder_context->level = source->level;
+    encoder_context->sample_aspect_ratio = source->sample_aspect_ratio;
+    encoder_context->field_order = source->field_order;
+    encoder_context->color_range = source->color_range;
+    encoder_context->color_primaries = source->color_primaries;
+    encoder_context->color_trc = source->color_trc;
+    encoder_context->colorspace = source->color_space;
+    encoder_context->chroma_sample_location = source->chroma_location;
+
+    // packets are joined in decode order, the copied GOPs keep their B-frames
+    encoder_context->max_b_frames = 0;
+}
+
+// Every packet leaves the encoder together with its frame: no B-frames, no lookahead, no frame threads
+static void configure_realtime_encoder(AVCodecContext *encoder_context, const AVCodec *encoder,
+                                       AVDictionary **options) {
+
+    encoder_context->max_b_frames = 0;
+    encoder_context->flags |= AV_CODEC_FLAG_LOW_DELAY;
+    encoder_context->thread_type = FF_THREAD_SLICE;
+
+    if (strcmp(encoder->name, "libx264") == 0 || strcmp(encoder->name, "libx265") == 0) {
+        AV_NOT_NEGATIVE(av_dict_set(options, "tune", "zerolatency", 0));
+    }
+    else if (strncmp(encoder->name, "libvpx", 6) == 0) {
+        AV_NOT_NEGATIVE(av_dict_set(options, "deadline", "realtime", 0));
+        AV_NOT_NEGATIVE(av_dict_set(options, "lag-in-frames", "0", 0));
+    }
+}
+
+// Even, so the chroma planes of 4:2:0 encoders are not rounded
+static int get_preview_size(const int size, const int preview_scale) {
+    return FFMAX(2, (size / preview_scale) & ~1);
+}
+
+// A preview is about the look of the effect, not the quality of the encoding
+static void configure_preview_encoder(const AVCodec *encoder, AVDictionary **options) {
+
+    if (strcmp(encoder->name, "libx264") == 0 || strcmp(encoder->name, "libx265") == 0) {
+        AV_NOT_NEGATIVE(av_dict_set(options, "preset", "ultrafast", 0));
+    }
+    else if (strncmp(encoder->name, "libvpx", 6) == 0) {
+        AV_NOT_NEGATIVE(av_dict_set(options, "deadline", "realtime", 0));
+        AV_NOT_NEGATIVE(av_dict_set(options, "cpu-used", "8", 0));
+    }
+}
+
+void open_encoder(VideoContext *ctx) {
+
+    const AVCodecContext *decoder_context = ctx->decoder_context;
+    const AVStream *video_stream = ctx->video_stream;
+
+    const AVCodec *video_encoder = avcodec_find_encoder(video_stream->codecpar->codec_id);
+    NOT_NULL(video_encoder);
+
+    AVCodecContext *encoder_context = avcodec_alloc_context3(video_encoder);
+    NOT_NULL(encoder_context);
+    ctx->encoder_context = encoder_context;
+    
+    // --preview-scale encodes smaller frames, the regions are still planned for the source size
+    const bool preview = ctx->data->preview_scale > 1;
+    ctx->data->source_width = decoder_context->width;
+    ctx->data->source_height = decoder_context->height;
+
+    encoder_context->height = preview ? get_preview_size(decoder_context->height, ctx->data->preview_scale)
+                                      : decoder_context->height;
+    encoder_context->width = preview ? get_preview_size(decoder_context->width, ctx->data->preview_scale)
+                                     : decoder_context->width;
+    encoder_context->pix_fmt = video_encoder->pix_fmts[0];
+
+    // keep the decoded format when the encoder accepts it, then the effects either work on the decoded planes
+    // directly or only the dirty regions are converted to RGB and back
+    bool same_format = false;
+    for (const enum AVPixelFormat *format = video_encoder->pix_fmts; *format != AV_PIX_FMT_NONE; format++)
+        same_format |= *format == decoder_context->pix_fmt;
+
+    // the effects tell which of those paths they support, the others always get whole RGB frames
+    const unsigned int capabilities = get_chain_capabilities(ctx->data);
+
+    // a preview is scaled by the conversion to RGB, so it always takes that path
+    ctx->native_yuv = same_format && !preview && !ctx->data->force_rgb && (capabilities & EFFECT_PLANAR_YUV) &&
+                      is_native_format(decoder_context->pix_fmt);
+    ctx->dirty_regions = same_format && !preview && !ctx->native_yuv && !ctx->data->full_frame &&
+                         (capabilities & EFFECT_IN_PLACE) && supports_dirty_regions(decoder_context->pix_fmt);
+
+    if (ctx->native_yuv || ctx->dirty_regions)
+        encoder_context->pix_fmt = decoder_context->pix_fmt;
+
+    encoder_context->time_base = video_stream->time_base;
+
+    // segments are concatenated packet by packet, which needs decode order == presentation order
+    if (ctx->data->segments > 1)
+        encoder_context->max_b_frames = 0;
+
+    if (ctx->data->smart_render) {
+        if (!same_format)
+            fail_job("Smart rendering needs an encoder for %s frames", av_get_pix_fmt_name(decoder_context->pix_fmt));
+        encoder_context->pix_fmt = decoder_context->pix_fmt;
+        match_source_parameters(encoder_context, video_stream->codecpar);
+    }
+
+    if (ctx->global_header)
+        encoder_context->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+
+    AVDictionary *options = NULL;
+    if (ctx->data->realtime)
+        configure_realtime_encoder(encoder_context, video_encoder, &options);
+    if (preview)
+        configure_preview_encoder(video_encoder, &options);
+
+    const int ret = avcodec_open2(encoder_context, video_encoder, &options);
+    av_dict_free(&options);
+    AV_NOT_NEGATIVE(ret);
+
+    // planes are copied one at a time, the luma plane is the largest
+    const int pixel_step = ctx->native_yuv ? 1 : (ctx->data->working_format == WORKING_FORMAT_RGB0 ? 4 : 3);
+    reserve_chain_scratch(ctx->data, encoder_context->width, encoder_context->height, pixel_step);
+
+    if (ctx->native_yuv)
+        return;
+
+    ctx->working_format = ctx->data->working_format == WORKING_FORMAT_RGB0 ? AV_PIX_FMT_RGB0 : AV_PIX_FMT_RGB24;
+
+    const FrameConversion conversion = {
+        .width = decoder_context->width,
+        .height = decoder_context->height,
+        .scaled_width = encoder_context->width,
+        .scaled_height = encoder_context->height,
+        .decoded_format = decoder_context->pix_fmt,
+        .working_format = ctx->working_format,
+        .output_format = encoder_context->pix_fmt,
+        .threads = get_frame_band_count(ctx->data->pool, decoder_context->height)
+    };
+
+    // contexts left by a previous input of a batch worker are reused if nothing changed
+    if (ctx->input_format_to_rgb_sws_context != NULL && same_conversion(&ctx->conversion, &conversion))
+        return;
+
+    sws_freeContext(ctx->input_format_to_rgb_sws_context);
+    sws_freeContext(ctx->rgb_to_output_format_sws_context);
+
+    ctx->input_format_to_rgb_sws_context = create_frame_sws_context(conversion.width, conversion.height,
+                                                                    conversion.decoded_format,
+                                                                    encoder_context->width, encoder_context->height,
+                                                                    conversion.working_format, conversion.threads);
+
+    ctx->rgb_to_output_format_sws_context = create_frame_sws_context(conversion.scaled_width,
+                                                                     conversion.scaled_height,
+                                                                     conversion.working_format,
+                                                                     encoder_context->width, encoder_context->height,
+                                                                     conversion.output_format, conversion.threads);
+
+    ctx->conversion = conversion;
+}
+
+const AVOutputFormat *guess_output_format(const Config *data, const char *output_file_path) {
+
+    const bool pipe = is_pipe_path(output_file_path);
+    const char *format_name = data->output_format;
+    if (pipe && format_name == NULL)
+        format_name = DEFAULT_PIPE_FORMAT;
+
+    const AVOutputFormat *output_format = av_guess_format(format_name, pipe ? NULL : output_file_path, NULL);
+    if (output_format == NULL)
+        fail_job("Could not find an output format for '%s'", output_file_path);
+
+    return output_format;
+}
+
+// Creates one output stream per input stream, the non-video streams are stream-copied
+void open_output(VideoContext *ctx, const char *output_file_path) {
+
+    AVFormatContext *input_format_context = ctx->input_format_context;
+    AVFormatContext *output_format_context = NULL;
+
+    const bool pipe = is_pipe_path(output_file_path);
+    const char *format_name = ctx->data->output_format;
+    if (pipe && format_name == NULL)
+        format_name = DEFAULT_PIPE_FORMAT;
+
+    AV_NOT_NEGATIVE(avformat_alloc_output_context2(&output_format_context, NULL, format_name,
+                                                   pipe ? NULL : output_file_path));
+    ctx->output_format_context = output_format_context;
     
     AVStream *out_video_stream = NULL;
     for (int i = 0; i < input_format_context->nb_streams; ++i){
@@ -76,171 +395,555 @@ void process_video(const char *input_file_path, const char *output_file_path, Co
     
     NOT_NULL(out_video_stream);
 
-    const AVCodec *video_encoder = avcodec_find_encoder(video_stream->codecpar->codec_id);
-    NOT_NULL(video_encoder);
+    // with smart rendering most video packets are copied, they need the parameters of the source
+    if (ctx->data->smart_render) {
+        AV_NOT_NEGATIVE(avcodec_parameters_copy(out_video_stream->codecpar, ctx->video_stream->codecpar));
+        out_video_stream->codecpar->codec_tag = 0;
+    }
+    else {
+        AV_NOT_NEGATIVE(avcodec_parameters_from_context(out_video_stream->codecpar, ctx->encoder_context));
+    }
+    out_video_stream->time_base = ctx->encoder_context->time_base;
 
-    AVCodecContext *encoder_context = avcodec_alloc_context3(video_encoder);
-    NOT_NULL(encoder_context);
-    
-    encoder_context->height = decoder_context->height;
-    encoder_context->width = decoder_context->width;
-    encoder_context->pix_fmt = video_encoder->pix_fmts[0];
-    encoder_context->time_base = video_stream->time_base;
+    AVDictionary *options = NULL;
+    if (pipe) {
+        ctx->output_io = open_pipe_io(true, ctx->data->io_buffer_size);
+        output_format_context->pb = ctx->output_io;
+        output_format_context->flags |= AVFMT_FLAG_CUSTOM_IO;
+
+        // hand every packet to the pipe right away instead of when the buffer is full
+        output_format_context->flush_packets = 1;
+
+        // MP4 and MOV seek back to the moov atom, fragments at every keyframe are written once the GOP is complete
+        if (output_format_context->priv_data != NULL &&
+            av_opt_find(output_format_context->priv_data, "movflags", NULL, 0, 0) != NULL)
+            AV_NOT_NEGATIVE(av_dict_set(&options, "movflags", "frag_keyframe+empty_moov+default_base_moof", 0));
+    }
+    else if (is_local_output(output_file_path)) {
+        ctx->output_io = open_output_file(output_file_path, ctx->data->io_buffer_size, ctx->data->sync_bytes);
+        ctx->output_buffered = true;
+        output_format_context->pb = ctx->output_io;
+        output_format_context->flags |= AVFMT_FLAG_CUSTOM_IO;
+    }
+    else {
+        // network outputs, closed with avio_closep() in close_video_streams()
+        AV_NOT_NEGATIVE(avio_open2(&output_format_context->pb, output_file_path, AVIO_FLAG_WRITE, NULL, NULL));
+    }
+
+    if (ctx->data->realtime)
+        output_format_context->flush_packets = 1;
+
+    const int ret = avformat_write_header(output_format_context, &options);
+    av_dict_free(&options);
+    AV_NOT_NEGATIVE(ret);
+
+    ctx->out_video_stream = out_video_stream;
+    ctx->header_written = true;
+
+    if (ctx->data->writer_queue > 0)
+        ctx->writer = start_output_writer(output_format_context, ctx->data->writer_queue);
+}
+
+static void free_region_sws_cache(RegionSwsCache *cache) {
+    for (int i = 0; i < REGION_SWS_CACHE_SIZE; i++) {
+        sws_freeContext(cache->context[i]);
+        cache->context[i] = NULL;
+    }
+}
+
+void close_video_streams(VideoContext *ctx, const bool write_trailer) {
+
+    // the queued packets are written before the trailer
+    const int writer_error = stop_output_writer(&ctx->writer);
+    if (write_trailer)
+        AV_NOT_NEGATIVE(writer_error);
+
+    if (ctx->output_format_context) {
+        if (write_trailer && ctx->header_written)
+            AV_NOT_NEGATIVE(av_write_trailer(ctx->output_format_context));
+        if (ctx->output_io != NULL)
+            ctx->output_format_context->pb = NULL;
+        else
+            avio_closep(&ctx->output_format_context->pb);
+        avformat_free_context(ctx->output_format_context);
+        ctx->output_format_context = NULL;
+    }
+    if (ctx->output_buffered) {
+        ctx->output_buffered = false;
+        const int ret = close_output_file(&ctx->output_io);
+        if (write_trailer)
+            AV_NOT_NEGATIVE(ret);
+    }
+    close_pipe_io(&ctx->output_io);
+    ctx->header_written = false;
+
+    avcodec_free_context(&ctx->decoder_context);
+    avcodec_free_context(&ctx->encoder_context);
+
+    avformat_close_input(&ctx->input_format_context);
+    if (ctx->input_mapped)
+        close_mapped_input(&ctx->input_io);
+    else
+        close_pipe_io(&ctx->input_io);
+    ctx->input_mapped = false;
+}
+
+void close_video_context(VideoContext *ctx) {
+
+    close_video_streams(ctx, true);
+
+    sws_freeContext(ctx->input_format_to_rgb_sws_context);
+    sws_freeContext(ctx->rgb_to_output_format_sws_context);
+    ctx->input_format_to_rgb_sws_context = NULL;
+    ctx->rgb_to_output_format_sws_context = NULL;
+
+    free_region_sws_cache(&ctx->region_to_rgb_cache);
+    free_region_sws_cache(&ctx->region_to_output_cache);
+}
+
+void alloc_frame_slot(const VideoContext *ctx, FrameSlot *slot) {
+
+    const AVCodecContext *encoder_context = ctx->encoder_context;
 
-    AV_NOT_NEGATIVE(avcodec_open2(encoder_context, video_encoder, NULL));
-
-    AV_NOT_NEGATIVE(avcodec_parameters_from_context(out_video_stream->codecpar, encoder_context));
-    out_video_stream->time_base = encoder_context->time_base;
-
-    AV_NOT_NEGATIVE(avio_open(&output_format_context->pb, output_file_path, AVIO_FLAG_WRITE));
-    AV_NOT_NEGATIVE(avformat_write_header(output_format_context, NULL));
-
-    struct SwsContext *input_format_to_rgb_sws_context = NULL;
-    struct SwsContext *rgb_to_output_format_sws_context = NULL;
-    input_format_to_rgb_sws_context = sws_getCachedContext(input_format_to_rgb_sws_context, 
-                                                           decoder_context->width,
-                                                           decoder_context->height,
-                                                           decoder_context->pix_fmt,
-                                                           encoder_context->width,
-                                                           encoder_context->height,
-                                                           AV_PIX_FMT_RGB24,
-                                                           SWS_BICUBIC, NULL, NULL, NULL);
-    NOT_NULL(input_format_to_rgb_sws_context);
-
-    AVStream *output_video_stream = output_format_context->streams[video_stream_index];
-    rgb_to_output_format_sws_context = sws_getCachedContext(rgb_to_output_format_sws_context,
-                                                            decoder_context->width,
-                                                            decoder_context->height,
-                                                            AV_PIX_FMT_RGB24,
-                                                            encoder_context->width,
-                                                            encoder_context->height,
-                                                            encoder_context->pix_fmt,
-                                                            SWS_BICUBIC, NULL, NULL, NULL);
-    NOT_NULL(rgb_to_output_format_sws_context);
-    
     AVFrame *input_frame = av_frame_alloc();
     AVFrame *rgb_frame = av_frame_alloc();
     AVFrame *output_frame = av_frame_alloc();
+    NOT_NULL(input_frame);
+    NOT_NULL(rgb_frame);
+    NOT_NULL(output_frame);
+
+    slot->input_frame = input_frame;
+    slot->rgb_frame = rgb_frame;
+    slot->output_frame = output_frame;
+
+    slot->encodable = output_frame;
+    slot->dirty.size = 0;
+    slot->deadline = 0;
+    slot->dropped = false;
+
+    if (ctx->native_yuv)
+        return;
 
-    int buff_size = av_image_alloc(rgb_frame->data, rgb_frame->linesize, video_stream->codecpar->width,
-                                   video_stream->codecpar->height, AV_PIX_FMT_RGB24, 1);
+    // 64 byte aligned rows, so every row starts on a cache line and vector loads up to the row end stay in bounds
+    int buff_size = av_image_alloc(rgb_frame->data, rgb_frame->linesize, encoder_context->width,
+                                   encoder_context->height, ctx->working_format, WORKING_FORMAT_ALIGN);
     AV_NOT_NEGATIVE(buff_size);
+    stats_add_allocation(buff_size);
     
     buff_size = av_image_alloc(output_frame->data, output_frame->linesize, encoder_context->width,
                                encoder_context->height, encoder_context->pix_fmt, 1);
     AV_NOT_NEGATIVE(buff_size);
+    stats_add_allocation(buff_size);
     
     output_frame->format = encoder_context->pix_fmt;
     output_frame->width  = encoder_context->width;
     output_frame->height = encoder_context->height;
 
-    rgb_frame->format = AV_PIX_FMT_RGB24;
+    rgb_frame->format = ctx->working_format;
     rgb_frame->width = encoder_context->width;
     rgb_frame->height = encoder_context->height;
+}
+
+void free_frame_slot(FrameSlot *slot) {
+
+    av_freep(&slot->rgb_frame->data[0]);
+    av_freep(&slot->output_frame->data[0]);
+
+    av_frame_free(&slot->input_frame);
+    av_frame_free(&slot->rgb_frame);
+    av_frame_free(&slot->output_frame);
+}
+
+// Returns a context converting width x height pixels, contexts for recently used sizes are kept
+static struct SwsContext *get_region_sws_context(RegionSwsCache *cache, const int width, const int height,
+                                                 const enum AVPixelFormat source_format,
+                                                 const enum AVPixelFormat destination_format) {
+
+    for (int i = 0; i < REGION_SWS_CACHE_SIZE; i++) {
+        if (cache->context[i] != NULL && cache->width[i] == width && cache->height[i] == height &&
+            cache->source_format[i] == source_format && cache->destination_format[i] == destination_format)
+            return cache->context[i];
+    }
 
+    const int i = cache->next;
+    cache->next = (cache->next + 1) % REGION_SWS_CACHE_SIZE;
+
+    cache->context[i] = sws_getCachedContext(cache->context[i], width, height, source_format, width, height,
+                                             destination_format, SWS_BICUBIC, NULL, NULL, NULL);
+    NOT_NULL(cache->context[i]);
+    cache->width[i] = width;
+    cache->height[i] = height;
+    cache->source_format[i] = source_format;
+    cache->destination_format[i] = destination_format;
+
+    return cache->context[i];
+}
+
+// Points every plane of the frame data at the top left corner of the region
+static void offset_planes(const enum AVPixelFormat pix_fmt, uint8_t *const data[], const int linesize[],
+                          const Region *region, uint8_t *planes[4]) {
+
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(pix_fmt);
+
+    for (int i = 0; i < 4; i++)
+        planes[i] = NULL;
+
+    for (int i = 0; i < desc->nb_components; i++) {
+        const AVComponentDescriptor *component = &desc->comp[i];
+        const bool chroma = (i == 1 || i == 2) && !(desc->flags & AV_PIX_FMT_FLAG_RGB);
+        const int shift_x = chroma ? desc->log2_chroma_w : 0;
+        const int shift_y = chroma ? desc->log2_chroma_h : 0;
+
+        planes[component->plane] = data[component->plane] +
+                                   (ptrdiff_t) (region->start.y >> shift_y) * linesize[component->plane] +
+                                   (region->start.x >> shift_x) * component->step;
+    }
+}
+
+static void convert_region(RegionSwsCache *cache, const AVFrame *source, AVFrame *destination,
+                           const Region *region, const StatsTimer timer) {
+
+    const int64_t start = stats_start();
+
+    struct SwsContext *context = get_region_sws_context(cache, region->width, region->height, source->format,
+                                                        destination->format);
+
+    uint8_t *source_planes[4];
+    uint8_t *destination_planes[4];
+    offset_planes(source->format, source->data, source->linesize, region, source_planes);
+    offset_planes(destination->format, destination->data, destination->linesize, region, destination_planes);
+
+    AV_NOT_NEGATIVE(sws_scale(context,
+                              (const uint8_t * const *) source_planes,
+                              source->linesize,
+                              0,
+                              region->height,
+                              destination_planes,
+                              destination->linesize));
+
+    stats_stop(timer, start);
+}
+
+bool supports_dirty_regions(const enum AVPixelFormat pix_fmt) {
+
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(pix_fmt);
+
+    if (desc == NULL || (desc->flags & (AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_BITSTREAM)))
+        return false;
+
+    return sws_isSupportedInput(pix_fmt) && sws_isSupportedOutput(pix_fmt);
+}
+
+void convert_to_rgb(VideoContext *ctx, FrameSlot *slot) {
+
+    if (slot->dropped)
+        return;
+
+    if (ctx->native_yuv) {
+        // the decoder may still reference the frame, the effect needs its own copy then
+        AV_NOT_NEGATIVE(av_frame_make_writable(slot->input_frame));
+        return;
+    }
+
+    // the dirty regions are only known after planning, which happens in apply_frame_effect()
+    if (ctx->dirty_regions)
+        return;
+
+    const AVFrame *input_frame = slot->input_frame;
+    AVFrame *rgb_frame = slot->rgb_frame;
+
+    const int64_t start = stats_start();
+    AV_NOT_NEGATIVE(sws_scale(ctx->input_format_to_rgb_sws_context, 
+                              (const uint8_t * const *)input_frame->data, 
+                              input_frame->linesize,
+                              0,
+                              ctx->decoder_context->height, 
+                              rgb_frame->data, 
+                              rgb_frame->linesize));
+    stats_stop(STATS_SWS_TO_RGB, start);
+    rgb_frame->pts = input_frame->pts;
+}
+
+bool is_effect_time(const Config *data, const AVStream *stream, const int64_t timestamp) {
+
+    if (data->start_time <= 0 && data->end_time < 0)
+        return true;
+
+    if (timestamp == AV_NOPTS_VALUE)
+        return false;
+
+    const int64_t first = stream->start_time != AV_NOPTS_VALUE ? stream->start_time : 0;
+    const double seconds = (double) (timestamp - first) * av_q2d(stream->time_base);
+
+    return seconds >= data->start_time && (data->end_time < 0 || seconds < data->end_time);
+}
+
+// The frame stays as it is, its regions are still planned
+static void plan_without_effect(VideoContext *ctx, FrameSlot *slot) {
+    const AVFrame *frame = ctx->native_yuv ? slot->input_frame : slot->rgb_frame;
+    plan_frame(ctx->data, frame->width, frame->height);
+    slot->dirty.size = 0;
+}
+
+static void run_frame_effect(VideoContext *ctx, FrameSlot *slot, const ScaleFilter scale_filter) {
+
+    // outside of --start/--end the regions are still planned, so the frames inside match a run without the range
+    if (!is_effect_time(ctx->data, ctx->video_stream, slot->input_frame->best_effort_timestamp)) {
+        plan_without_effect(ctx, slot);
+        return;
+    }
+
+    if (ctx->native_yuv || !ctx->dirty_regions) {
+        AVFrame *frame = ctx->native_yuv ? slot->input_frame : slot->rgb_frame;
+        plan_frame(ctx->data, frame->width, frame->height);
+        render_frame(frame, ctx->data, scale_filter);
+        return;
+    }
+
+    const AVFrame *input_frame = slot->input_frame;
+    AVFrame *rgb_frame = slot->rgb_frame;
+
+    int shift_x = 0, shift_y = 0;
+    AV_NOT_NEGATIVE(av_pix_fmt_get_chroma_sub_sample(input_frame->format, &shift_x, &shift_y));
+
+    // a chain converts the union of all its stacks once, every effect then works on the same RGB pixels
+    plan_frame(ctx->data, rgb_frame->width, rgb_frame->height);
+    collect_dirty_regions(ctx->data->region_data, 1 << shift_x, 1 << shift_y, rgb_frame->width,
+                          rgb_frame->height, &slot->dirty);
+    for (int i = 0; i < ctx->data->chain_length; i++)
+        add_dirty_regions(ctx->data->chain_regions[i], 1 << shift_x, 1 << shift_y, rgb_frame->width,
+                          rgb_frame->height, &slot->dirty);
+
+    // an empty region stack needs neither conversion nor effect work
+    if (slot->dirty.size == 0)
+        return;
+
+    for (int i = 0; i < slot->dirty.size; i++)
+        convert_region(&ctx->region_to_rgb_cache, input_frame, rgb_frame, &slot->dirty.region[i],
+                       STATS_SWS_TO_RGB);
+
+    rgb_frame->pts = input_frame->pts;
+    render_frame(rgb_frame, ctx->data, scale_filter);
+}
+
+// Degrades the effect of a frame that would miss its deadline, the region stacks advance in any case
+static void run_realtime_effect(VideoContext *ctx, FrameSlot *slot) {
+
+    const RealtimeAction action = slot->action;
+
+    if (action == REALTIME_SKIP || action == REALTIME_DROP) {
+        plan_without_effect(ctx, slot);
+        return;
+    }
+
+    const int64_t start = stats_now();
+    run_frame_effect(ctx, slot, action == REALTIME_NEAREST ? SCALE_NEAREST : ctx->data->scale_filter);
+    record_effect_time(ctx->realtime, action, stats_now() - start);
+}
+
+void apply_frame_effect(VideoContext *ctx, FrameSlot *slot) {
+
+    const int64_t start = stats_start();
+    if (ctx->realtime != NULL)
+        run_realtime_effect(ctx, slot);
+    else
+        run_frame_effect(ctx, slot, ctx->data->scale_filter);
+    stats_stop(STATS_EFFECT, start);
+}
+
+void convert_to_output(VideoContext *ctx, FrameSlot *slot) {
+
+    if (slot->dropped)
+        return;
+
+    AVFrame *input_frame = slot->input_frame;
+    const AVFrame *rgb_frame = slot->rgb_frame;
+    AVFrame *output_frame = slot->output_frame;
+
+    if (ctx->native_yuv || (ctx->dirty_regions && slot->dirty.size == 0)) {
+        // let the encoder choose the frame types instead of copying them from the source
+        input_frame->pict_type = AV_PICTURE_TYPE_NONE;
+        slot->encodable = input_frame;
+        return;
+    }
+
+    slot->encodable = output_frame;
+
+    if (ctx->dirty_regions) {
+        // everything outside of the dirty regions is copied plane by plane
+        av_image_copy(output_frame->data, output_frame->linesize, (const uint8_t **) input_frame->data,
+                      input_frame->linesize, input_frame->format, input_frame->width, input_frame->height);
+
+        for (int i = 0; i < slot->dirty.size; i++)
+            convert_region(&ctx->region_to_output_cache, rgb_frame, output_frame, &slot->dirty.region[i],
+                           STATS_SWS_TO_OUTPUT);
+
+        output_frame->pts = input_frame->pts;
+        return;
+    }
+
+    const int64_t start = stats_start();
+    AV_NOT_NEGATIVE(sws_scale(ctx->rgb_to_output_format_sws_context, 
+                              (const uint8_t * const *)rgb_frame->data, 
+                              rgb_frame->linesize,
+                              0, 
+                              rgb_frame->height, 
+                              output_frame->data, 
+                              output_frame->linesize));
+    stats_stop(STATS_SWS_TO_OUTPUT, start);
+
+    //output_frame->pts = av_rescale_q(input_frame->pts, video_stream->time_base,
+    //                                 out_video_stream->time_base);
+    output_frame->pts = input_frame->pts;
+}
+
+// Passing NULL as frame flushes the encoder
+void encode_frame(VideoContext *ctx, const AVFrame *frame, PacketSink sink, void *opaque) {
+
+    AVCodecContext *encoder_context = ctx->encoder_context;
+
+    int64_t start = stats_start();
+    AV_NOT_NEGATIVE(avcodec_send_frame(encoder_context, frame));
+    AVPacket encoded_packet = {};
+    while (avcodec_receive_packet(encoder_context, &encoded_packet) >= 0) {
+        stats_stop(STATS_ENCODE, start);
+        encoded_packet.stream_index = ctx->out_video_stream->index;
+        av_packet_rescale_ts(&encoded_packet, encoder_context->time_base, ctx->out_video_stream->time_base);
+        sink(ctx, &encoded_packet, opaque);
+        start = stats_start();
+    }
+    stats_stop(STATS_ENCODE, start);
+}
+
+void write_packet(VideoContext *ctx, AVPacket *packet, void *opaque) {
+
+    if (ctx->writer != NULL) {
+        queue_output_packet(ctx->writer, packet);
+        return;
+    }
+
+    const int64_t start = stats_start();
+    AV_NOT_NEGATIVE(av_interleaved_write_frame(ctx->output_format_context, packet));
+    stats_stop(STATS_MUX, start);
+    av_packet_unref(packet);
+}
+
+int read_packet(VideoContext *ctx, AVPacket *packet) {
+    const int64_t start = stats_start();
+    const int ret = av_read_frame(ctx->input_format_context, packet);
+    stats_stop(STATS_DEMUX, start);
+    return ret;
+}
+
+void send_packet(VideoContext *ctx, const AVPacket *packet) {
+    const int64_t start = stats_start();
+    AV_NOT_NEGATIVE(avcodec_send_packet(ctx->decoder_context, packet));
+    stats_stop(STATS_DECODE_SEND, start);
+}
+
+bool receive_frame(VideoContext *ctx, FrameSlot *slot) {
+
+    const int64_t start = stats_start();
+    const bool received = avcodec_receive_frame(ctx->decoder_context, slot->input_frame) >= 0;
+    stats_stop(STATS_DECODE_RECEIVE, start);
+
+    // the frame latency runs from here until the frame is handed to the encoder
+    slot->decoded_at = stats_start();
+
+    // a frame that is already late is dropped before it is converted
+    if (received && ctx->realtime != NULL) {
+        slot->deadline = schedule_frame(ctx->realtime);
+        slot->action = choose_realtime_action(ctx->realtime, slot->deadline);
+        slot->dropped = slot->action == REALTIME_DROP;
+    }
+
+    return received;
+}
+
+// Runs every frame the decoder has ready through all stages on the calling thread
+void process_decoded_frames(VideoContext *ctx, FrameSlot *slot, PacketSink sink, void *opaque) {
+    while (receive_frame(ctx, slot)) {
+        convert_to_rgb(ctx, slot);
+        apply_frame_effect(ctx, slot);
+        if (slot->dropped)
+            continue;
+        convert_to_output(ctx, slot);
+        stats_stop(STATS_FRAME_LATENCY, slot->decoded_at);
+        encode_frame(ctx, slot->encodable, sink, opaque);
+        if (ctx->realtime != NULL)
+            record_frame_done(ctx->realtime, slot->deadline);
+    }
+}
+
+void process_video_frames(VideoContext *ctx, FrameSlot *slot) {
 
     AVPacket packet;
-    int ret;
-    while((ret = av_read_frame(input_format_context, &packet)) >= 0) {
-        if (packet.stream_index == video_stream_index) {
-            AV_NOT_NEGATIVE(avcodec_send_packet(decoder_context, &packet));
+    while(read_packet(ctx, &packet) >= 0) {
+        if (packet.stream_index == ctx->video_stream_index) {
+            send_packet(ctx, &packet);
             
-            while (avcodec_receive_frame(decoder_context, input_frame) >= 0) {
-                AV_NOT_NEGATIVE(sws_scale(input_format_to_rgb_sws_context, 
-                                          (const uint8_t * const *)input_frame->data, 
-                                          input_frame->linesize,
-                                          0,
-                                          decoder_context->height, 
-                                          rgb_frame->data, 
-                                          rgb_frame->linesize));
-                rgb_frame->pts = packet.pts;
-                process_frame(rgb_frame, data);
-                AV_NOT_NEGATIVE(sws_scale(rgb_to_output_format_sws_context, 
-                                          (const uint8_t * const *)rgb_frame->data, 
-                                          rgb_frame->linesize,
-                                          0, 
-                                          rgb_frame->height, 
-                                          output_frame->data, 
-                                          output_frame->linesize));
-
-                //output_frame->pts = av_rescale_q(input_frame->pts, video_stream->time_base,
-                //                                 out_video_stream->time_base);
-                output_frame->pts = input_frame->pts;
-                AV_NOT_NEGATIVE(avcodec_send_frame(encoder_context, output_frame));
-                AVPacket encoded_packet = {};
-                while (avcodec_receive_packet(encoder_context, &encoded_packet) >= 0) {
-                    encoded_packet.stream_index = out_video_stream->index;
-                    av_packet_rescale_ts(&encoded_packet, encoder_context->time_base, out_video_stream->time_base);
-                    AV_NOT_NEGATIVE(av_interleaved_write_frame(output_format_context, &encoded_packet));
-                    av_packet_unref(&encoded_packet);
-                }
-            }
+            process_decoded_frames(ctx, slot, write_packet, NULL);
         }
         else {
-            AV_NOT_NEGATIVE(av_interleaved_write_frame(output_format_context, &packet));
+            write_packet(ctx, &packet, NULL);
         }
         av_packet_unref(&packet);
     }
 
-    AV_NOT_NEGATIVE(avcodec_send_frame(encoder_context, NULL));
-    while (avcodec_receive_packet(encoder_context, &packet) >= 0) {
-        packet.stream_index = out_video_stream->index;
-        av_packet_rescale_ts(&packet, encoder_context->time_base, out_video_stream->time_base);
-        AV_NOT_NEGATIVE(av_interleaved_write_frame(output_format_context, &packet));
-        av_packet_unref(&packet);
-    }
-    
+    // drain the frames the decoder still holds back
+    send_packet(ctx, NULL);
+    process_decoded_frames(ctx, slot, write_packet, NULL);
 
-    AV_NOT_NEGATIVE(av_write_trailer(output_format_context));
+    encode_frame(ctx, NULL, write_packet, NULL);
+}
 
-    avcodec_free_context(&decoder_context);
-    avcodec_free_context(&encoder_context);
-    
-    av_freep(&rgb_frame->data[0]);
-    av_freep(&output_frame->data[0]);
+static void process_video_serial(VideoContext *ctx) {
 
-    av_frame_free(&input_frame);
-    av_frame_free(&rgb_frame);
-    av_frame_free(&output_frame);
-    
-    sws_freeContext(input_format_to_rgb_sws_context);
-    sws_freeContext(rgb_to_output_format_sws_context);
-    
-    avformat_close_input(&input_format_context);
-    avformat_free_context(output_format_context);
+    FrameSlot slot;
+    alloc_frame_slot(ctx, &slot);
+
+    process_video_frames(ctx, &slot);
+
+    free_frame_slot(&slot);
 }
 
-void process_frame(AVFrame *rgb_frame, void *user_data) {
+void process_video(const char *input_file_path, const char *output_file_path, Config *data) {
+
+    if (data->segments > 1) {
+        process_video_segmented(input_file_path, output_file_path, data);
+        return;
+    }
+
+    if (data->target_count > 0) {
+        process_video_fanout(input_file_path, data);
+        return;
+    }
 
-    Config *data = user_data;
+    if (data->smart_render) {
+        process_video_smart(input_file_path, output_file_path, data);
+        return;
+    }
 
-    uint8_t *pixel = rgb_frame->data[0];
+    VideoContext ctx = { .data = data };
 
-    const int linesize = rgb_frame->linesize[0];
-    const int width = rgb_frame->width;
-    const int height = rgb_frame->height;
+    open_input(&ctx, input_file_path);
+    open_encoder(&ctx);
+    open_output(&ctx, output_file_path);
 
-    switch (data->effect_id) {
-        case EFFECT_ONE:
-            apply_effect_1(pixel, linesize, width, height, data);
-            break;
-        case EFFECT_TWO:
-            apply_effect_2(pixel, linesize, width, height, data);
-            break;
-        case EFFECT_THREE:
-            apply_effect_3(pixel, linesize, width, height, data);
-            break;
-        default:
-            fprintf(stderr, "[ERROR] Unknown effect: %s\n", get_filter_name(data->effect_id));
+    RealtimeSchedule schedule;
+    if (data->realtime) {
+        init_realtime(&schedule, av_guess_frame_rate(ctx.input_format_context, ctx.video_stream, NULL),
+                      data->scale_filter == SCALE_BILINEAR && (get_any_chain_capabilities(data) & EFFECT_SCALED));
+        ctx.realtime = &schedule;
     }
-}
 
-void set_rgb_value(uint8_t *pixel, const int offset, const uint8_t r, const bool update_r, const uint8_t g,
-                   const bool update_g, const uint8_t b, const bool update_b) {
-    if (update_r)
-        *(pixel + offset) = r;
-    if (update_g)
-        *(pixel + offset + 1) = g;
-    if (update_b)
-        *(pixel + offset + 2) = b;
-}
\ No newline at end of file
+    if (data->pipeline_depth > 0)
+        process_video_pipelined(&ctx, data->pipeline_depth);
+    else
+        process_video_serial(&ctx);
+
+    close_video_context(&ctx);
+
+    if (data->realtime)
+        print_realtime_summary(&schedule, is_pipe_path(output_file_path) ? stderr : stdout);
+}
@@ -1,19 +1,197 @@
 #pragma once
 
 #include <stdbool.h>
+#include <setjmp.h>
 #include <libavutil/frame.h>
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
 
 #include "cmdline.h"
+#include "realtime/realtime.h"
 
 #define AV_NOT_NEGATIVE(ret) check_av_error_positive(ret, __FILE__, __PRETTY_FUNCTION__, __LINE__)
 #define NOT_NULL(ptr) check_not_null(ptr, __FILE__, __PRETTY_FUNCTION__,  __LINE__);
 
+struct SwsContext;
+struct OutputWriter;
+struct RealtimeSchedule;
+
+// "-" as input or output file reads from stdin or writes to stdout, see --io-buffer-size
+#define PIPE_PATH "-"
+#define DEFAULT_IO_BUFFER_SIZE (1 << 20)
+#define MIN_IO_BUFFER_SIZE 4096
+#define MAX_IO_BUFFER_SIZE (256 << 20)
+
+// Muxer for outputs written to stdout when --output-format is not given
+#define DEFAULT_PIPE_FORMAT "mpegts"
+
+// Largest divisor of the frame size for --preview-scale
+#define MAX_PREVIEW_SCALE 16
+
+// Row alignment of the RGB working frames
+#define WORKING_FORMAT_ALIGN 64
+
+#define REGION_SWS_CACHE_SIZE 8
+
+// Conversion contexts for the sizes of the most recently converted dirty regions
+typedef struct RegionSwsCache {
+    struct SwsContext *context[REGION_SWS_CACHE_SIZE];
+    int width[REGION_SWS_CACHE_SIZE];
+    int height[REGION_SWS_CACHE_SIZE];
+    enum AVPixelFormat source_format[REGION_SWS_CACHE_SIZE];
+    enum AVPixelFormat destination_format[REGION_SWS_CACHE_SIZE];
+    int next;
+} RegionSwsCache;
+
+// Geometry and formats the whole frame conversion contexts were created for
+typedef struct FrameConversion {
+    int width;
+    int height;
+    // size of the RGB and the output frames, smaller than the decoded one with --preview-scale
+    int scaled_width;
+    int scaled_height;
+    enum AVPixelFormat decoded_format;
+    enum AVPixelFormat working_format;
+    enum AVPixelFormat output_format;
+    int threads;
+} FrameConversion;
+
+// Everything process_video() opens for one input/output pair
+typedef struct VideoContext {
+
+    AVFormatContext *input_format_context;
+    AVFormatContext *output_format_context;
+
+    AVCodecContext *decoder_context;
+    AVCodecContext *encoder_context;
+    // open_encoder() asks for the codec headers in the extradata instead of in the stream
+    bool global_header;
+
+    AVStream *video_stream;
+    AVStream *out_video_stream;
+    int video_stream_index;
+    bool header_written;
+
+    // custom I/O contexts over stdin and stdout, a mapped input file or a buffered output file, see io/
+    AVIOContext *input_io;
+    AVIOContext *output_io;
+    bool input_mapped;
+    bool output_buffered;
+
+    // muxes the packets of write_packet() on its own thread, NULL if they are written right away
+    struct OutputWriter *writer;
+
+    // deadlines and degradation of --realtime, NULL otherwise
+    struct RealtimeSchedule *realtime;
+
+    // RGB24 or RGB0, see --working-format
+    enum AVPixelFormat working_format;
+
+    // kept by close_video_streams(), so a batch worker reuses them for the next input with the same conversion
+    struct SwsContext *input_format_to_rgb_sws_context;
+    struct SwsContext *rgb_to_output_format_sws_context;
+    FrameConversion conversion;
+
+    // effects run on the decoded planes, no colorspace conversion at all
+    bool native_yuv;
+
+    // only the regions touched by the effect are converted, the rest is copied from the decoded frame
+    bool dirty_regions;
+    RegionSwsCache region_to_rgb_cache;
+    RegionSwsCache region_to_output_cache;
+
+    Config *data;
+
+} VideoContext;
+
+// One frame on its way through the stages, the rgb and output buffers are allocated once and reused.
+// encodable is either output_frame or, if no conversion was needed, input_frame.
+typedef struct FrameSlot {
+
+    AVFrame *input_frame;
+    AVFrame *rgb_frame;
+    AVFrame *output_frame;
+    AVFrame *encodable;
+
+    DirtyRegions dirty;
+
+    // stats_start() when the frame left the decoder, 0 without --stats-json
+    int64_t decoded_at;
+
+    // --realtime: when the frame has to leave the encoder, what the effect stage does with it, chosen when it
+    // left the decoder, and whether it was dropped for missing its deadline
+    int64_t deadline;
+    RealtimeAction action;
+    bool dropped;
+
+} FrameSlot;
+
+// Receives an encoded (or stream-copied) packet, ownership of the packet reference is passed on
+typedef void (*PacketSink)(VideoContext *ctx, AVPacket *packet, void *opaque);
+
 void check_av_error_positive(int err, const char *file_name, const char *function_name, int line);
 void check_not_null(const void* ptr, const char *file_name, const char *function_name, int line);
 
+// process_frame() plans the regions of the next frame and renders them, RGB24, RGB0 or planar YUV
 void process_frame(AVFrame *rgb_frame, void *user_data);
+// plans for the source size of a --preview-scale run instead of the given frame size
+void plan_frame(Config *data, int width, int height);
+// renders with the given filter instead of data->scale_filter, so --realtime can degrade single frames
+void render_frame(AVFrame *frame, Config *data, ScaleFilter scale_filter);
+
+bool is_pipe_path(const char *path);
+// The muxer open_output() writes with: --format, the pipe default or the one of the file extension
+const AVOutputFormat *guess_output_format(const Config *data, const char *output_file_path);
+
+// Whether a frame with this timestamp of the stream lies within --start/--end
+bool is_effect_time(const Config *data, const AVStream *stream, int64_t timestamp);
+
+bool is_native_format(enum AVPixelFormat pix_fmt);
+bool is_working_format(enum AVPixelFormat pix_fmt);
+bool supports_dirty_regions(enum AVPixelFormat pix_fmt);
+void map_planar_image(const AVFrame *frame, PlanarImage *image);
 
 void process_video(const char *input_file_path, const char *output_file_path, Config *data);
 
+// Setup and teardown, close_video_context() writes the trailer when an output was opened.
+// close_video_streams() only closes the files and codecs and keeps the conversion contexts.
+void open_input(VideoContext *ctx, const char *input_file_path);
+void open_encoder(VideoContext *ctx);
+void open_output(VideoContext *ctx, const char *output_file_path);
+void close_video_streams(VideoContext *ctx, bool write_trailer);
+void close_video_context(VideoContext *ctx);
+
+// Decodes, processes and encodes all frames on the calling thread, slot has to match the opened streams
+void process_video_frames(VideoContext *ctx, FrameSlot *slot);
+
+// While a recovery point is set, failed checks on this thread jump back to it instead of ending the process.
+// get_job_error() describes the failure afterwards.
+void set_job_recovery(jmp_buf *recovery);
+const char *get_job_error(void);
+
+// Ends the job with the formatted message, or the process if no recovery point is set
+void fail_job(const char *format, ...) __attribute__((format(printf, 1, 2), noreturn));
+
+// Called with the message of every failure before the jump to the recovery point, and must not return if there
+// is none. video_effects prints "[ERROR] <message>" and exits, libvideoeffects neither prints nor exits, it
+// returns the message through video_effects_get_error() and sets a recovery point in every call.
+void report_job_failure(const char *message, bool recoverable);
+
+// Stages shared by the serial loop and the pipeline
+void alloc_frame_slot(const VideoContext *ctx, FrameSlot *slot);
+void free_frame_slot(FrameSlot *slot);
+
+void convert_to_rgb(VideoContext *ctx, FrameSlot *slot);
+void apply_frame_effect(VideoContext *ctx, FrameSlot *slot);
+void convert_to_output(VideoContext *ctx, FrameSlot *slot);
+void encode_frame(VideoContext *ctx, const AVFrame *frame, PacketSink sink, void *opaque);
+void write_packet(VideoContext *ctx, AVPacket *packet, void *opaque);
+
+// Demux and decode steps shared by all processing modes, timed when --stats-json is given
+int read_packet(VideoContext *ctx, AVPacket *packet);
+void send_packet(VideoContext *ctx, const AVPacket *packet);
+bool receive_frame(VideoContext *ctx, FrameSlot *slot);
+void process_decoded_frames(VideoContext *ctx, FrameSlot *slot, PacketSink sink, void *opaque);
+
 void set_rgb_value(uint8_t *pixel, int offset, uint8_t r, bool update_r, uint8_t g, bool update_g, uint8_t b,
                    bool update_b);
\ No newline at end of file